@@ -0,0 +1,296 @@
+/*
+ * Usage:
+ *
+ *   Write a checkpoint with N processes:
+ *     srun -n N ./test_remap --write
+ *
+ *   Restart from it with M processes, moving files between caches:
+ *     srun -n M ./test_remap --old-ranks=N
+ *
+ *   Read the same files directly from the prefix directory for comparison:
+ *     srun -n M ./test_remap --old-ranks=N --path=<prefix>
+ *
+ * Each process of the restarted job reads the files of a block of
+ * consecutive ranks of the job that wrote the checkpoint.
+ */
+
+#define _GNU_SOURCE 1
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <string.h>
+
+#include "mpi.h"
+
+#include "scr.h"
+#include "test_common.h"
+
+size_t filesize = 1024*1024;
+int old_ranks = 0;
+int write_ckpt = 0;
+
+char* path = NULL;
+int use_scr = 1;
+
+int rank  = -1;
+int ranks = 0;
+
+/* return the rank in this job that reads the files of the given rank
+ * of the job that wrote the checkpoint */
+static int remap_block(int old_rank, int old_ranks, int new_ranks, void* arg)
+{
+  return (int) ((unsigned long long) old_rank * new_ranks / old_ranks);
+}
+
+/* build the name of the checkpoint file written by the given rank */
+static void ckpt_name(char* name, size_t size, int r)
+{
+  safe_snprintf(name, size, "rank_%d.ckpt", r);
+}
+
+/* write one file per process in a checkpoint,
+ * returns 1 if all processes succeed */
+static int write_checkpoint_files(void)
+{
+  char* buf = (char*) malloc(filesize + rank);
+  init_buffer(buf, filesize + rank, rank, 1);
+
+  SCR_Start_output("ckpt.1", SCR_FLAG_CHECKPOINT);
+
+  char name[256];
+  ckpt_name(name, sizeof(name), rank);
+
+  char file[SCR_MAX_FILENAME];
+  int valid = 0;
+  if (SCR_Route_file(name, file) == SCR_SUCCESS) {
+    int fd = open(file, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (fd >= 0) {
+      valid = write_checkpoint(fd, 1, buf, filesize + rank);
+      close(fd);
+    } else {
+      printf("%d: Could not open file %s\n", rank, file);
+    }
+  }
+
+  SCR_Complete_output(valid);
+
+  free(buf);
+
+  int all_valid;
+  MPI_Allreduce(&valid, &all_valid, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+  return all_valid;
+}
+
+/* read and check the files of all old ranks this process owns,
+ * returns the number of bytes read, or -1 on error */
+static double read_checkpoint_files(void)
+{
+  double bytes = 0.0;
+  char* buf = (char*) malloc(filesize + old_ranks);
+
+  int r;
+  for (r = 0; r < old_ranks; r++) {
+    if (remap_block(r, old_ranks, ranks, NULL) != rank) {
+      continue;
+    }
+
+    char name[256];
+    ckpt_name(name, sizeof(name), r);
+
+    char file[SCR_MAX_FILENAME];
+    if (use_scr) {
+      if (SCR_Route_file(name, file) != SCR_SUCCESS) {
+        printf("%d: Failed to route file %s\n", rank, name);
+        bytes = -1.0;
+        break;
+      }
+    } else {
+      safe_snprintf(file, sizeof(file), "%s/%s", path, name);
+    }
+
+    int timestep = 0;
+    size_t size = filesize + r;
+    if (! read_checkpoint(file, &timestep, buf, size) || ! check_buffer(buf, size, r, timestep)) {
+      printf("%d: Invalid data in file %s\n", rank, file);
+      bytes = -1.0;
+      break;
+    }
+    bytes += (double) size;
+  }
+
+  free(buf);
+  return bytes;
+}
+
+void print_usage()
+{
+  printf("\n");
+  printf("  Usage: test_remap [options]\n");
+  printf("\n");
+  printf("  Options:\n");
+  printf("    -w, --write            Write a checkpoint with one file per process\n");
+  printf("    -n, --old-ranks=<N>    Restart from a checkpoint written by N processes\n");
+  printf("    -s, --size=<SIZE>      Filesize in bytes (default %lu)\n", (unsigned long) filesize);
+  printf("    -p, --path=<DIR>       Read files directly from DIR instead of using SCR\n");
+  printf("    -h, --help             Print usage\n");
+  printf("\n");
+  return;
+}
+
+int main (int argc, char* argv[])
+{
+  MPI_Init(&argc, &argv);
+
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &ranks);
+
+  static const char *opt_string = "wn:s:p:h";
+  static struct option long_options[] = {
+    {"write",     no_argument,       NULL, 'w'},
+    {"old-ranks", required_argument, NULL, 'n'},
+    {"size",      required_argument, NULL, 's'},
+    {"path",      required_argument, NULL, 'p'},
+    {"help",      no_argument,       NULL, 'h'},
+    {NULL,        no_argument,       NULL,   0}
+  };
+
+  int usage = 0;
+  int long_index = 0;
+  int opt = getopt_long(argc, argv, opt_string, long_options, &long_index);
+  while (opt != -1) {
+    switch(opt) {
+      case 'w':
+        write_ckpt = 1;
+        break;
+      case 'n':
+        old_ranks = atoi(optarg);
+        break;
+      case 's':
+        filesize = (size_t) strtoull(optarg, NULL, 10);
+        break;
+      case 'p':
+        path = strdup(optarg);
+        use_scr = 0;
+        break;
+      case 'h':
+      default:
+        usage = 1;
+        break;
+    }
+
+    /* get the next option */
+    opt = getopt_long(argc, argv, opt_string, long_options, &long_index);
+  }
+
+  /* we either write a checkpoint or read one written by some number of ranks */
+  if (write_ckpt == (old_ranks > 0) || (write_ckpt && ! use_scr)) {
+    usage = 1;
+  }
+
+  if (usage) {
+    if (rank == 0) {
+      print_usage();
+    }
+    MPI_Finalize();
+    return 1;
+  }
+
+  int rc = 0;
+  if (write_ckpt) {
+    if (SCR_Init() != SCR_SUCCESS) {
+      printf("Failed initializing SCR\n");
+      return 1;
+    }
+
+    if (! write_checkpoint_files()) {
+      if (rank == 0) {
+        printf("Failed to write checkpoint\n");
+      }
+      rc = 1;
+    }
+
+    /* this flushes the checkpoint to the prefix directory */
+    SCR_Finalize();
+
+    if (rank == 0 && rc == 0) {
+      printf("Wrote checkpoint with %d processes\n", ranks);
+    }
+
+    MPI_Finalize();
+    return rc;
+  }
+
+  /* time from the start of init until the last process has read its files,
+   * since SCR fetches the checkpoint during SCR_Init */
+  MPI_Barrier(MPI_COMM_WORLD);
+  double time_start = MPI_Wtime();
+
+  double bytes = 0.0;
+  if (use_scr) {
+    /* give files to readers with the same mapping we use to read them */
+    SCR_Set_remap(remap_block, NULL);
+
+    if (SCR_Init() != SCR_SUCCESS) {
+      printf("Failed initializing SCR\n");
+      return 1;
+    }
+
+    int have_restart = 0;
+    char dset[SCR_MAX_FILENAME];
+    SCR_Have_restart(&have_restart, dset);
+    if (have_restart) {
+      SCR_Start_restart(dset);
+      bytes = read_checkpoint_files();
+      if (SCR_Complete_restart(bytes >= 0.0) != SCR_SUCCESS) {
+        bytes = -1.0;
+      }
+    } else {
+      bytes = -1.0;
+    }
+  } else {
+    bytes = read_checkpoint_files();
+  }
+
+  double time_end = MPI_Wtime();
+  double secs = time_end - time_start;
+
+  /* report the time of the slowest process */
+  double secsmax, bytessum;
+  int valid = (bytes >= 0.0);
+  int all_valid;
+  if (bytes < 0.0) {
+    bytes = 0.0;
+  }
+  MPI_Reduce(&secs, &secsmax, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+  MPI_Reduce(&bytes, &bytessum, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  MPI_Allreduce(&valid, &all_valid, 1, MPI_INT, MPI_LAND, MPI_COMM_WORLD);
+  if (rank == 0) {
+    if (all_valid) {
+      double bw = 0.0;
+      if (secsmax > 0.0) {
+        bw = bytessum / (1024.0 * 1024.0) / secsmax;
+      }
+      printf("Restart %s: %d -> %d processes, %e bytes in %8.6f s, %8.3f MB/s\n",
+        use_scr ? "with SCR" : "from prefix", old_ranks, ranks, bytessum, secsmax, bw
+      );
+    } else {
+      printf("Restart failed\n");
+    }
+  }
+  if (! all_valid) {
+    rc = 1;
+  }
+
+  if (use_scr) {
+    SCR_Finalize();
+  }
+
+  MPI_Finalize();
+  return rc;
+}
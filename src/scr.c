@@ -162,120 +162,133 @@ static int scr_halt(const char* reason)
   return rc;
 }
 
-/* check whether we should halt the job */
-static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
+/* called by rank 0 to read the halt file and check for an active halt
+ * condition, calls scr_halt to record the reason if halt_exit is set,
+ * returns 1 if the job should halt */
+static int scr_check_halt_rank0(int halt_exit, int decrement)
 {
   /* assume we don't have to halt */
   int need_to_halt = 0;
 
-  /* determine whether we should halt the job by calling exit
-   * if we detect an active halt condition */
-  int halt_exit = ((halt_cond == SCR_TEST_AND_HALT) && scr_halt_exit);
-
-  /* only rank 0 reads the halt file */
-  if (scr_my_rank_world == 0) {
-    /* TODO: all epochs are stored in ints, should be in unsigned ints? */
-    /* get current epoch seconds */
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    int now = tv.tv_sec;
-
-    /* locks halt file, reads it to pick up new values, decrements the
-     * checkpoint counter, writes it out, and unlocks it */
-    scr_halt_sync_and_decrement(scr_halt_file, scr_halt_hash, decrement);
-
-    /* set halt seconds to value found in our halt hash */
-    int halt_seconds;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_SECONDS, &halt_seconds) != KVTREE_SUCCESS) {
-      /* didn't find anything, so set value to 0 */
-      halt_seconds = 0;
-    }
-
-    /* if halt secs enabled, check the remaining time */
-    if (halt_seconds > 0) {
-      long int remaining = scr_env_seconds_remaining();
-      if (remaining >= 0 && remaining <= halt_seconds) {
-        if (halt_exit) {
-          scr_dbg(0, "Job exiting: Reached time limit: (seconds remaining = %ld) <= (SCR_HALT_SECONDS = %d).",
-                  remaining, halt_seconds
-          );
-          scr_halt("TIME_LIMIT");
-        }
-        need_to_halt = 1;
+  /* TODO: all epochs are stored in ints, should be in unsigned ints? */
+  /* get current epoch seconds */
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  int now = tv.tv_sec;
+
+  /* picks up new values if the halt file has changed, and only locks
+   * and rewrites it if we need to decrement the checkpoint counter */
+  scr_halt_refresh_and_decrement(scr_halt_file, scr_halt_hash, decrement);
+
+  /* set halt seconds to value found in our halt hash */
+  int halt_seconds;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_SECONDS, &halt_seconds) != KVTREE_SUCCESS) {
+    /* didn't find anything, so set value to 0 */
+    halt_seconds = 0;
+  }
+
+  /* if halt secs enabled, check the remaining time */
+  if (halt_seconds > 0) {
+    long int remaining = scr_env_seconds_remaining();
+    if (remaining >= 0 && remaining <= halt_seconds) {
+      if (halt_exit) {
+        scr_dbg(0, "Job exiting: Reached time limit: (seconds remaining = %ld) <= (SCR_HALT_SECONDS = %d).",
+                remaining, halt_seconds
+        );
+        scr_halt("TIME_LIMIT");
       }
+      need_to_halt = 1;
     }
+  }
 
-    /* check whether a reason has been specified */
-    char* reason;
-    if (kvtree_util_get_str(scr_halt_hash, SCR_HALT_KEY_EXIT_REASON, &reason) == KVTREE_SUCCESS) {
-      if (strcmp(reason, "") != 0) {
-        /* got a reason, but let's ignore SCR_FINALIZE_CALLED if it's set
-         * and assume user restarted intentionally */
-        if (strcmp(reason, SCR_FINALIZE_CALLED) != 0) {
-          /* since reason points at the EXIT_REASON string in the halt hash, and since
-           * scr_halt() resets this value, we need to copy the current reason */
-          char* tmp_reason = strdup(reason);
-          if (halt_exit && tmp_reason != NULL) {
-            scr_dbg(0, "Job exiting: Reason: %s.", tmp_reason);
-            scr_halt(tmp_reason);
-          }
-          scr_free(&tmp_reason);
-          need_to_halt = 1;
+  /* check whether a reason has been specified */
+  char* reason;
+  if (kvtree_util_get_str(scr_halt_hash, SCR_HALT_KEY_EXIT_REASON, &reason) == KVTREE_SUCCESS) {
+    if (strcmp(reason, "") != 0) {
+      /* got a reason, but let's ignore SCR_FINALIZE_CALLED if it's set
+       * and assume user restarted intentionally */
+      if (strcmp(reason, SCR_FINALIZE_CALLED) != 0) {
+        /* since reason points at the EXIT_REASON string in the halt hash, and since
+         * scr_halt() resets this value, we need to copy the current reason */
+        char* tmp_reason = strdup(reason);
+        if (halt_exit && tmp_reason != NULL) {
+          scr_dbg(0, "Job exiting: Reason: %s.", tmp_reason);
+          scr_halt(tmp_reason);
         }
+        scr_free(&tmp_reason);
+        need_to_halt = 1;
       }
     }
+  }
 
-    /* check whether we are out of checkpoints */
-    int checkpoints_left;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_CHECKPOINTS, &checkpoints_left) == KVTREE_SUCCESS) {
-      if (checkpoints_left == 0) {
-        if (halt_exit) {
-          scr_dbg(0, "Job exiting: No more checkpoints remaining.");
-          scr_halt("NO_CHECKPOINTS_LEFT");
-        }
-        need_to_halt = 1;
+  /* check whether we are out of checkpoints */
+  int checkpoints_left;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_CHECKPOINTS, &checkpoints_left) == KVTREE_SUCCESS) {
+    if (checkpoints_left == 0) {
+      if (halt_exit) {
+        scr_dbg(0, "Job exiting: No more checkpoints remaining.");
+        scr_halt("NO_CHECKPOINTS_LEFT");
       }
+      need_to_halt = 1;
     }
+  }
 
-    /* check whether we need to exit before a specified time */
-    int exit_before;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_BEFORE, &exit_before) == KVTREE_SUCCESS) {
-      if (now >= (exit_before - halt_seconds)) {
-        if (halt_exit) {
-          time_t time_now  = (time_t) now;
-          time_t time_exit = (time_t) exit_before - halt_seconds;
-          char str_now[256];
-          char str_exit[256];
-          strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
-          strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
-          scr_dbg(0, "Job exiting: Current time (%s) is past ExitBefore-HaltSeconds time (%s).",
-                  str_now, str_exit
-          );
-          scr_halt("EXIT_BEFORE_TIME");
-        }
-        need_to_halt = 1;
+  /* check whether we need to exit before a specified time */
+  int exit_before;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_BEFORE, &exit_before) == KVTREE_SUCCESS) {
+    if (now >= (exit_before - halt_seconds)) {
+      if (halt_exit) {
+        time_t time_now  = (time_t) now;
+        time_t time_exit = (time_t) exit_before - halt_seconds;
+        char str_now[256];
+        char str_exit[256];
+        strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
+        strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
+        scr_dbg(0, "Job exiting: Current time (%s) is past ExitBefore-HaltSeconds time (%s).",
+                str_now, str_exit
+        );
+        scr_halt("EXIT_BEFORE_TIME");
       }
+      need_to_halt = 1;
     }
+  }
 
-    /* check whether we need to exit after a specified time */
-    int exit_after;
-    if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_AFTER, &exit_after) == KVTREE_SUCCESS) {
-      if (now >= exit_after) {
-        if (halt_exit) {
-          time_t time_now  = (time_t) now;
-          time_t time_exit = (time_t) exit_after;
-          char str_now[256];
-          char str_exit[256];
-          strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
-          strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
-          scr_dbg(0, "Job exiting: Current time (%s) is past ExitAfter time (%s).", str_now, str_exit);
-          scr_halt("EXIT_AFTER_TIME");
-        }
-        need_to_halt = 1;
+  /* check whether we need to exit after a specified time */
+  int exit_after;
+  if (kvtree_util_get_int(scr_halt_hash, SCR_HALT_KEY_EXIT_AFTER, &exit_after) == KVTREE_SUCCESS) {
+    if (now >= exit_after) {
+      if (halt_exit) {
+        time_t time_now  = (time_t) now;
+        time_t time_exit = (time_t) exit_after;
+        char str_now[256];
+        char str_exit[256];
+        strftime(str_now,  sizeof(str_now),  "%c", localtime(&time_now));
+        strftime(str_exit, sizeof(str_exit), "%c", localtime(&time_exit));
+        scr_dbg(0, "Job exiting: Current time (%s) is past ExitAfter time (%s).", str_now, str_exit);
+        scr_halt("EXIT_AFTER_TIME");
       }
+      need_to_halt = 1;
     }
   }
 
+  return need_to_halt;
+}
+
+/* check whether we should halt the job */
+static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
+{
+  /* assume we don't have to halt */
+  int need_to_halt = 0;
+
+  /* determine whether we should halt the job by calling exit
+   * if we detect an active halt condition */
+  int halt_exit = ((halt_cond == SCR_TEST_AND_HALT) && scr_halt_exit);
+
+  /* only rank 0 reads the halt file */
+  if (scr_my_rank_world == 0) {
+    need_to_halt = scr_check_halt_rank0(halt_exit, decrement);
+  }
+
   /* broadcast halt decision from rank 0 */
   MPI_Bcast(&need_to_halt, 1, MPI_INT, 0, scr_comm_world);
 
@@ -283,9 +296,13 @@ static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
   if (need_to_halt && halt_exit) {
     /* handle any async flush */
     if (scr_flush_async_in_progress) {
-      /* there's an async flush ongoing, see which dataset is being flushed */
-      int flush_rc;
-      if (scr_flush_async_dataset_id == scr_dataset_id) {
+      /* there's an async flush ongoing, see which datasets are being flushed */
+      int flush_rc = SCR_SUCCESS;
+      if (scr_flush_file_is_flushing(scr_dataset_id)) {
+        /* flushes complete in order, so first wait on any older datasets */
+        while (scr_flush_async_dataset_id != scr_dataset_id) {
+          flush_rc = scr_flush_async_wait_oldest(scr_cindex);
+        }
 #ifdef HAVE_LIBCPPR
         /* if we have CPPR, async flush is faster than sync flush, so let it finish */
         flush_rc = scr_flush_async_wait(scr_cindex);
@@ -305,7 +322,7 @@ static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
         }
 #endif
       } else {
-        /* the async flush is flushing a different dataset, so wait for it */
+        /* the async flushes are for older datasets, so wait for them */
         flush_rc = scr_flush_async_wait(scr_cindex);
       }
       if (flush_rc != SCR_SUCCESS) {
@@ -333,6 +350,14 @@ static int scr_bool_check_halt_and_decrement(int halt_cond, int decrement)
       scr_flush_async_finalize();
     }
 
+    /* a halt is planned, so do not count it as an interruption */
+    if (scr_my_rank_world == 0) {
+      scr_ckpt_model_finalize(MPI_Wtime());
+    }
+
+    /* write out any pending flush file changes */
+    scr_flush_file_persist();
+
     /* sync up tasks before exiting (don't want tasks to exit so early that
      * runtime kills others after timeout) */
     MPI_Barrier(scr_comm_world);
@@ -417,11 +442,11 @@ static int scr_check_flush(scr_cache_index* map)
         scr_dbg(2, "async flush attempt @ %s:%d", __FILE__, __LINE__);;
       }
 
-      /* check that we don't start an async flush if one is already in progress */
-      if (scr_flush_async_in_progress) {
-        /* we need to flush the current dataset, however, another flush is ongoing,
-         * so wait for this other flush to complete before starting the next one */
-        int flush_rc = scr_flush_async_wait(scr_cindex);
+      /* check that we don't start an async flush if too many are already in progress */
+      if (scr_flush_async_in_progress >= scr_flush_async_depth) {
+        /* we need to flush the current dataset, however, the queue of ongoing flushes
+         * is full, so wait for the oldest to complete before starting the next one */
+        int flush_rc = scr_flush_async_wait_oldest(scr_cindex);
         if (flush_rc != SCR_SUCCESS) {
           scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
             scr_flush_async_dataset_id, __FILE__, __LINE__
@@ -864,6 +889,11 @@ static int scr_get_params()
     scr_distribute = atoi(value);
   }
 
+  /* whether to fetch lost files of datasets that fail to rebuild */
+  if ((value = scr_param_get("SCR_DISTRIBUTE_RESTORE")) != NULL) {
+    scr_distribute_restore = atoi(value);
+  }
+
   /* whether to fetch files from the parallel file system */
   if ((value = scr_param_get("SCR_FETCH")) != NULL) {
     scr_fetch = atoi(value);
@@ -874,6 +904,31 @@ static int scr_get_params()
     scr_fetch_width = atoi(value);
   }
 
+  /* whether storage group leaders read files on behalf of their group */
+  if ((value = scr_param_get("SCR_FETCH_AGGREGATE")) != NULL) {
+    scr_fetch_aggregate = atoi(value);
+  }
+
+  /* whether to fetch files in the background during restart */
+  if ((value = scr_param_get("SCR_FETCH_STREAM")) != NULL) {
+    scr_fetch_stream = atoi(value);
+  }
+
+  /* whether processes with valid files in cache skip them during fetch */
+  if ((value = scr_param_get("SCR_FETCH_PARTIAL")) != NULL) {
+    scr_fetch_partial = atoi(value);
+  }
+
+  /* whether to read metadata of the fallback checkpoint during a fetch */
+  if ((value = scr_param_get("SCR_FETCH_PREFETCH")) != NULL) {
+    scr_fetch_prefetch = atoi(value);
+  }
+
+  /* whether to redistribute files when restarting on a different number of processes */
+  if ((value = scr_param_get("SCR_FETCH_REMAP")) != NULL) {
+    scr_fetch_remap = atoi(value);
+  }
+
   /* allow user to specify checkpoint to start with on fetch */
   if ((value = scr_param_get("SCR_CURRENT")) != NULL) {
     scr_fetch_current = strdup(value);
@@ -889,6 +944,11 @@ static int scr_get_params()
     scr_flush_width = atoi(value);
   }
 
+  /* whether storage group leaders write files on behalf of their group */
+  if ((value = scr_param_get("SCR_FLUSH_AGGREGATE")) != NULL) {
+    scr_flush_aggregate = atoi(value);
+  }
+
   /* specify flush transfer type */
   if ((value = scr_param_get("SCR_FLUSH_TYPE")) != NULL) {
     scr_flush_type = strdup(value);
@@ -949,6 +1009,11 @@ static int scr_get_params()
     }
   }
 
+  /* number of async flushes that may be in progress at once */
+  if ((value = scr_param_get("SCR_FLUSH_ASYNC_DEPTH")) != NULL) {
+    scr_flush_async_depth = atoi(value);
+  }
+
   /* runtime overhead limit imposed during async flush (in percentage) */
   if ((value = scr_param_get("SCR_FLUSH_ASYNC_PERCENT")) != NULL) {
     if (scr_atod(value, &d) == SCR_SUCCESS) {
@@ -960,6 +1025,86 @@ static int scr_get_params()
     }
   }
 
+  /* codec used to compress files during a flush */
+  if ((value = scr_param_get("SCR_FLUSH_COMPRESS")) != NULL) {
+    if (strcmp(value, "0") != 0 && strcasecmp(value, "NONE") != 0) {
+      scr_flush_compress_codec = strdup(value);
+    }
+  }
+
+  /* number of bytes in each chunk when compressing files */
+  if ((value = scr_param_get("SCR_COMPRESS_CHUNK")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_compress_chunk = (unsigned long) ull;
+      if (scr_compress_chunk != ull) {
+        scr_abort(-1, "Value %s given for %s exceeds unsigned long range @ %s:%d",
+                  value, "SCR_COMPRESS_CHUNK", __FILE__, __LINE__
+        );
+      }
+    } else {
+      scr_err("Failed to read SCR_COMPRESS_CHUNK successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* number of threads to compress and decompress files */
+  if ((value = scr_param_get("SCR_COMPRESS_THREADS")) != NULL) {
+    scr_compress_threads = atoi(value);
+  }
+
+  /* whether to pack files into container files during a flush */
+  if ((value = scr_param_get("SCR_USE_CONTAINERS")) != NULL) {
+    scr_use_containers = atoi(value);
+  }
+
+  /* max number of bytes to write to a container file */
+  if ((value = scr_param_get("SCR_CONTAINER_SIZE")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_container_size = (unsigned long) ull;
+      if (scr_container_size != ull) {
+        scr_abort(-1, "Value %s given for %s exceeds unsigned long range @ %s:%d",
+                  value, "SCR_CONTAINER_SIZE", __FILE__, __LINE__
+        );
+      }
+    } else {
+      scr_err("Failed to read SCR_CONTAINER_SIZE successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* alignment of each file within a container file */
+  if ((value = scr_param_get("SCR_CONTAINER_ALIGN")) != NULL) {
+    if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
+      scr_container_align = (unsigned long) ull;
+      if (scr_container_align != ull) {
+        scr_abort(-1, "Value %s given for %s exceeds unsigned long range @ %s:%d",
+                  value, "SCR_CONTAINER_ALIGN", __FILE__, __LINE__
+        );
+      }
+    } else {
+      scr_err("Failed to read SCR_CONTAINER_ALIGN successfully @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+  }
+
+  /* containers are only written by synchronous flush */
+  if (scr_use_containers && scr_flush_async) {
+    if (scr_my_rank_world == 0) {
+      scr_warn("SCR_USE_CONTAINERS requires synchronous flush, disabling SCR_FLUSH_ASYNC @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+    scr_flush_async = 0;
+  }
+
+  /* number of files to split the rank2file map of a dataset across */
+  if ((value = scr_param_get("SCR_RANK2FILE_STRIPES")) != NULL) {
+    scr_rank2file_stripes = atoi(value);
+  }
+
   /* set file copy buffer size (file chunk size) */
   if ((value = scr_param_get("SCR_FILE_BUF_SIZE")) != NULL) {
     if (scr_abtoull(value, &ull) == SCR_SUCCESS) {
@@ -1001,6 +1146,16 @@ static int scr_get_params()
     scr_crc_on_delete = atoi(value);
   }
 
+  /* specify number of threads to use when computing checksums */
+  if ((value = scr_param_get("SCR_CRC_THREADS")) != NULL) {
+    scr_crc_threads = atoi(value);
+  }
+
+  /* specify whether to compute redundancy data in the background */
+  if ((value = scr_param_get("SCR_ENCODE_ASYNC")) != NULL) {
+    scr_encode_async = atoi(value);
+  }
+
   /* override default checkpoint interval
    * (number of times to call Need_checkpoint between checkpoints) */
   if ((value = scr_param_get("SCR_CHECKPOINT_INTERVAL")) != NULL) {
@@ -1023,6 +1178,21 @@ static int scr_get_params()
     }
   }
 
+  /* whether SCR_Need_checkpoint should avoid global synchronization */
+  if ((value = scr_param_get("SCR_NEED_CHECKPOINT_NONBLOCKING")) != NULL) {
+    scr_need_checkpoint_nonblocking = atoi(value);
+  }
+
+  /* select model to compute optimal time between checkpoints */
+  if ((value = scr_param_get("SCR_CHECKPOINT_MODEL")) != NULL) {
+    scr_checkpoint_model = scr_ckpt_model_from_str(value);
+    if (scr_checkpoint_model == SCR_CKPT_MODEL_NONE && strcasecmp(value, "NONE") != 0) {
+      scr_err("Unknown value for SCR_CHECKPOINT_MODEL: %s @ %s:%d",
+        value, __FILE__, __LINE__
+      );
+    }
+  }
+
   /* TODO: allow someone to silence this if they are not using scripts? */
   /* check that user didn't set something different in $SCR_PREFIX or current working dir */
   value = getenv("SCR_PREFIX");
@@ -1044,12 +1214,253 @@ static int scr_get_params()
   return SCR_SUCCESS;
 }
 
+/*
+=========================================
+Need checkpoint logic
+=========================================
+*/
+
+/* called by rank 0 to decide whether the application should checkpoint,
+ * halt is set if a halt condition is active */
+static int scr_need_checkpoint_rank0(int halt)
+{
+  /* always checkpoint if we need to halt */
+  int flag = halt;
+
+  /* if we don't need to halt, check whether we can afford to checkpoint */
+
+  /* if checkpoint interval is set, check the current checkpoint id */
+  if (!flag && scr_checkpoint_interval > 0 && scr_need_checkpoint_count % scr_checkpoint_interval == 0) {
+    flag = 1;
+  }
+
+  /* if checkpoint seconds is set, check the time since the last checkpoint */
+  if (!flag && scr_checkpoint_seconds > 0) {
+    double now_seconds = MPI_Wtime();
+    if ((int)(now_seconds - scr_time_checkpoint_end) >= scr_checkpoint_seconds) {
+      flag = 1;
+    }
+  }
+
+  /* check whether we can afford to checkpoint based on the max allowed
+   * checkpoint overhead, if set, the cost estimate includes
+   * checkpoints recorded in earlier runs */
+  if (!flag && scr_checkpoint_overhead > 0) {
+    if (scr_time_checkpoint_count == 0) {
+      /* if we haven't taken a checkpoint, we need to take one in order
+       * to get a cost estimate */
+      flag = 1;
+    } else if (scr_time_checkpoint_count > 0) {
+      /* based on average time of checkpoint, current time, and time
+       * that last checkpoint ended, determine overhead of checkpoint
+       * if we took one right now */
+      double now = MPI_Wtime();
+      double avg_cost = scr_time_checkpoint_total / (double) scr_time_checkpoint_count;
+      double percent_cost = avg_cost / (now - scr_time_checkpoint_end + avg_cost) * 100.0;
+
+      /* if our current percent cost is less than allowable overhead,
+       * indicate that it's time for a checkpoint */
+      if (percent_cost < scr_checkpoint_overhead) {
+        flag = 1;
+      }
+    }
+  }
+
+  /* compute the time between checkpoints that minimizes the total time
+   * lost to checkpointing and rework after interruptions, given the cost
+   * of checkpoints and the mean time to interrupt observed so far */
+  if (!flag && scr_checkpoint_model != SCR_CKPT_MODEL_NONE) {
+    double now = MPI_Wtime();
+    double interval;
+    if (scr_ckpt_model_interval(scr_checkpoint_model, now, &interval) != SCR_SUCCESS) {
+      /* we need to take a checkpoint to get a cost estimate */
+      flag = 1;
+    } else if (now - scr_time_checkpoint_end >= interval) {
+      flag = 1;
+    }
+  }
+
+  /* no way to determine whether we need to checkpoint, so always say yes */
+  if (!flag &&
+      scr_checkpoint_interval <= 0 &&
+      scr_checkpoint_seconds  <= 0 &&
+      scr_checkpoint_overhead <= 0 &&
+      scr_checkpoint_model == SCR_CKPT_MODEL_NONE)
+  {
+    flag = 1;
+  }
+
+  return flag;
+}
+
+/* In nonblocking mode, rank 0 broadcasts its decision with MPI_Ibcast
+ * on a private communicator, and each call returns the decision that
+ * rank 0 made in the previous call, so a call only waits on a broadcast
+ * that has typically already completed. */
+static MPI_Comm    scr_need_checkpoint_comm  = MPI_COMM_NULL;
+static MPI_Request scr_need_checkpoint_req   = MPI_REQUEST_NULL;
+static int         scr_need_checkpoint_value = 0; /* buffer for broadcast */
+static int         scr_need_checkpoint_stale = 0; /* whether pending decision predates latest checkpoint */
+
+/* get the decision from rank 0 in nonblocking mode */
+static int scr_need_checkpoint_async(void)
+{
+  /* create our communicator on the first call */
+  if (scr_need_checkpoint_comm == MPI_COMM_NULL) {
+    MPI_Comm_dup(scr_comm_world, &scr_need_checkpoint_comm);
+  }
+
+  /* complete the broadcast started in the previous call, we ignore its
+   * value if a checkpoint has been taken since then */
+  int have_decision = 0;
+  int flag = 0;
+  if (scr_need_checkpoint_req != MPI_REQUEST_NULL) {
+    MPI_Wait(&scr_need_checkpoint_req, MPI_STATUS_IGNORE);
+    if (! scr_need_checkpoint_stale) {
+      flag = scr_need_checkpoint_value;
+      have_decision = 1;
+    }
+  }
+  scr_need_checkpoint_stale = 0;
+
+  /* have rank 0 make a fresh decision, only rank 0 checks the halt
+   * file, and it does not exit here, like SCR_TEST_BUT_DONT_HALT */
+  if (scr_my_rank_world == 0) {
+    int halt = scr_check_halt_rank0(0, 0);
+    scr_need_checkpoint_value = scr_need_checkpoint_rank0(halt);
+  }
+
+  /* start the broadcast of the fresh decision */
+  MPI_Ibcast(&scr_need_checkpoint_value, 1, MPI_INT, 0, scr_need_checkpoint_comm, &scr_need_checkpoint_req);
+
+  /* if we had no usable decision from the previous call, wait for this
+   * one, and start another broadcast with the same value for the next call */
+  if (! have_decision) {
+    MPI_Wait(&scr_need_checkpoint_req, MPI_STATUS_IGNORE);
+    flag = scr_need_checkpoint_value;
+    MPI_Ibcast(&scr_need_checkpoint_value, 1, MPI_INT, 0, scr_need_checkpoint_comm, &scr_need_checkpoint_req);
+  }
+
+  return flag;
+}
+
+/* complete any outstanding broadcast and free the communicator */
+static void scr_need_checkpoint_async_free(void)
+{
+  if (scr_need_checkpoint_req != MPI_REQUEST_NULL) {
+    MPI_Wait(&scr_need_checkpoint_req, MPI_STATUS_IGNORE);
+  }
+  if (scr_need_checkpoint_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&scr_need_checkpoint_comm);
+  }
+  scr_need_checkpoint_stale = 0;
+}
+
 /*
 =========================================
 Common code for Start/Complete output/checkpoint
 =========================================
 */
 
+/* once redundancy data for a dataset has been computed, record the
+ * dataset in the flush file and check whether we need to flush or halt,
+ * otherwise delete the dataset to conserve space if rc indicates failure */
+static void scr_complete_output_finish(int id, int rc)
+{
+  /* get dataset from cache index */
+  scr_dataset* dataset = scr_dataset_new();
+  scr_cache_index_get_dataset(scr_cindex, id, dataset);
+
+  /* get flags for this dataset */
+  int is_ckpt   = scr_dataset_is_ckpt(dataset);
+  int is_output = scr_dataset_is_output(dataset);
+
+  /* if copy is good, check whether we need to flush or halt,
+   * otherwise delete the checkpoint to conserve space */
+  if (rc == SCR_SUCCESS) {
+    /* record entry in flush file for this dataset */
+    char* dset_name;
+    scr_dataset_get_name(dataset, &dset_name);
+    scr_flush_file_new_entry(id, dset_name, dataset, SCR_FLUSH_KEY_LOCATION_CACHE, is_ckpt, is_output);
+
+    /* go ahead and flush any bypass dataset since
+     * it's just a bit more work to finish at this point */
+    int bypass = 0;
+    scr_cache_index_get_bypass(scr_cindex, id, &bypass);
+    if (bypass) {
+      int flush_rc = scr_flush_sync(scr_cindex, id);
+      if (flush_rc != SCR_SUCCESS) {
+        scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
+          id, __FILE__, __LINE__
+        );
+      }
+    }
+
+    /* check_flush may start an async flush, whereas check_halt will call sync flush,
+     * so place check_flush after check_halt */
+    if (is_ckpt) {
+      /* only halt on checkpoints */
+      scr_bool_check_halt_and_decrement(SCR_TEST_AND_HALT, 1);
+    }
+    scr_check_flush(scr_cindex);
+  } else {
+    /* something went wrong, so delete this checkpoint from the cache */
+    scr_cache_delete(scr_cindex, id);
+
+    /* TODODSET: probably should return error or abort if this is output */
+  }
+
+  scr_dataset_delete(&dataset);
+}
+
+/* wait for any redundancy data being computed in the background,
+ * and then finish off its dataset */
+static void scr_encode_wait(void)
+{
+  int id;
+  int rc = scr_reddesc_apply_wait(&id);
+  if (id >= 0) {
+    if (rc != SCR_SUCCESS && scr_my_rank_world == 0) {
+      scr_err("Failed to encode dataset %d in the background @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+    }
+    scr_complete_output_finish(id, rc);
+  }
+}
+
+/* wait for files of a restart dataset still being fetched in the
+ * background, sets id to that dataset or -1 if none was in progress,
+ * returns SCR_FAILURE if the fetch failed */
+static int scr_fetch_stream_complete(int* id)
+{
+  int rc = scr_fetch_stream_finish(scr_cindex, id);
+  if (*id >= 0 && rc != SCR_SUCCESS) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Failed to fetch dataset %d in the background @ %s:%d",
+        *id, __FILE__, __LINE__
+      );
+    }
+  }
+  return rc;
+}
+
+/* wait for files of a restart dataset the application will no longer
+ * read, and drop the dataset from cache if the fetch failed */
+static void scr_fetch_stream_drop(void)
+{
+  int id;
+  if (scr_fetch_stream_complete(&id) != SCR_SUCCESS && id >= 0) {
+    scr_cache_delete(scr_cindex, id);
+
+    /* we no longer have this checkpoint to restart from */
+    if (scr_ckpt_dset_id == id) {
+      scr_ckpt_dset_id  = 0;
+      scr_checkpoint_id = 0;
+    }
+  }
+}
+
 /* start phase for a new output dataset */
 static int scr_start_output(const char* name, int flags)
 {
@@ -1067,6 +1478,13 @@ static int scr_start_output(const char* name, int flags)
   /* make sure everyone is ready to start before we delete any existing checkpoints */
   MPI_Barrier(scr_comm_world);
 
+  /* finish computing redundancy data for the previous dataset before
+   * we consider deleting datasets from cache to make room */
+  scr_encode_wait();
+
+  /* likewise for any restart dataset still being fetched */
+  scr_fetch_stream_drop();
+
   /* determine whether this is a checkpoint */
   int is_ckpt = (flags & SCR_FLAG_CHECKPOINT);
 
@@ -1271,8 +1689,12 @@ static int scr_start_output(const char* name, int flags)
   if (nckpts_base >= size && flushing != -1) {
     /* TODO: we could increase the transfer bandwidth to reduce our wait time */
 
-    /* wait for this dataset to complete its flush */
-    int flush_rc = scr_flush_async_wait(scr_cindex);
+    /* wait for this dataset to complete its flush, which may require
+     * waiting on flushes of older datasets first */
+    int flush_rc = SCR_SUCCESS;
+    while (flush_rc == SCR_SUCCESS && scr_flush_file_is_flushing(flushing)) {
+      flush_rc = scr_flush_async_wait_oldest(scr_cindex);
+    }
     if (flush_rc != SCR_SUCCESS) {
       scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
         scr_flush_async_dataset_id, __FILE__, __LINE__
@@ -1459,7 +1881,9 @@ static int scr_complete_output(int valid)
   rc = scr_assign_ownership(scr_map, scr_rd->bypass);
 
   /* count number of files, number of bytes, and record filesize for each file
-   * as written by this process */
+   * as written by this process, we stat each file just once and cache what
+   * we learn in file_state for the checks in scr_reddesc_apply */
+  kvtree* file_state = kvtree_new();
   int files_valid = valid;
   unsigned long my_counts[3] = {0, 0, 0};
   kvtree_elem* elem;
@@ -1474,25 +1898,27 @@ static int scr_complete_output(int valid)
     /* start with valid flag from caller for this file */
     int file_valid = valid;
 
-    /* check that we can read the file */
-    if (scr_file_is_readable(file) != SCR_SUCCESS) {
+    /* stat the file to get its size and other metadata,
+     * and check that we can read the file */
+    unsigned long filesize = 0;
+    struct stat stat_buf;
+    int stat_rc = scr_file_state_add(file_state, file, &stat_buf);
+    if (stat_rc == SCR_SUCCESS) {
+      filesize = (unsigned long) stat_buf.st_size;
+    }
+
+    int readable = 0;
+    kvtree_util_get_int(scr_file_state_get(file_state, file), SCR_META_KEY_READABLE, &readable);
+    if (! readable) {
       scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
         file, __FILE__, __LINE__
       );
       file_valid  = 0;
       files_valid = 0;
     }
-
-    /* stat the file to get its size and other metadata */
-    unsigned long filesize = 0;
-    struct stat stat_buf;
-    int stat_rc = stat(file, &stat_buf);
-    if (stat_rc == 0) {
-      filesize = (unsigned long) stat_buf.st_size;
-    }
+    scr_file_state_set_complete(file_state, file, file_valid);
 
     /* get size of this file */
-    //unsigned long filesize = scr_file_size(file);
     my_counts[1] += filesize;
 
     /* TODO: record permissions and/or timestamps? */
@@ -1502,7 +1928,7 @@ static int scr_complete_output(int valid)
     scr_filemap_get_meta(scr_map, file, meta);
     scr_meta_set_filesize(meta, filesize);
     scr_meta_set_complete(meta, file_valid);
-    if (stat_rc == 0) {
+    if (stat_rc == SCR_SUCCESS) {
       scr_meta_set_stat(meta, &stat_buf);
     }
     scr_filemap_set_meta(scr_map, file, meta);
@@ -1528,7 +1954,6 @@ static int scr_complete_output(int valid)
 
   /* get flags for this dataset */
   int is_ckpt   = scr_dataset_is_ckpt(dataset);
-  int is_output = scr_dataset_is_output(dataset);
 
   /* store total number of files, total number of bytes, and complete flag in dataset */
   scr_dataset_set_files(dataset, (int) total_files);
@@ -1544,7 +1969,8 @@ static int scr_complete_output(int valid)
   }
   scr_cache_index_set_dataset(scr_cindex, scr_dataset_id, dataset);
 
-  /* write out info to filemap */
+  /* write out info to filemap, this also compacts the journal
+   * of files recorded in SCR_Route_file */
   scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
 
   /* record the cost of the output before copy */
@@ -1576,9 +2002,15 @@ static int scr_complete_output(int valid)
   }
 
   /* apply redundancy scheme if we're still valid */
+  int encoding = 0;
   if (rc == SCR_SUCCESS) {
-    rc = scr_reddesc_apply(scr_map, scr_rd, scr_dataset_id);
+    if (scr_encode_async) {
+      rc = scr_reddesc_apply_async(scr_map, scr_rd, scr_dataset_id, file_state, &encoding);
+    } else {
+      rc = scr_reddesc_apply(scr_map, scr_rd, scr_dataset_id, file_state);
+    }
   }
+  kvtree_delete(&file_state);
 
   /* record the cost of the output and log its completion */
   if (scr_my_rank_world == 0) {
@@ -1601,6 +2033,9 @@ static int scr_complete_output(int valid)
     if (is_ckpt) {
       scr_time_checkpoint_total += time_diff;
       scr_time_checkpoint_count++;
+
+      /* record cost for future runs */
+      scr_ckpt_model_checkpoint(time_diff, scr_time_output_end);
     }
 
     /* log data on the output */
@@ -1629,55 +2064,37 @@ static int scr_complete_output(int valid)
     );
   }
 
-  /* if copy is good, check whether we need to flush or halt,
-   * otherwise delete the checkpoint to conserve space */
-  if (rc == SCR_SUCCESS) {
-    /* record entry in flush file for this dataset */
-    char* dset_name;
-    scr_dataset_get_name(dataset, &dset_name);
-    scr_flush_file_new_entry(scr_dataset_id, dset_name, dataset, SCR_FLUSH_KEY_LOCATION_CACHE, is_ckpt, is_output);
-
-    /* go ahead and flush any bypass dataset since
-     * it's just a bit more work to finish at this point */
-    if (scr_rd->bypass) {
-      int flush_rc = scr_flush_sync(scr_cindex, scr_dataset_id);
-      if (flush_rc != SCR_SUCCESS) {
-        scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-          scr_dataset_id, __FILE__, __LINE__
-        );
-      }
-    }
-
-    /* check_flush may start an async flush, whereas check_halt will call sync flush,
-     * so place check_flush after check_halt */
-    if (is_ckpt) {
-      /* only halt on checkpoints */
-      scr_bool_check_halt_and_decrement(SCR_TEST_AND_HALT, 1);
-    }
-    scr_check_flush(scr_cindex);
-  } else {
-    /* something went wrong, so delete this checkpoint from the cache */
-    scr_cache_delete(scr_cindex, scr_dataset_id);
+  /* a decision to checkpoint that is still being broadcast was made
+   * before this checkpoint, so it should not trigger another one */
+  if (is_ckpt) {
+    scr_need_checkpoint_stale = 1;
+  }
 
-    /* TODODSET: probably should return error or abort if this is output */
+  /* if the redundancy data is being computed in the background,
+   * we record, flush, or delete the dataset once that finishes */
+  if (! encoding) {
+    scr_complete_output_finish(scr_dataset_id, rc);
   }
 
-  /* if we have an async flush ongoing, take this chance to check whether it's completed */
-  if (scr_flush_async_in_progress) {
+  /* if we have async flushes ongoing, take this chance to check whether any have completed,
+   * flushes complete in the order they were started, so check from the oldest */
+  while (scr_flush_async_in_progress) {
     /* got an outstanding async flush, let's check it */
-    if (scr_flush_async_test(scr_cindex, scr_flush_async_dataset_id) == SCR_SUCCESS) {
+    int flush_id = scr_flush_async_dataset_id;
+    if (scr_flush_async_test(scr_cindex, flush_id) == SCR_SUCCESS) {
       /* async flush has finished, go ahead and complete it */
-      int flush_rc = scr_flush_async_complete(scr_cindex, scr_flush_async_dataset_id);
+      int flush_rc = scr_flush_async_complete(scr_cindex, flush_id);
       if (flush_rc != SCR_SUCCESS) {
         scr_abort(-1, "Flush of dataset %d failed @ %s:%d",
-          scr_flush_async_dataset_id, __FILE__, __LINE__
+          flush_id, __FILE__, __LINE__
         );
       }
     } else {
       /* not done yet, just print a progress message to the screen */
       if (scr_my_rank_world == 0) {
-        scr_dbg(1, "Flush of dataset %d is ongoing", scr_flush_async_dataset_id);
+        scr_dbg(1, "Flush of dataset %d is ongoing", flush_id);
       }
+      break;
     }
   }
 
@@ -2124,6 +2541,16 @@ int SCR_Init()
     kvtree_delete(&nodes_hash);
   }
 
+  /* read checkpoint costs and interruptions from earlier runs, and seed
+   * our checkpoint cost estimate with the costs from those runs */
+  if (scr_my_rank_world == 0) {
+    spath* stats_file = spath_from_str(scr_prefix_scr);
+    spath_append_str(stats_file, "ckptstats.scr");
+    scr_ckpt_model_init(stats_file, MPI_Wtime());
+    scr_ckpt_model_history(&scr_time_checkpoint_total, &scr_time_checkpoint_count);
+    spath_delete(&stats_file);
+  }
+
   /* initialize halt info before calling scr_bool_check_halt_and_decrement
    * and set the halt seconds in our halt data structure,
    * this will be overridden if a value is already set in the halt file */
@@ -2213,26 +2640,43 @@ int SCR_Init()
    * allocation with lots of spares. */
 
   /* if the distribute fails, or if the code must restart from the parallel
-   * file system, clear the cache */
+   * file system, clear the cache, unless we're about to fetch and
+   * processes can keep files that are still valid, a global restart
+   * bypasses the cache, so there is nothing to keep in that case */
+  int keep_cache = (scr_fetch && scr_fetch_partial && rc != SCR_SUCCESS && ! scr_fetch_bypass);
   if (rc != SCR_SUCCESS || scr_global_restart) {
-    /* clear the cache of all files */
-    scr_cache_purge(scr_cindex);
+    /* clear the cache of all files, if we keep them, still forget
+     * that we processed SCR_CURRENT as a purge would */
+    if (! keep_cache) {
+      scr_cache_purge(scr_cindex);
+    } else {
+      scr_cache_index_unset_current(scr_cindex);
+    }
     scr_dataset_id    = 0;
     scr_checkpoint_id = 0;
     scr_ckpt_dset_id  = 0;
 
     /* delete the flush file which may be stale */
-    scr_flush_file_rebuild(scr_cindex);
+    if (! keep_cache) {
+      scr_flush_file_rebuild(scr_cindex);
+    }
   }
 
   /* attempt to fetch files from parallel file system */
   int fetch_attempted = 0;
   if ((rc != SCR_SUCCESS || scr_global_restart) && scr_fetch) {
     /* sets scr_dataset_id and scr_checkpoint_id upon success */
-    rc = scr_fetch_latest(scr_cindex, &fetch_attempted);
+    rc = scr_fetch_latest(scr_cindex, keep_cache, &fetch_attempted);
     if (scr_my_rank_world == 0) {
       scr_dbg(2, "scr_fetch_latest attempted on restart");
     }
+
+    /* now that the fetch is done, delete any dataset we kept in cache
+     * that it did not use, and rebuild the flush file */
+    if (keep_cache) {
+      scr_cache_delete_others(scr_cindex, (rc == SCR_SUCCESS) ? scr_ckpt_dset_id : -1);
+      scr_flush_file_rebuild(scr_cindex);
+    }
   }
 
   /* TODO: there is some risk here of cleaning the cache when we shouldn't
@@ -2310,6 +2754,13 @@ int SCR_Finalize()
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* finish computing redundancy data for the latest dataset,
+   * so that it can be flushed below if needed */
+  scr_encode_wait();
+
+  /* finish fetching a restart dataset the application never read */
+  scr_fetch_stream_drop();
+
 #if 0
   /* free user hash if one was allocated */
   kvtree_delete(&scr_app_hash);
@@ -2325,9 +2776,13 @@ int SCR_Finalize()
 
   /* handle any async flush */
   if (scr_flush_async_in_progress) {
-    /* there's an async flush ongoing, see which dataset is being flushed */
-    int flush_rc;
-    if (scr_flush_async_dataset_id == scr_dataset_id) {
+    /* there's an async flush ongoing, see which datasets are being flushed */
+    int flush_rc = SCR_SUCCESS;
+    if (scr_flush_file_is_flushing(scr_dataset_id)) {
+      /* flushes complete in order, so first wait on any older datasets */
+      while (scr_flush_async_dataset_id != scr_dataset_id) {
+        flush_rc = scr_flush_async_wait_oldest(scr_cindex);
+      }
 #ifdef HAVE_LIBCPPR
       /* if we have CPPR, async flush is faster than sync flush, so let it finish */
       flush_rc = scr_flush_async_wait(scr_cindex);
@@ -2347,7 +2802,7 @@ int SCR_Finalize()
       }
 #endif
     } else {
-      /* the async flush is flushing a different checkpoint, so wait for it */
+      /* the async flushes are for older checkpoints, so wait for them */
       flush_rc = scr_flush_async_wait(scr_cindex);
     }
     if (flush_rc != SCR_SUCCESS) {
@@ -2374,6 +2829,17 @@ int SCR_Finalize()
     scr_flush_async_finalize();
   }
 
+  /* record that this run ended normally, rather than being interrupted */
+  if (scr_my_rank_world == 0) {
+    scr_ckpt_model_finalize(MPI_Wtime());
+  }
+
+  /* complete any checkpoint decision still being broadcast */
+  scr_need_checkpoint_async_free();
+
+  /* write out any pending flush file changes */
+  scr_flush_file_free();
+
   /* free off the memory allocated for our descriptors */
   scr_reddescs_free();
   scr_storedescs_free();
@@ -2443,6 +2909,7 @@ int SCR_Finalize()
   /* free memory allocated for variables */
   scr_free(&scr_flush_type);
   scr_free(&scr_fetch_current);
+  scr_free(&scr_flush_compress_codec);
   scr_free(&scr_log_db_host);
   scr_free(&scr_log_db_user);
   scr_free(&scr_log_db_pass);
@@ -2865,73 +3332,27 @@ int SCR_Need_checkpoint(int* flag)
     return SCR_FAILURE;
   }
 
-  /* this is not required, but it helps ensure apps
-   * are calling this as a collective */
-  MPI_Barrier(scr_comm_world);
-
   /* track the number of times a user has called SCR_Need_checkpoint */
   scr_need_checkpoint_count++;
 
-  /* assume we don't need to checkpoint */
-  *flag = 0;
+  /* in nonblocking mode, avoid the barrier and the blocking broadcasts */
+  if (scr_need_checkpoint_nonblocking) {
+    *flag = scr_need_checkpoint_async();
+    return SCR_SUCCESS;
+  }
+
+  /* this is not required, but it helps ensure apps
+   * are calling this as a collective */
+  MPI_Barrier(scr_comm_world);
 
   /* check whether a halt condition is active (don't halt,
    * just be sure to return 1 in this case) */
-  if (!*flag && scr_bool_check_halt_and_decrement(SCR_TEST_BUT_DONT_HALT, 0)) {
-    *flag = 1;
-  }
+  int halt = scr_bool_check_halt_and_decrement(SCR_TEST_BUT_DONT_HALT, 0);
 
   /* have rank 0 make the decision and broadcast the result */
+  *flag = 0;
   if (scr_my_rank_world == 0) {
-    /* TODO: account for MTBF, time to flush, etc. */
-    /* if we don't need to halt, check whether we can afford to checkpoint */
-
-    /* if checkpoint interval is set, check the current checkpoint id */
-    if (!*flag && scr_checkpoint_interval > 0 && scr_need_checkpoint_count % scr_checkpoint_interval == 0) {
-      *flag = 1;
-    }
-
-    /* if checkpoint seconds is set, check the time since the last checkpoint */
-    if (!*flag && scr_checkpoint_seconds > 0) {
-      double now_seconds = MPI_Wtime();
-      if ((int)(now_seconds - scr_time_checkpoint_end) >= scr_checkpoint_seconds) {
-        *flag = 1;
-      }
-    }
-
-    /* check whether we can afford to checkpoint based on the max allowed
-     * checkpoint overhead, if set */
-    if (!*flag && scr_checkpoint_overhead > 0) {
-      /* TODO: could init the cost estimate via environment variable or
-       * stats from previous run */
-      if (scr_time_checkpoint_count == 0) {
-        /* if we haven't taken a checkpoint, we need to take one in order
-         * to get a cost estimate */
-        *flag = 1;
-      } else if (scr_time_checkpoint_count > 0) {
-        /* based on average time of checkpoint, current time, and time
-         * that last checkpoint ended, determine overhead of checkpoint
-         * if we took one right now */
-        double now = MPI_Wtime();
-        double avg_cost = scr_time_checkpoint_total / (double) scr_time_checkpoint_count;
-        double percent_cost = avg_cost / (now - scr_time_checkpoint_end + avg_cost) * 100.0;
-
-        /* if our current percent cost is less than allowable overhead,
-         * indicate that it's time for a checkpoint */
-        if (percent_cost < scr_checkpoint_overhead) {
-          *flag = 1;
-        }
-      }
-    }
-
-    /* no way to determine whether we need to checkpoint, so always say yes */
-    if (!*flag &&
-        scr_checkpoint_interval <= 0 &&
-        scr_checkpoint_seconds  <= 0 &&
-        scr_checkpoint_overhead <= 0)
-    {
-      *flag = 1;
-    }
+    *flag = scr_need_checkpoint_rank0(halt);
   }
 
   /* rank 0 broadcasts the decision */
@@ -3060,6 +3481,14 @@ int SCR_Route_file(const char* file, char* newfile)
     scr_meta_set_ranks(meta, scr_ranks_world);
     scr_meta_set_orig(meta, file);
 
+    /* record the order in which files are routed, a streaming fetch on
+     * restart brings files into cache in this order, a file routed
+     * twice keeps its first position */
+    int order;
+    if (scr_meta_get_order(meta, &order) != SCR_SUCCESS) {
+      scr_meta_set_order(meta, scr_filemap_num_files(scr_map) - 1);
+    }
+
     /* build absolute path to file */
     spath* path_abs = spath_from_str(file);
     if (! spath_is_absolute(path_abs)) {
@@ -3119,12 +3548,19 @@ int SCR_Route_file(const char* file, char* newfile)
     /* record the meta data for this file */
     scr_filemap_set_meta(scr_map, newfile, meta);
 
-    /* write out the filemap */
-    scr_cache_set_map(scr_cindex, scr_dataset_id, scr_map);
+    /* append entry for this file to the filemap journal,
+     * the full map is written in scr_complete_output */
+    scr_cache_journal_map(scr_cindex, scr_dataset_id, scr_map, newfile);
 
     /* delete the meta data object */
     scr_meta_delete(&meta);
   } else {
+    /* if the file is still being fetched in the background,
+     * wait for it to arrive in cache */
+    if (scr_fetch_stream_wait(newfile) != SCR_SUCCESS) {
+      return SCR_FAILURE;
+    }
+
     /* if user specified path to file within prefix, return */
     if (scr_file_is_readable(newfile) == SCR_SUCCESS) {
       return SCR_SUCCESS;
@@ -3205,6 +3641,11 @@ int SCR_Route_file(const char* file, char* newfile)
       return SCR_FAILURE;
     }
 
+    /* wait for the matching file if it is still being fetched */
+    if (scr_fetch_stream_wait(newfile) != SCR_SUCCESS) {
+      return SCR_FAILURE;
+    }
+
     /* if we can't read the file, return an error */
     if (scr_file_is_readable(newfile) != SCR_SUCCESS) {
       return SCR_FAILURE;
@@ -3296,6 +3737,9 @@ int SCR_Have_restart(int* flag, char* name)
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* finish computing redundancy data for any dataset we just wrote */
+  scr_encode_wait();
+
   /* TODO: a more proper check would be to examine the filemap, perhaps across ranks */
 
   /* set flag depending on whether checkpoint_id is greater than 0,
@@ -3403,6 +3847,14 @@ int SCR_Complete_restart(int valid)
    * this should eventually be changed to use an output flag instead */
   int rc = SCR_SUCCESS;
 
+  /* bring in any restart files the application did not read,
+   * if that fails, treat the checkpoint as invalid so that it is
+   * marked as failed in the index and deleted from cache below */
+  int stream_id;
+  if (scr_fetch_stream_complete(&stream_id) != SCR_SUCCESS) {
+    valid = 0;
+  }
+
   /* check that all procs read valid data */
   if (! scr_alltrue(valid, scr_comm_world)) {
     /* if some process fails, attempt to restart from
@@ -3423,12 +3875,12 @@ int SCR_Complete_restart(int valid)
       scr_cache_index_get_dataset(scr_cindex, scr_dataset_id, dataset);
 
       /* get name of current dataset */
-      char* name;
+      char* name = NULL;
       scr_dataset_get_name(dataset, &name);
 
       /* read the index file */
       kvtree* index_hash = kvtree_new();
-      if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
+      if (name != NULL && scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
         /* if there is an entry for this dataset in the index,
          * mark it as failed so we don't try to restart it with it again */
         int id;
@@ -3508,7 +3960,7 @@ int SCR_Complete_restart(int valid)
     if (!found_checkpoint && scr_fetch) {
       /* sets scr_dataset_id and scr_checkpoint_id upon success */
       int fetch_attempted = 0;
-      scr_fetch_latest(scr_cindex, &fetch_attempted);
+      scr_fetch_latest(scr_cindex, 0, &fetch_attempted);
     }
 
     /* set flag depending on whether checkpoint_id is greater than 0,
@@ -3519,6 +3971,21 @@ int SCR_Complete_restart(int valid)
   return rc;
 }
 
+/* set function to map files of a checkpoint written by a job of a
+ * different size onto the ranks of this job */
+int SCR_Set_remap(SCR_Remap_fn fn, void* arg)
+{
+  /* manage state transition */
+  if (scr_state != SCR_STATE_UNINIT) {
+    scr_state_transition_error(scr_state, "SCR_Set_remap()", __FILE__, __LINE__);
+  }
+
+  scr_remap_fn  = fn;
+  scr_remap_arg = arg;
+
+  return SCR_SUCCESS;
+}
+
 /* get and return the SCR version */
 char* SCR_Get_version()
 {
@@ -3595,6 +4062,10 @@ int SCR_Current(const char* name)
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* finish computing redundancy data for the latest dataset,
+   * before we reset the dataset and checkpoint ids */
+  scr_encode_wait();
+
   /* have rank 0 look for named dataset in the prefix directory, and if it exists,
    * set this dataset to be current and initialize our dataset and checkpoint ids */
   int found = 0;
@@ -3768,6 +4239,10 @@ int SCR_Delete(const char* name)
    * are calling this as a collective */
   MPI_Barrier(scr_comm_world);
 
+  /* finish computing redundancy data for the latest dataset,
+   * since we may be about to delete it */
+  scr_encode_wait();
+
   /* NOTE: It is possible that two datasets exist with the same name
    * if one is on the parallel file system and a newer one is in cache
    * but has yet to have been flushed.  Those will have two different
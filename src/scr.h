@@ -84,6 +84,15 @@ int SCR_Start_restart(char* name);
 /* inform library that the current restart is complete */
 int SCR_Complete_restart(int valid);
 
+/* function that returns the rank in a job of new_ranks processes that
+ * reads the files written by old_rank in a job of old_ranks processes */
+typedef int (*SCR_Remap_fn)(int old_rank, int old_ranks, int new_ranks, void* arg);
+
+/* set function to map files of a checkpoint written by a job of a
+ * different size onto the ranks of this job, must be called before
+ * SCR_Init, by default ranks are mapped in contiguous blocks */
+int SCR_Set_remap(SCR_Remap_fn fn, void* arg);
+
 /*****************
  * Checkpoint routines (backwards compatibility)
  ****************/
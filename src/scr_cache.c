@@ -16,6 +16,8 @@
 #include "spath.h"
 #include "kvtree.h"
 
+#include <pthread.h>
+
 /*
 =========================================
 Dataset cache functions
@@ -208,6 +210,34 @@ int scr_cache_set_map(const scr_cache_index* cindex, int id, const scr_filemap*
     rc = SCR_FAILURE;
   }
 
+  /* the full map now includes everything in the journal,
+   * so we can drop the journal */
+  if (rc == SCR_SUCCESS) {
+    scr_filemap_journal_unlink(path);
+  }
+
+  /* free the path to the map file */
+  spath_delete(&path);
+
+  return rc;
+}
+
+/* append entry for given file in map to journal of map file in cache
+ * directory, this avoids rewriting the full map for each new file */
+int scr_cache_journal_map(const scr_cache_index* cindex, int id, const scr_filemap* map, const char* file)
+{
+  /* get directory for dataset */
+  spath* path = scr_cache_get_map_path(cindex, id);
+  if (path == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* append record to journal */
+  int rc = SCR_SUCCESS;
+  if (scr_filemap_journal_append(path, map, file) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+
   /* free the path to the map file */
   spath_delete(&path);
 
@@ -228,6 +258,9 @@ int scr_cache_unset_map(const scr_cache_index* cindex, int id)
   scr_file_unlink(file);
   scr_free(&file);
 
+  /* delete its journal */
+  scr_filemap_journal_unlink(path);
+
   /* free the path to the map file */
   spath_delete(&path);
 
@@ -273,6 +306,17 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, id, map);
   
+  /* check each file's checksum (monitor that cache hardware isn't
+   * corrupting files on us), this checks all files concurrently */
+  if (scr_crc_on_delete) {
+    /* TODO: if corruption, need to log */
+    if (scr_compute_crcs(map) != SCR_SUCCESS) {
+      scr_err("Failed to verify checksums before deleting files of dataset %d, bad drive? @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+    }
+  }
+
   /* for each file we have for this dataset, delete the file */
   kvtree_elem* file_elem;
   for (file_elem = scr_filemap_first_file(map);
@@ -317,17 +361,6 @@ int scr_cache_delete(scr_cache_index* cindex, int id)
       scr_meta_delete(&meta);
     }
   
-    /* check file's crc value (monitor that cache hardware isn't corrupting
-     * files on us) */
-    if (scr_crc_on_delete) {
-      /* TODO: if corruption, need to log */
-      if (scr_compute_crc(map, file) != SCR_SUCCESS) {
-        scr_err("Failed to verify CRC32 before deleting file %s, bad drive? @ %s:%d",
-          file, __FILE__, __LINE__
-        );
-      }
-    }
-
     /* if we're not using bypass, delete data files from cache */
     if (! bypass) {
       /* delete the file */
@@ -506,6 +539,34 @@ int scr_cache_purge(scr_cache_index* cindex)
   return 1;
 }
 
+/* remove all datasets from cache except the given id */
+int scr_cache_delete_others(scr_cache_index* cindex, int id)
+{
+  /* get the list of datasets we have in our cache */
+  int ndsets;
+  int* dsets;
+  scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
+
+  int current_id;
+  int dset_index = 0;
+  do {
+    /* get the smallest index across all processes (returned in current_id),
+     * this also updates our dset_index value if appropriate */
+    scr_next_dataset(ndsets, dsets, &dset_index, &current_id);
+
+    /* if we found a dataset other than the one to keep, delete it */
+    if (current_id != -1 && current_id != id) {
+      /* remove this dataset from all tasks */
+      scr_cache_delete(cindex, current_id);
+    }
+  } while (current_id != -1);
+
+  /* free our list of dataset ids */
+  scr_free(&dsets);
+
+  return SCR_SUCCESS;
+}
+
 #if 0
 /* opens the filemap, inspects that all listed files are readable and complete,
  * unlinks any that are not */
@@ -661,8 +722,95 @@ int scr_cache_check_files(const scr_cache_index* cindex, int id)
   return SCR_SUCCESS;
 }
 
+/* determine whether we can read a file given its stat info,
+ * this avoids an access() call in the common case */
+static int scr_file_state_readable(const char* file, const struct stat* statbuf)
+{
+  uid_t uid = geteuid();
+  if (uid == 0) {
+    return 1;
+  }
+
+  int readable;
+  if (statbuf->st_uid == uid) {
+    readable = (statbuf->st_mode & S_IRUSR) ? 1 : 0;
+  } else if (statbuf->st_gid == getegid()) {
+    readable = (statbuf->st_mode & S_IRGRP) ? 1 : 0;
+  } else {
+    readable = (statbuf->st_mode & S_IROTH) ? 1 : 0;
+  }
+
+  /* the mode bits do not account for supplementary groups or ACLs,
+   * so confirm with the file system before declaring it unreadable */
+  if (! readable && scr_file_is_readable(file) == SCR_SUCCESS) {
+    readable = 1;
+  }
+
+  return readable;
+}
+
+/* stat the file once and record its attributes in state */
+int scr_file_state_add(kvtree* state, const char* file, struct stat* statbuf)
+{
+  kvtree* file_hash = kvtree_set_kv(state, SCR_KEY_FILE, file);
+
+  if (stat(file, statbuf) != 0) {
+    scr_dbg(2, "Failed to stat file: %s errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    kvtree_util_set_int(file_hash, SCR_META_KEY_READABLE, 0);
+    return SCR_FAILURE;
+  }
+
+  int readable = scr_file_state_readable(file, statbuf);
+  kvtree_util_set_int(file_hash, SCR_META_KEY_READABLE, readable);
+  scr_meta_set_filesize(file_hash, (unsigned long) statbuf->st_size);
+  scr_meta_set_stat(file_hash, statbuf);
+
+  return SCR_SUCCESS;
+}
+
+/* record whether file is complete in state */
+int scr_file_state_set_complete(kvtree* state, const char* file, int complete)
+{
+  kvtree* file_hash = kvtree_set_kv(state, SCR_KEY_FILE, file);
+  return scr_meta_set_complete(file_hash, complete);
+}
+
+/* returns the entry for file in state, or NULL if not recorded */
+kvtree* scr_file_state_get(const kvtree* state, const char* file)
+{
+  if (state == NULL) {
+    return NULL;
+  }
+  return kvtree_get_kv(state, SCR_KEY_FILE, file);
+}
+
+/* checks whether specifed file is readable and complete using
+ * attributes cached in its file state entry */
+static int scr_bool_have_file_state(const kvtree* file_hash, const char* file)
+{
+  int readable = 0;
+  kvtree_util_get_int(file_hash, SCR_META_KEY_READABLE, &readable);
+  if (! readable) {
+    scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    return 0;
+  }
+
+  if (scr_meta_is_complete(file_hash) != SCR_SUCCESS) {
+    scr_dbg(2, "File is marked as incomplete: %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    return 0;
+  }
+
+  return 1;
+}
+
 /* checks whether specifed file exists, is readable, and is complete */
-int scr_bool_have_file(const scr_filemap* map, const char* file)
+int scr_bool_have_file(const scr_filemap* map, const char* file, const kvtree* state)
 {
   /* if no filename is given return false */
   if (file == NULL || strcmp(file,"") == 0) {
@@ -672,6 +820,14 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
     return 0;
   }
 
+  /* the size and complete flag in the cached state are the values
+   * recorded in the file's meta data, so there's no need to decode
+   * the meta data or stat the file again */
+  const kvtree* file_hash = scr_file_state_get(state, file);
+  if (file_hash != NULL) {
+    return scr_bool_have_file_state(file_hash, file);
+  }
+
   /* check that we can read the file */
   if (scr_file_is_readable(file) != SCR_SUCCESS) {
     scr_dbg(2, "Do not have read access to file: %s @ %s:%d",
@@ -787,19 +943,10 @@ int scr_bool_have_file(const scr_filemap* map, const char* file)
   return 1;
 }
 
-/* compute and store crc32 value for specified file in given dataset and rank,
+/* compute and store checksum for specified file in given dataset and rank,
  * check against current value if one is set */
 int scr_compute_crc(scr_filemap* map, const char* file)
 {
-  /* compute crc for the file */
-  uLong crc_file;
-  if (scr_crc32(file, &crc_file) != SCR_SUCCESS) {
-    scr_err("Failed to compute crc for file %s @ %s:%d",
-      file, __FILE__, __LINE__
-    );
-    return SCR_FAILURE;
-  }
-
   /* allocate a new meta data object */
   scr_meta* meta = scr_meta_new();
   if (meta == NULL) {
@@ -810,21 +957,38 @@ int scr_compute_crc(scr_filemap* map, const char* file)
 
   /* read meta data from filemap */
   if (scr_filemap_get_meta(map, file, meta) != SCR_SUCCESS) {
+    scr_meta_delete(&meta);
     return SCR_FAILURE;
   }
 
-  int rc = SCR_SUCCESS;
+  /* if a checksum is already recorded, verify it with the same algorithm,
+   * otherwise use the fastest algorithm available */
+  char* name;
+  uint64_t value_meta;
+  int have_meta = (scr_meta_get_checksum(meta, &name, &value_meta) == SCR_SUCCESS);
+  if (! have_meta) {
+    name = (char*) scr_checksum_default();
+  }
+
+  /* compute checksum for the file */
+  uint64_t value_file;
+  if (scr_checksum_file(file, name, &value_file) != SCR_SUCCESS) {
+    scr_err("Failed to compute %s checksum for file %s @ %s:%d",
+      name, file, __FILE__, __LINE__
+    );
+    scr_meta_delete(&meta);
+    return SCR_FAILURE;
+  }
 
-  /* read crc value from meta data */
-  uLong crc_meta;
-  if (scr_meta_get_crc32(meta, &crc_meta) == SCR_SUCCESS) {
+  int rc = SCR_SUCCESS;
+  if (have_meta) {
     /* check that the values are the same */
-    if (crc_file != crc_meta) {
+    if (value_file != value_meta) {
       rc = SCR_FAILURE;
     }
   } else {
-    /* record crc in filemap */
-    scr_meta_set_crc32(meta, crc_file);
+    /* record checksum in filemap */
+    scr_meta_set_checksum(meta, name, value_file);
     scr_filemap_set_meta(map, file, meta);
   }
 
@@ -834,6 +998,216 @@ int scr_compute_crc(scr_filemap* map, const char* file)
   return rc;
 }
 
+/* a piece of a file to be checksummed by a worker thread */
+typedef struct {
+  const char* file;          /* file to read */
+  const char* name;          /* checksum algorithm */
+  unsigned long long offset; /* offset of piece within file */
+  unsigned long long length; /* number of bytes in piece */
+  uint64_t value;            /* checksum of piece */
+  int rc;                    /* result of computing checksum */
+} scr_crc_task;
+
+/* list of pieces shared by worker threads */
+typedef struct {
+  pthread_mutex_t lock;
+  int next;            /* index of next piece to be processed */
+  int count;           /* number of pieces */
+  scr_crc_task* tasks; /* list of pieces */
+} scr_crc_pool;
+
+/* repeatedly take the next piece from the pool until all are done */
+static void* scr_crc_worker(void* arg)
+{
+  scr_crc_pool* pool = (scr_crc_pool*) arg;
+  while (1) {
+    pthread_mutex_lock(&pool->lock);
+    int i = pool->next;
+    pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+
+    if (i >= pool->count) {
+      break;
+    }
+
+    scr_crc_task* t = &pool->tasks[i];
+    t->rc = scr_checksum_file_range(t->file, t->name, t->offset, t->length, &t->value);
+  }
+  return NULL;
+}
+
+/* determine number of threads to use to compute checksums */
+static int scr_crc_num_threads(void)
+{
+  int threads = scr_crc_threads;
+  if (threads <= 0) {
+    /* split cores evenly among procs on the node */
+    int ranks_node = 1;
+    MPI_Comm_size(scr_comm_node, &ranks_node);
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    threads = (int) (cores / ranks_node);
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+  return threads;
+}
+
+/* compute checksums of all files in map using a pool of threads */
+int scr_compute_crcs(scr_filemap* map)
+{
+  int rc = SCR_SUCCESS;
+
+  /* count number of files */
+  int num_files = 0;
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    num_files++;
+  }
+  if (num_files == 0) {
+    return SCR_SUCCESS;
+  }
+
+  /* for each file, note its algorithm, any recorded value, and the
+   * range of pieces it is split into */
+  const char** files  = (const char**) SCR_MALLOC(num_files * sizeof(char*));
+  scr_meta** metas    = (scr_meta**)   SCR_MALLOC(num_files * sizeof(scr_meta*));
+  char** names        = (char**)       SCR_MALLOC(num_files * sizeof(char*));
+  uint64_t* values    = (uint64_t*)    SCR_MALLOC(num_files * sizeof(uint64_t));
+  int* have_values    = (int*)         SCR_MALLOC(num_files * sizeof(int));
+  int* first_task     = (int*)         SCR_MALLOC((num_files + 1) * sizeof(int));
+  unsigned long long* sizes = (unsigned long long*) SCR_MALLOC(num_files * sizeof(unsigned long long));
+
+  int num_tasks = 0;
+  int i = 0;
+  for (elem = scr_filemap_first_file(map);
+       elem != NULL;
+       elem = kvtree_elem_next(elem), i++)
+  {
+    const char* file = kvtree_elem_key(elem);
+    files[i] = file;
+
+    /* if a checksum is already recorded, verify it with the same algorithm,
+     * otherwise use the fastest algorithm available */
+    metas[i] = scr_meta_new();
+    scr_filemap_get_meta(map, file, metas[i]);
+    have_values[i] = (scr_meta_get_checksum(metas[i], &names[i], &values[i]) == SCR_SUCCESS);
+    if (! have_values[i]) {
+      names[i] = (char*) scr_checksum_default();
+    }
+
+    /* split file into pieces if we can combine their checksums */
+    sizes[i] = (unsigned long long) scr_file_size(file);
+    int pieces = 1;
+    if (scr_checksum_combinable(names[i]) && sizes[i] > SCR_CRC_CHUNK) {
+      pieces = (int) ((sizes[i] + SCR_CRC_CHUNK - 1) / SCR_CRC_CHUNK);
+    }
+    first_task[i] = num_tasks;
+    num_tasks += pieces;
+  }
+  first_task[num_files] = num_tasks;
+
+  /* define the pieces */
+  scr_crc_task* tasks = (scr_crc_task*) SCR_MALLOC(num_tasks * sizeof(scr_crc_task));
+  for (i = 0; i < num_files; i++) {
+    unsigned long long offset = 0;
+    int t;
+    for (t = first_task[i]; t < first_task[i+1]; t++) {
+      unsigned long long length = sizes[i] - offset;
+      if (t < first_task[i+1] - 1) {
+        length = SCR_CRC_CHUNK;
+      }
+      tasks[t].file   = files[i];
+      tasks[t].name   = names[i];
+      tasks[t].offset = offset;
+      tasks[t].length = length;
+      tasks[t].value  = 0;
+      tasks[t].rc     = SCR_FAILURE;
+      offset += length;
+    }
+  }
+
+  /* compute checksums of all pieces, the calling thread is one of the workers */
+  scr_crc_pool pool;
+  pthread_mutex_init(&pool.lock, NULL);
+  pool.next  = 0;
+  pool.count = num_tasks;
+  pool.tasks = tasks;
+
+  int num_threads = scr_crc_num_threads();
+  if (num_threads > num_tasks) {
+    num_threads = num_tasks;
+  }
+  pthread_t* threads = (pthread_t*) SCR_MALLOC(num_threads * sizeof(pthread_t));
+  int started = 0;
+  for (i = 1; i < num_threads; i++) {
+    if (pthread_create(&threads[started], NULL, scr_crc_worker, &pool) == 0) {
+      started++;
+    }
+  }
+  scr_crc_worker(&pool);
+  for (i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  scr_free(&threads);
+  pthread_mutex_destroy(&pool.lock);
+
+  /* combine pieces, then check or record value for each file */
+  for (i = 0; i < num_files; i++) {
+    int file_rc = SCR_SUCCESS;
+    uint64_t value = 0;
+    int t;
+    for (t = first_task[i]; t < first_task[i+1]; t++) {
+      if (tasks[t].rc != SCR_SUCCESS) {
+        file_rc = SCR_FAILURE;
+        break;
+      }
+      if (t == first_task[i]) {
+        value = tasks[t].value;
+      } else {
+        value = scr_checksum_combine(names[i], value, tasks[t].value, tasks[t].length);
+      }
+    }
+
+    if (file_rc != SCR_SUCCESS) {
+      scr_err("Failed to compute %s checksum for file %s @ %s:%d",
+        names[i], files[i], __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else if (have_values[i]) {
+      /* check that the values are the same */
+      if (value != values[i]) {
+        scr_err("%s mismatch detected for file %s @ %s:%d",
+          names[i], files[i], __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    } else {
+      /* record checksum in filemap */
+      scr_meta_set_checksum(metas[i], names[i], value);
+      scr_filemap_set_meta(map, files[i], metas[i]);
+    }
+  }
+
+  /* free memory, names may point into meta objects so do this last */
+  for (i = 0; i < num_files; i++) {
+    scr_meta_delete(&metas[i]);
+  }
+  scr_free(&tasks);
+  scr_free(&sizes);
+  scr_free(&first_task);
+  scr_free(&have_values);
+  scr_free(&values);
+  scr_free(&names);
+  scr_free(&metas);
+  scr_free(&files);
+
+  return rc;
+}
+
 /* return store descriptor associated with dataset, returns NULL if not found */
 scr_storedesc* scr_cache_get_storedesc(const scr_cache_index* cindex, int id)
 {
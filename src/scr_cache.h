@@ -31,6 +31,10 @@ int scr_cache_get_map(const scr_cache_index* cindex, int id, scr_filemap* map);
 /* write file map for dataset to cache directory */
 int scr_cache_set_map(const scr_cache_index* cindex, int id, const scr_filemap* map);
 
+/* append entry for given file in map to journal of map file in cache
+ * directory, this avoids rewriting the full map for each new file */
+int scr_cache_journal_map(const scr_cache_index* cindex, int id, const scr_filemap* map, const char* file);
+
 /* delete file map file for dataset from cache directory */
 int scr_cache_unset_map(const scr_cache_index* cindex, int id);
 
@@ -56,6 +60,9 @@ int scr_next_dataset(int ndsets, const int* dsets, int* index, int* current);
 /* remove all files from cache */
 int scr_cache_purge(scr_cache_index* cindex);
 
+/* remove all datasets from cache except the given id */
+int scr_cache_delete_others(scr_cache_index* cindex, int id);
+
 /* inspects that all listed files are readable and complete,
  * unlinks any that are not */
 //int scr_cache_clean(scr_cache_index* cindex);
@@ -63,13 +70,31 @@ int scr_cache_purge(scr_cache_index* cindex);
 /* returns true iff each file in the cache can be read */
 int scr_cache_check_files(const scr_cache_index* cindex, int id);
 
-/* checks whether specifed file exists, is readable, and is complete */
-int scr_bool_have_file(const scr_filemap* map, const char* file);
+/* stat the file once and record its size, mode, timestamps, and whether it
+ * is readable under FILE/<file> in state, returns the stat result in
+ * statbuf, returns SCR_FAILURE if the file could not be stat'd */
+int scr_file_state_add(kvtree* state, const char* file, struct stat* statbuf);
+
+/* record whether file is complete in state */
+int scr_file_state_set_complete(kvtree* state, const char* file, int complete);
+
+/* returns the entry for file in state, or NULL if not recorded */
+kvtree* scr_file_state_get(const kvtree* state, const char* file);
+
+/* checks whether specifed file exists, is readable, and is complete,
+ * if state is not NULL, use the cached attributes rather than
+ * querying the file system */
+int scr_bool_have_file(const scr_filemap* map, const char* file, const kvtree* state);
 
 /* compute and store crc32 value for specified file in given dataset and rank,
  * check against current value if one is set */
 int scr_compute_crc(scr_filemap* map, const char* file);
 
+/* compute checksums of all files in map using a pool of threads,
+ * verify against any values already recorded and record new values
+ * for files that have none, returns SCR_FAILURE if any file fails */
+int scr_compute_crcs(scr_filemap* map);
+
 /* return store descriptor associated with dataset, returns NULL if not found */
 scr_storedesc* scr_cache_get_storedesc(const scr_cache_index* cindex, int id);
 
@@ -40,6 +40,7 @@
 #define SCR_CINDEX_KEY_DATA      ("DSETDESC")
 #define SCR_CINDEX_KEY_PATH      ("PATH")
 #define SCR_CINDEX_KEY_BYPASS    ("BYPASS")
+#define SCR_CINDEX_KEY_ENCODING  ("ENCODING")
 
 /* returns the DSET hash */
 static kvtree* scr_cache_index_get_dh(const kvtree* h)
@@ -94,6 +95,13 @@ int scr_cache_index_get_current(const kvtree* h, char** current)
   return rc;
 }
 
+/* clears the CURRENT name */
+int scr_cache_index_unset_current(kvtree* h)
+{
+  kvtree_unset(h, SCR_CINDEX_KEY_CURRENT);
+  return SCR_SUCCESS;
+}
+
 /* sets the dataset hash for the given dataset id */
 int scr_cache_index_set_dataset(scr_cache_index* cindex, int dset, kvtree* hash)
 {
@@ -206,6 +214,39 @@ int scr_cache_index_get_bypass(const scr_cache_index* cindex, int dset, int* byp
   return SCR_FAILURE; 
 }
 
+/* mark dataset as having its redundancy encoding in progress */
+int scr_cache_index_set_encoding(scr_cache_index* cindex, int dset, int encoding)
+{
+  /* set indicies and get hash reference */
+  kvtree* d = scr_cache_index_set_d(cindex, dset);
+
+  /* only record the flag while encoding is in progress */
+  if (encoding) {
+    kvtree_util_set_int(d, SCR_CINDEX_KEY_ENCODING, encoding);
+  } else {
+    kvtree_unset(d, SCR_CINDEX_KEY_ENCODING);
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* get value of encoding flag for dataset */
+int scr_cache_index_get_encoding(const scr_cache_index* cindex, int dset, int* encoding)
+{
+  /* assume the dataset is not being encoded */
+  *encoding = 0;
+
+  /* get RANK/CKPT hash */
+  kvtree* d = scr_cache_index_get_d(cindex, dset);
+
+  /* get the ENCODING value under the RANK/DSET hash */
+  if (kvtree_util_get_int(d, SCR_CINDEX_KEY_ENCODING, encoding) == KVTREE_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  return SCR_FAILURE;
+}
+
 /* remove all associations for a given dataset */
 int scr_cache_index_remove_dataset(scr_cache_index* cindex, int dset)
 {
@@ -57,6 +57,9 @@ int scr_cache_index_set_current(const kvtree* h, const char* current);
 /* returns the CURRENT name */
 int scr_cache_index_get_current(const kvtree* h, char** current);
 
+/* clears the CURRENT name */
+int scr_cache_index_unset_current(kvtree* h);
+
 /* sets the dataset hash for the given dataset id */
 int scr_cache_index_set_dataset(scr_cache_index* cindex, int dset, kvtree* hash);
 
@@ -81,6 +84,12 @@ int scr_cache_index_set_bypass(scr_cache_index* cindex, int dset, int bypass);
 /* get value of bypass flag for dataset */
 int scr_cache_index_get_bypass(const scr_cache_index* cindex, int dset, int* bypass);
 
+/* mark dataset as having its redundancy encoding in progress */
+int scr_cache_index_set_encoding(scr_cache_index* cindex, int dset, int encoding);
+
+/* get value of encoding flag for dataset */
+int scr_cache_index_get_encoding(const scr_cache_index* cindex, int dset, int* encoding);
+
 /*
 =========================================
 Cache index clear and copy functions
@@ -224,6 +224,9 @@ int scr_cache_rebuild(scr_cache_index* cindex)
 
   /* TODO: also attempt to recover datasets which we were in the
    * middle of flushing */
+  /* datasets that failed to rebuild, whose files we may keep for a fetch */
+  kvtree* failed = kvtree_new();
+
   int current_id;
   int dset_index = 0;
   int output_failed_rebuild = 0;
@@ -254,11 +257,28 @@ int scr_cache_rebuild(scr_cache_index* cindex)
         scr_dataset* dataset = scr_dataset_new();
         scr_cache_index_get_dataset(cindex, current_id, dataset);
 
+        /* if the job died while redundancy data for this dataset was
+         * being computed in the background, its redundancy data is
+         * incomplete and cannot be trusted to rebuild any files */
+        int encoding = 0;
+        scr_cache_index_get_encoding(cindex, current_id, &encoding);
+        int encoded = scr_alltrue(! encoding, scr_comm_world);
+        if (! encoded && scr_my_rank_world == 0) {
+          scr_dbg(1, "Dataset %d was being encoded when the job stopped, discarding it", current_id);
+        }
+
         /* get and recreate directory from cindex */
         char* path;
-        if (scr_distribute_dir(cindex, current_id, &path) == SCR_SUCCESS) {
+        if (encoded && scr_distribute_dir(cindex, current_id, &path) == SCR_SUCCESS) {
           /* rebuild files for this dataset */
           int tmp_rc = scr_reddesc_recover(cindex, current_id, path);
+
+          /* if too many processes lost files for the redundancy scheme to
+           * rebuild a checkpoint, read just the lost files from the prefix */
+          int recovered = scr_alltrue(tmp_rc == SCR_SUCCESS, scr_comm_world);
+          if (! recovered && scr_distribute_restore && scr_dataset_is_ckpt(dataset)) {
+            tmp_rc = scr_fetch_restore(cindex, current_id);
+          }
           if (tmp_rc == SCR_SUCCESS) {
             /* rebuild succeeded */
             rebuild_succeeded = 1;
@@ -337,8 +357,14 @@ int scr_cache_rebuild(scr_cache_index* cindex)
          * cache directory, but we may have failed to distribute the reddescs
          * above so not every task has one */
 
-        /* rebuild failed, delete this dataset from cache */
-        scr_cache_delete(cindex, current_id);
+        /* rebuild failed, if we'll fetch from the prefix directory,
+         * leave files in cache for processes that can keep them,
+         * otherwise delete this dataset from cache */
+        if (scr_fetch && scr_fetch_partial) {
+          kvtree_set_kv_int(failed, "DSET", current_id);
+        } else {
+          scr_cache_delete(cindex, current_id);
+        }
       } else {
         /* rebuid worked, log success */
         if (scr_my_rank_world == 0) {
@@ -354,6 +380,20 @@ int scr_cache_rebuild(scr_cache_index* cindex)
   /* free our list of dataset ids */
   scr_free(&dsets);
 
+  /* files of datasets that failed to rebuild are only useful to a
+   * fetch, which we won't do if we rebuilt a checkpoint,
+   * every process has the same list, so this is collective */
+  if (rc == SCR_SUCCESS) {
+    kvtree_elem* elem;
+    for (elem = kvtree_elem_first(kvtree_get(failed, "DSET"));
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      int id = kvtree_elem_key_int(elem);
+      scr_cache_delete(cindex, id);
+    }
+  }
+
   /* get an updated list of datasets since we may have rebuilt/deleted some */
   scr_cache_index_list_datasets(cindex, &ndsets, &dsets);
 
@@ -365,7 +405,9 @@ int scr_cache_rebuild(scr_cache_index* cindex)
     scr_next_dataset(ndsets, dsets, &dset_index, &current_id);
 
     /* if we found a dataset, try to distribute and rebuild it */
-    if (current_id != -1 && current_id > scr_ckpt_dset_id) {
+    if (current_id != -1 && current_id > scr_ckpt_dset_id &&
+        kvtree_get_kv_int(failed, "DSET", current_id) == NULL)
+    {
       /* rebuild failed, delete this dataset from cache */
       scr_cache_delete(cindex, current_id);
     }
@@ -373,6 +415,7 @@ int scr_cache_rebuild(scr_cache_index* cindex)
 
   /* free our list of dataset ids */
   scr_free(&dsets);
+  kvtree_delete(&failed);
 
   /* stop timer and report performance */
   if (scr_my_rank_world == 0) {
@@ -405,9 +448,8 @@ int scr_cache_rebuild(scr_cache_index* cindex)
 int scr_flush_file_rebuild(const scr_cache_index* cindex)
 {
   if (scr_my_rank_world == 0) {
-    /* read the flush file */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    /* get the flush file */
+    kvtree* hash = scr_flush_file_get_table();
 
     /* get ordered list of dataset ids in flush file */
     int flush_ndsets;
@@ -471,10 +513,7 @@ int scr_flush_file_rebuild(const scr_cache_index* cindex)
     scr_free(&flush_dsets);
 
     /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    scr_flush_file_write();
   }
   return SCR_SUCCESS;
 }
@@ -0,0 +1,601 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements checksum algorithms used to verify file contents.
+ *
+ * CRC32 is zlib's crc32, which older datasets recorded.
+ * CRC32C uses the SSE4.2 or ARMv8 crc32c instructions when the
+ * processor supports them and falls back to a slice-by-8 table
+ * otherwise, both produce the same value.
+ * HASH64 is the xxh64 hash with a seed of 0, which processes 32
+ * bytes per step using plain 64-bit arithmetic. */
+
+#include "scr_conf.h"
+#include "scr.h"
+#include "scr_err.h"
+#include "scr_io.h"
+#include "scr_util.h"
+#include "scr_checksum.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+/* compute crc32 */
+#include <zlib.h>
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#define SCR_CHECKSUM_HAVE_SSE42
+#endif
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define SCR_CHECKSUM_HAVE_ARMCRC
+#endif
+
+#define SCR_CHECKSUM_TYPE_CRC32  (1)
+#define SCR_CHECKSUM_TYPE_CRC32C (2)
+#define SCR_CHECKSUM_TYPE_HASH64 (3)
+
+/* buffer size used to read files */
+#define SCR_CHECKSUM_BUF_SIZE (1024*1024)
+
+/*
+=========================================
+CRC32C
+=========================================
+*/
+
+/* reflected Castagnoli polynomial */
+#define SCR_CRC32C_POLY (0x82F63B78)
+
+/* slice-by-8 lookup tables, built on first use */
+static uint32_t scr_crc32c_table[8][256];
+static pthread_once_t scr_crc32c_once = PTHREAD_ONCE_INIT;
+
+/* set to 1 if the processor has crc32c instructions */
+static int scr_crc32c_hw = 0;
+
+static void scr_crc32c_init(void)
+{
+  uint32_t i;
+  for (i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    int j;
+    for (j = 0; j < 8; j++) {
+      crc = (crc & 1) ? (crc >> 1) ^ SCR_CRC32C_POLY : (crc >> 1);
+    }
+    scr_crc32c_table[0][i] = crc;
+  }
+  for (i = 0; i < 256; i++) {
+    int k;
+    for (k = 1; k < 8; k++) {
+      uint32_t prev = scr_crc32c_table[k-1][i];
+      scr_crc32c_table[k][i] = (prev >> 8) ^ scr_crc32c_table[0][prev & 0xFF];
+    }
+  }
+
+#if defined(SCR_CHECKSUM_HAVE_SSE42)
+  __builtin_cpu_init();
+  scr_crc32c_hw = __builtin_cpu_supports("sse4.2") ? 1 : 0;
+#elif defined(SCR_CHECKSUM_HAVE_ARMCRC)
+  scr_crc32c_hw = 1;
+#endif
+}
+
+/* read 8 bytes as a little-endian value */
+static inline uint64_t scr_checksum_read64(const unsigned char* p)
+{
+  return  (uint64_t) p[0]        | ((uint64_t) p[1] << 8)  |
+         ((uint64_t) p[2] << 16) | ((uint64_t) p[3] << 24) |
+         ((uint64_t) p[4] << 32) | ((uint64_t) p[5] << 40) |
+         ((uint64_t) p[6] << 48) | ((uint64_t) p[7] << 56);
+}
+
+/* read 4 bytes as a little-endian value */
+static inline uint32_t scr_checksum_read32(const unsigned char* p)
+{
+  return  (uint32_t) p[0]        | ((uint32_t) p[1] << 8) |
+         ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint32_t scr_crc32c_sw(uint32_t crc, const unsigned char* p, size_t count)
+{
+  while (count >= 8) {
+    uint64_t word = scr_checksum_read64(p) ^ (uint64_t) crc;
+    crc = scr_crc32c_table[7][ word        & 0xFF] ^
+          scr_crc32c_table[6][(word >> 8)  & 0xFF] ^
+          scr_crc32c_table[5][(word >> 16) & 0xFF] ^
+          scr_crc32c_table[4][(word >> 24) & 0xFF] ^
+          scr_crc32c_table[3][(word >> 32) & 0xFF] ^
+          scr_crc32c_table[2][(word >> 40) & 0xFF] ^
+          scr_crc32c_table[1][(word >> 48) & 0xFF] ^
+          scr_crc32c_table[0][(word >> 56)       ];
+    p     += 8;
+    count -= 8;
+  }
+  while (count > 0) {
+    crc = (crc >> 8) ^ scr_crc32c_table[0][(crc ^ *p) & 0xFF];
+    p++;
+    count--;
+  }
+  return crc;
+}
+
+#if defined(SCR_CHECKSUM_HAVE_SSE42)
+__attribute__((target("sse4.2")))
+static uint32_t scr_crc32c_hw_update(uint32_t crc, const unsigned char* p, size_t count)
+{
+  uint64_t crc64 = crc;
+  while (count >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc64  = _mm_crc32_u64(crc64, word);
+    p     += 8;
+    count -= 8;
+  }
+  crc = (uint32_t) crc64;
+  while (count > 0) {
+    crc = _mm_crc32_u8(crc, *p);
+    p++;
+    count--;
+  }
+  return crc;
+}
+#elif defined(SCR_CHECKSUM_HAVE_ARMCRC)
+static uint32_t scr_crc32c_hw_update(uint32_t crc, const unsigned char* p, size_t count)
+{
+  while (count >= 8) {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    crc    = __crc32cd(crc, word);
+    p     += 8;
+    count -= 8;
+  }
+  while (count > 0) {
+    crc = __crc32cb(crc, *p);
+    p++;
+    count--;
+  }
+  return crc;
+}
+#endif
+
+static uint32_t scr_crc32c_update(uint32_t crc, const unsigned char* p, size_t count)
+{
+#if defined(SCR_CHECKSUM_HAVE_SSE42) || defined(SCR_CHECKSUM_HAVE_ARMCRC)
+  if (scr_crc32c_hw) {
+    return scr_crc32c_hw_update(crc, p, count);
+  }
+#endif
+  return scr_crc32c_sw(crc, p, count);
+}
+
+/*
+=========================================
+HASH64 (xxh64)
+=========================================
+*/
+
+#define SCR_HASH64_P1 (0x9E3779B185EBCA87ULL)
+#define SCR_HASH64_P2 (0xC2B2AE3D27D4EB4FULL)
+#define SCR_HASH64_P3 (0x165667B19E3779F9ULL)
+#define SCR_HASH64_P4 (0x85EBCA77C2B2AE63ULL)
+#define SCR_HASH64_P5 (0x27D4EB2F165667C5ULL)
+
+static inline uint64_t scr_hash64_rotl(uint64_t x, int r)
+{
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t scr_hash64_round(uint64_t acc, uint64_t input)
+{
+  acc += input * SCR_HASH64_P2;
+  acc  = scr_hash64_rotl(acc, 31);
+  acc *= SCR_HASH64_P1;
+  return acc;
+}
+
+static inline uint64_t scr_hash64_merge(uint64_t acc, uint64_t val)
+{
+  acc ^= scr_hash64_round(0, val);
+  acc  = acc * SCR_HASH64_P1 + SCR_HASH64_P4;
+  return acc;
+}
+
+/* process one 32-byte stripe */
+static inline void scr_hash64_stripe(uint64_t* acc, const unsigned char* p)
+{
+  acc[0] = scr_hash64_round(acc[0], scr_checksum_read64(p));
+  acc[1] = scr_hash64_round(acc[1], scr_checksum_read64(p + 8));
+  acc[2] = scr_hash64_round(acc[2], scr_checksum_read64(p + 16));
+  acc[3] = scr_hash64_round(acc[3], scr_checksum_read64(p + 24));
+}
+
+static void scr_hash64_update(scr_checksum* ck, const unsigned char* p, size_t count)
+{
+  /* fill out a partial stripe left from a previous call */
+  if (ck->buf_count > 0) {
+    size_t n = 32 - ck->buf_count;
+    if (n > count) {
+      n = count;
+    }
+    memcpy(ck->buf + ck->buf_count, p, n);
+    ck->buf_count += n;
+    p     += n;
+    count -= n;
+    if (ck->buf_count < 32) {
+      return;
+    }
+    scr_hash64_stripe(ck->acc, ck->buf);
+    ck->buf_count = 0;
+  }
+
+  /* process full stripes directly from the input */
+  while (count >= 32) {
+    scr_hash64_stripe(ck->acc, p);
+    p     += 32;
+    count -= 32;
+  }
+
+  /* save any remainder for the next call */
+  if (count > 0) {
+    memcpy(ck->buf, p, count);
+    ck->buf_count = count;
+  }
+}
+
+static uint64_t scr_hash64_value(const scr_checksum* ck)
+{
+  uint64_t h;
+  if (ck->total >= 32) {
+    const uint64_t* acc = ck->acc;
+    h = scr_hash64_rotl(acc[0], 1)  + scr_hash64_rotl(acc[1], 7) +
+        scr_hash64_rotl(acc[2], 12) + scr_hash64_rotl(acc[3], 18);
+    h = scr_hash64_merge(h, acc[0]);
+    h = scr_hash64_merge(h, acc[1]);
+    h = scr_hash64_merge(h, acc[2]);
+    h = scr_hash64_merge(h, acc[3]);
+  } else {
+    h = SCR_HASH64_P5;
+  }
+  h += ck->total;
+
+  /* mix in bytes that did not fill a stripe */
+  const unsigned char* p = ck->buf;
+  size_t count = ck->buf_count;
+  while (count >= 8) {
+    h ^= scr_hash64_round(0, scr_checksum_read64(p));
+    h  = scr_hash64_rotl(h, 27) * SCR_HASH64_P1 + SCR_HASH64_P4;
+    p     += 8;
+    count -= 8;
+  }
+  if (count >= 4) {
+    h ^= (uint64_t) scr_checksum_read32(p) * SCR_HASH64_P1;
+    h  = scr_hash64_rotl(h, 23) * SCR_HASH64_P2 + SCR_HASH64_P3;
+    p     += 4;
+    count -= 4;
+  }
+  while (count > 0) {
+    h ^= (uint64_t) (*p) * SCR_HASH64_P5;
+    h  = scr_hash64_rotl(h, 11) * SCR_HASH64_P1;
+    p++;
+    count--;
+  }
+
+  /* final avalanche */
+  h ^= h >> 33;
+  h *= SCR_HASH64_P2;
+  h ^= h >> 29;
+  h *= SCR_HASH64_P3;
+  h ^= h >> 32;
+  return h;
+}
+
+/*
+=========================================
+Checksum interface
+=========================================
+*/
+
+/* returns name of fastest algorithm on this processor */
+const char* scr_checksum_default(void)
+{
+  pthread_once(&scr_crc32c_once, scr_crc32c_init);
+  if (scr_crc32c_hw) {
+    return SCR_CHECKSUM_CRC32C;
+  }
+  return SCR_CHECKSUM_HASH64;
+}
+
+/* initialize checksum state for named algorithm */
+int scr_checksum_init(scr_checksum* ck, const char* name)
+{
+  memset(ck, 0, sizeof(scr_checksum));
+
+  if (name == NULL) {
+    return SCR_FAILURE;
+  }
+
+  if (strcmp(name, SCR_CHECKSUM_CRC32) == 0) {
+    ck->type  = SCR_CHECKSUM_TYPE_CRC32;
+    ck->value = (uint64_t) crc32(0L, Z_NULL, 0);
+  } else if (strcmp(name, SCR_CHECKSUM_CRC32C) == 0) {
+    pthread_once(&scr_crc32c_once, scr_crc32c_init);
+    ck->type  = SCR_CHECKSUM_TYPE_CRC32C;
+    ck->value = 0xFFFFFFFF;
+  } else if (strcmp(name, SCR_CHECKSUM_HASH64) == 0) {
+    ck->type   = SCR_CHECKSUM_TYPE_HASH64;
+    ck->acc[0] = SCR_HASH64_P1 + SCR_HASH64_P2;
+    ck->acc[1] = SCR_HASH64_P2;
+    ck->acc[2] = 0;
+    ck->acc[3] = 0 - SCR_HASH64_P1;
+  } else {
+    scr_err("Unknown checksum algorithm `%s' @ %s:%d",
+      name, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* add count bytes from buf to checksum */
+void scr_checksum_update(scr_checksum* ck, const void* buf, size_t count)
+{
+  const unsigned char* p = (const unsigned char*) buf;
+  switch (ck->type) {
+  case SCR_CHECKSUM_TYPE_CRC32:
+    /* zlib takes a uInt length, so feed large buffers in pieces */
+    while (count > 0) {
+      uInt n = (count > (1U << 30)) ? (1U << 30) : (uInt) count;
+      ck->value = (uint64_t) crc32((uLong) ck->value, (const Bytef*) p, n);
+      p     += n;
+      count -= n;
+      ck->total += n;
+    }
+    break;
+  case SCR_CHECKSUM_TYPE_CRC32C:
+    ck->value = (uint64_t) scr_crc32c_update((uint32_t) ck->value, p, count);
+    ck->total += count;
+    break;
+  case SCR_CHECKSUM_TYPE_HASH64:
+    ck->total += count;
+    scr_hash64_update(ck, p, count);
+    break;
+  }
+}
+
+/* returns the checksum of all bytes added so far */
+uint64_t scr_checksum_value(const scr_checksum* ck)
+{
+  switch (ck->type) {
+  case SCR_CHECKSUM_TYPE_CRC32:
+    return ck->value;
+  case SCR_CHECKSUM_TYPE_CRC32C:
+    return (uint64_t) ((uint32_t) ck->value ^ 0xFFFFFFFF);
+  case SCR_CHECKSUM_TYPE_HASH64:
+    return scr_hash64_value(ck);
+  }
+  return 0;
+}
+
+/* returns the name of the algorithm used by the checksum */
+const char* scr_checksum_name(const scr_checksum* ck)
+{
+  switch (ck->type) {
+  case SCR_CHECKSUM_TYPE_CRC32:
+    return SCR_CHECKSUM_CRC32;
+  case SCR_CHECKSUM_TYPE_CRC32C:
+    return SCR_CHECKSUM_CRC32C;
+  case SCR_CHECKSUM_TYPE_HASH64:
+    return SCR_CHECKSUM_HASH64;
+  }
+  return NULL;
+}
+
+/* read the given file and add its contents to the checksum */
+int scr_checksum_file_update(const char* file, scr_checksum* ck)
+{
+  /* open the file for reading */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_dbg(1, "Failed to open file to compute checksum: %s errno=%d @ %s:%d",
+      file, errno, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* allocate a buffer to read file data into */
+  char* buf = (char*) SCR_MALLOC(SCR_CHECKSUM_BUF_SIZE);
+
+  /* read the file data in and compute its checksum */
+  ssize_t nread = 0;
+  do {
+    nread = scr_read(file, fd, buf, SCR_CHECKSUM_BUF_SIZE);
+    if (nread > 0) {
+      scr_checksum_update(ck, buf, (size_t) nread);
+    }
+  } while (nread == SCR_CHECKSUM_BUF_SIZE);
+
+  scr_free(&buf);
+
+  /* if we got an error, don't print anything and bailout */
+  if (nread < 0) {
+    scr_dbg(1, "Error while reading file to compute checksum: %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+    scr_close(file, fd);
+    return SCR_FAILURE;
+  }
+
+  /* close the file */
+  scr_close(file, fd);
+
+  return SCR_SUCCESS;
+}
+
+/* compute checksum of length bytes starting at offset in file */
+int scr_checksum_file_range(
+  const char* file,
+  const char* name,
+  unsigned long long offset,
+  unsigned long long length,
+  uint64_t* value)
+{
+  scr_checksum ck;
+  if (scr_checksum_init(&ck, name) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_dbg(1, "Failed to open file to compute checksum: %s errno=%d @ %s:%d",
+      file, errno, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+  char* buf = (char*) SCR_MALLOC(SCR_CHECKSUM_BUF_SIZE);
+  while (length > 0) {
+    size_t count = SCR_CHECKSUM_BUF_SIZE;
+    if ((unsigned long long) count > length) {
+      count = (size_t) length;
+    }
+    ssize_t nread = pread(fd, buf, count, (off_t) offset);
+    if (nread < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (nread <= 0) {
+      /* error or file is shorter than expected */
+      scr_dbg(1, "Error while reading file to compute checksum: %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+    scr_checksum_update(&ck, buf, (size_t) nread);
+    offset += (unsigned long long) nread;
+    length -= (unsigned long long) nread;
+  }
+  scr_free(&buf);
+
+  scr_close(file, fd);
+
+  if (rc == SCR_SUCCESS) {
+    *value = scr_checksum_value(&ck);
+  }
+  return rc;
+}
+
+/* returns 1 if checksums computed with named algorithm can be combined */
+int scr_checksum_combinable(const char* name)
+{
+  return (strcmp(name, SCR_CHECKSUM_CRC32)  == 0 ||
+          strcmp(name, SCR_CHECKSUM_CRC32C) == 0);
+}
+
+/* multiply 32x32 matrix over GF(2) by vector */
+static uint32_t scr_gf2_times(const uint32_t* mat, uint32_t vec)
+{
+  uint32_t sum = 0;
+  while (vec) {
+    if (vec & 1) {
+      sum ^= *mat;
+    }
+    vec >>= 1;
+    mat++;
+  }
+  return sum;
+}
+
+/* square a 32x32 matrix over GF(2) */
+static void scr_gf2_square(uint32_t* square, const uint32_t* mat)
+{
+  int n;
+  for (n = 0; n < 32; n++) {
+    square[n] = scr_gf2_times(mat, mat[n]);
+  }
+}
+
+/* combine two reflected crcs computed with the given polynomial, this
+ * applies length2 zero bytes to crc1 by repeated squaring of the
+ * operator that shifts in one zero bit, then adds in crc2 */
+static uint32_t scr_crc_combine(uint32_t poly, uint32_t crc1, uint32_t crc2, unsigned long long length2)
+{
+  if (length2 == 0) {
+    return crc1;
+  }
+
+  /* operator for one zero bit */
+  uint32_t odd[32];
+  uint32_t even[32];
+  odd[0] = poly;
+  uint32_t row = 1;
+  int n;
+  for (n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  /* operators for two and four zero bits */
+  scr_gf2_square(even, odd);
+  scr_gf2_square(odd, even);
+
+  /* apply length2 zero bytes to crc1, the first square below
+   * gives the operator for one zero byte */
+  do {
+    scr_gf2_square(even, odd);
+    if (length2 & 1) {
+      crc1 = scr_gf2_times(even, crc1);
+    }
+    length2 >>= 1;
+    if (length2 == 0) {
+      break;
+    }
+
+    scr_gf2_square(odd, even);
+    if (length2 & 1) {
+      crc1 = scr_gf2_times(odd, crc1);
+    }
+    length2 >>= 1;
+  } while (length2 != 0);
+
+  return crc1 ^ crc2;
+}
+
+/* return the checksum of two consecutive pieces of data */
+uint64_t scr_checksum_combine(const char* name, uint64_t value1, uint64_t value2, unsigned long long length2)
+{
+  if (strcmp(name, SCR_CHECKSUM_CRC32) == 0) {
+    return (uint64_t) scr_crc_combine(0xEDB88320, (uint32_t) value1, (uint32_t) value2, length2);
+  }
+  return (uint64_t) scr_crc_combine(SCR_CRC32C_POLY, (uint32_t) value1, (uint32_t) value2, length2);
+}
+
+/* compute checksum of given file using named algorithm */
+int scr_checksum_file(const char* file, const char* name, uint64_t* value)
+{
+  scr_checksum ck;
+  if (scr_checksum_init(&ck, name) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+  if (scr_checksum_file_update(file, &ck) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+  *value = scr_checksum_value(&ck);
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_CHECKSUM_H
+#define SCR_CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* names of checksum algorithms, these are recorded in file meta data
+ * so that a file can be verified later with the same algorithm */
+#define SCR_CHECKSUM_CRC32  ("CRC32")  /* zlib crc32, used by older datasets */
+#define SCR_CHECKSUM_CRC32C ("CRC32C") /* Castagnoli crc, hardware accelerated where available */
+#define SCR_CHECKSUM_HASH64 ("HASH64") /* fast non-cryptographic 64-bit hash (xxh64) */
+
+/* running state of a checksum computation, data may be passed to
+ * scr_checksum_update in pieces of any size */
+typedef struct {
+  int type;                 /* algorithm in use */
+  uint64_t value;           /* running crc value */
+  uint64_t total;           /* number of bytes processed */
+  uint64_t acc[4];          /* HASH64 accumulators */
+  unsigned char buf[32];    /* HASH64 bytes waiting for a full stripe */
+  size_t buf_count;         /* number of valid bytes in buf */
+} scr_checksum;
+
+/* returns name of fastest algorithm on this processor, which is
+ * used when recording checksums for new files */
+const char* scr_checksum_default(void);
+
+/* initialize checksum state for named algorithm,
+ * returns SCR_FAILURE if the name is not recognized */
+int scr_checksum_init(scr_checksum* ck, const char* name);
+
+/* add count bytes from buf to checksum */
+void scr_checksum_update(scr_checksum* ck, const void* buf, size_t count);
+
+/* returns the checksum of all bytes added so far */
+uint64_t scr_checksum_value(const scr_checksum* ck);
+
+/* returns the name of the algorithm used by the checksum */
+const char* scr_checksum_name(const scr_checksum* ck);
+
+/* read the given file and add its contents to the checksum */
+int scr_checksum_file_update(const char* file, scr_checksum* ck);
+
+/* compute checksum of given file using named algorithm */
+int scr_checksum_file(const char* file, const char* name, uint64_t* value);
+
+/* compute checksum of length bytes starting at offset in file */
+int scr_checksum_file_range(
+  const char* file,
+  const char* name,
+  unsigned long long offset,
+  unsigned long long length,
+  uint64_t* value
+);
+
+/* returns 1 if checksums of consecutive pieces of data computed with
+ * named algorithm can be combined with scr_checksum_combine */
+int scr_checksum_combinable(const char* name);
+
+/* given checksum value1 of a first piece of data and checksum value2
+ * of a second piece of length2 bytes, return the checksum of the two
+ * pieces concatenated */
+uint64_t scr_checksum_combine(const char* name, uint64_t value1, uint64_t value2, unsigned long long length2);
+
+#endif
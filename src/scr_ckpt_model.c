@@ -0,0 +1,256 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Records checkpoint costs and interruptions in a file in the prefix
+ * directory, so that the optimal checkpoint interval can be computed
+ * from the history of the job across runs. */
+
+#include "scr.h"
+#include "scr_io.h"
+#include "scr_err.h"
+#include "scr_util.h"
+#include "scr_ckpt_model.h"
+
+#include "kvtree.h"
+#include "kvtree_util.h"
+#include "spath.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+
+/* statistics for this job, NULL if not initialized */
+static kvtree* scr_ckpt_model_stats = NULL;
+
+/* file to persist statistics */
+static spath* scr_ckpt_model_file = NULL;
+
+/* time at which this run started */
+static double scr_ckpt_model_start = 0.0;
+
+/* read a double from the hash, returns 0.0 if not set */
+static double scr_ckpt_model_get_double(const kvtree* hash, const char* key)
+{
+  double value;
+  if (kvtree_util_get_double(hash, key, &value) != KVTREE_SUCCESS) {
+    value = 0.0;
+  }
+  return value;
+}
+
+/* read an int from the hash, returns 0 if not set */
+static int scr_ckpt_model_get_int(const kvtree* hash, const char* key)
+{
+  int value;
+  if (kvtree_util_get_int(hash, key, &value) != KVTREE_SUCCESS) {
+    value = 0;
+  }
+  return value;
+}
+
+/* record seconds of current run and write statistics to the file */
+static int scr_ckpt_model_write(double now)
+{
+  kvtree_util_set_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_ACTIVE,
+    now - scr_ckpt_model_start
+  );
+
+  if (kvtree_write_path(scr_ckpt_model_file, scr_ckpt_model_stats) != KVTREE_SUCCESS) {
+    char path_err[SCR_MAX_FILENAME];
+    spath_strcpy(path_err, sizeof(path_err), scr_ckpt_model_file);
+    scr_err("Writing checkpoint statistics %s @ %s:%d",
+      path_err, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* given a model name, return its id, or SCR_CKPT_MODEL_NONE if not recognized */
+int scr_ckpt_model_from_str(const char* name)
+{
+  if (strcasecmp(name, "YOUNG") == 0) {
+    return SCR_CKPT_MODEL_YOUNG;
+  } else if (strcasecmp(name, "DALY") == 0) {
+    return SCR_CKPT_MODEL_DALY;
+  }
+  return SCR_CKPT_MODEL_NONE;
+}
+
+/* read statistics from the given file, count the previous run as
+ * interrupted if it never recorded its end, and mark this run as active */
+int scr_ckpt_model_init(const spath* file, double now)
+{
+  scr_ckpt_model_stats = kvtree_new();
+  scr_ckpt_model_file  = spath_dup(file);
+  scr_ckpt_model_start = now;
+
+  /* read in statistics from earlier runs if we have any */
+  char* path = spath_strdup(file);
+  if (scr_file_is_readable(path) == SCR_SUCCESS) {
+    if (kvtree_read_file(path, scr_ckpt_model_stats) != KVTREE_SUCCESS) {
+      scr_err("Reading checkpoint statistics %s @ %s:%d",
+        path, __FILE__, __LINE__
+      );
+      kvtree_unset_all(scr_ckpt_model_stats);
+    }
+  }
+  scr_free(&path);
+
+  /* the active marker is only removed when a run ends normally, so if we
+   * find one, the previous run was interrupted, count it as a failure */
+  double active;
+  if (kvtree_util_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_ACTIVE, &active) == KVTREE_SUCCESS) {
+    int failures = scr_ckpt_model_get_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_FAILURES);
+    double secs  = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_SECS);
+    kvtree_util_set_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_FAILURES, failures + 1);
+    kvtree_util_set_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_SECS, secs + active);
+  }
+
+  /* count this run */
+  int runs = scr_ckpt_model_get_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_RUNS);
+  kvtree_util_set_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_RUNS, runs + 1);
+
+  /* mark this run as active */
+  return scr_ckpt_model_write(now);
+}
+
+/* record the end of the run and free resources */
+int scr_ckpt_model_finalize(double now)
+{
+  if (scr_ckpt_model_stats == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* add time of this run to the total and clear the active marker */
+  double secs = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_SECS);
+  kvtree_util_set_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_SECS,
+    secs + (now - scr_ckpt_model_start)
+  );
+  kvtree_unset(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_ACTIVE);
+
+  int rc = SCR_SUCCESS;
+  if (kvtree_write_path(scr_ckpt_model_file, scr_ckpt_model_stats) != KVTREE_SUCCESS) {
+    char path_err[SCR_MAX_FILENAME];
+    spath_strcpy(path_err, sizeof(path_err), scr_ckpt_model_file);
+    scr_err("Writing checkpoint statistics %s @ %s:%d",
+      path_err, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  kvtree_delete(&scr_ckpt_model_stats);
+  spath_delete(&scr_ckpt_model_file);
+
+  return rc;
+}
+
+/* record the cost of a checkpoint that took secs seconds */
+int scr_ckpt_model_checkpoint(double secs, double now)
+{
+  if (scr_ckpt_model_stats == NULL) {
+    return SCR_FAILURE;
+  }
+
+  double total = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_SECS);
+  int count    = scr_ckpt_model_get_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_COUNT);
+  kvtree_util_set_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_SECS, total + secs);
+  kvtree_util_set_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_COUNT, count + 1);
+
+  /* also records how long this run has been going,
+   * in case we are interrupted before the next checkpoint */
+  return scr_ckpt_model_write(now);
+}
+
+/* record the cost of flushing a checkpoint that took secs seconds,
+ * this is written out with the next checkpoint or at the end of the run */
+int scr_ckpt_model_flush(double secs)
+{
+  if (scr_ckpt_model_stats == NULL) {
+    return SCR_FAILURE;
+  }
+
+  double total = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_FLUSH_SECS);
+  kvtree_util_set_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_FLUSH_SECS, total + secs);
+
+  return SCR_SUCCESS;
+}
+
+/* get total seconds and number of checkpoints recorded so far */
+int scr_ckpt_model_history(double* secs, int* count)
+{
+  *secs  = 0.0;
+  *count = 0;
+
+  if (scr_ckpt_model_stats == NULL) {
+    return SCR_FAILURE;
+  }
+
+  *secs  = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_SECS);
+  *count = scr_ckpt_model_get_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_COUNT);
+
+  return SCR_SUCCESS;
+}
+
+/* compute the optimal number of seconds between checkpoints with the
+ * given model, returns SCR_FAILURE if there is no cost estimate yet */
+int scr_ckpt_model_interval(int model, double now, double* interval)
+{
+  if (scr_ckpt_model_stats == NULL || model == SCR_CKPT_MODEL_NONE) {
+    return SCR_FAILURE;
+  }
+
+  /* we need at least one checkpoint to estimate its cost */
+  int count = scr_ckpt_model_get_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_COUNT);
+  if (count <= 0) {
+    return SCR_FAILURE;
+  }
+
+  /* we don't account for multi-level checkpointing, for a single-level
+   * cost, charge time spent flushing checkpoints to all checkpoints */
+  double ckpt_secs  = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_CKPT_SECS);
+  double flush_secs = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_FLUSH_SECS);
+  double cost = (ckpt_secs + flush_secs) / (double) count;
+
+  /* mean time to interrupt is the total run time over the number of
+   * interruptions, if we have not seen one yet, the run time so far
+   * is the best lower bound we have */
+  double secs  = scr_ckpt_model_get_double(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_SECS);
+  int failures = scr_ckpt_model_get_int(scr_ckpt_model_stats, SCR_CKPT_MODEL_KEY_FAILURES);
+  double mtbf = secs + (now - scr_ckpt_model_start);
+  if (failures > 0) {
+    mtbf /= (double) failures;
+  }
+  if (mtbf <= 0.0 || cost <= 0.0) {
+    return SCR_FAILURE;
+  }
+
+  double t;
+  if (model == SCR_CKPT_MODEL_YOUNG) {
+    /* "A First Order Approximation to the Optimum Checkpoint Interval", Young */
+    t = sqrt(2.0 * cost * mtbf);
+  } else {
+    /* "A Higher Order Estimate of the Optimum Checkpoint Interval for
+     * Restart Dumps", Daly, equation 37 */
+    double m2 = 2.0 * mtbf;
+    t = mtbf;
+    if (cost < m2) {
+      double f = cost / m2;
+      t = sqrt(cost * m2) * (1.0 + sqrt(f) / 3.0 + f / 9.0) - cost;
+    }
+  }
+
+  *interval = t;
+  return SCR_SUCCESS;
+}
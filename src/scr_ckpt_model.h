@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_CKPT_MODEL_H
+#define SCR_CKPT_MODEL_H
+
+#include "spath.h"
+
+/*
+=========================================
+This file tracks checkpoint costs and job interruptions across runs
+and computes an optimal checkpoint interval from them.  All functions
+are only called by rank 0.
+=========================================
+*/
+
+/* models to compute the optimal checkpoint interval */
+#define SCR_CKPT_MODEL_NONE  (0)
+#define SCR_CKPT_MODEL_YOUNG (1) /* Young: sqrt(2 * cost * mtbf) */
+#define SCR_CKPT_MODEL_DALY  (2) /* Daly: higher order estimate */
+
+/* keys in the checkpoint statistics file */
+#define SCR_CKPT_MODEL_KEY_RUNS       ("RUNS")       /* number of runs started */
+#define SCR_CKPT_MODEL_KEY_FAILURES   ("FAILURES")   /* number of runs that were interrupted */
+#define SCR_CKPT_MODEL_KEY_SECS       ("SECS")       /* total seconds of all earlier runs */
+#define SCR_CKPT_MODEL_KEY_CKPT_SECS  ("CKPT_SECS")  /* total seconds spent writing checkpoints */
+#define SCR_CKPT_MODEL_KEY_CKPT_COUNT ("CKPT_COUNT") /* number of checkpoints written */
+#define SCR_CKPT_MODEL_KEY_FLUSH_SECS ("FLUSH_SECS") /* total seconds spent flushing checkpoints */
+#define SCR_CKPT_MODEL_KEY_ACTIVE     ("ACTIVE")     /* seconds of current run, set while a run is active */
+
+/* given a model name, return its id, or SCR_CKPT_MODEL_NONE if not recognized */
+int scr_ckpt_model_from_str(const char* name);
+
+/* read statistics from the given file, count the previous run as
+ * interrupted if it never recorded its end, and mark this run as active,
+ * now is the current time in seconds */
+int scr_ckpt_model_init(const spath* file, double now);
+
+/* record the end of the run and free resources */
+int scr_ckpt_model_finalize(double now);
+
+/* record the cost of a checkpoint that took secs seconds */
+int scr_ckpt_model_checkpoint(double secs, double now);
+
+/* record the cost of flushing a checkpoint that took secs seconds */
+int scr_ckpt_model_flush(double secs);
+
+/* get total seconds and number of checkpoints recorded in earlier runs,
+ * to seed the cost estimate before this run writes its first checkpoint */
+int scr_ckpt_model_history(double* secs, int* count);
+
+/* compute the optimal number of seconds between checkpoints with the
+ * given model, returns SCR_FAILURE if there is no cost estimate yet */
+int scr_ckpt_model_interval(int model, double now, double* interval);
+
+#endif
@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+/* Implements chunked, multithreaded compression of files.
+ *
+ * A compressed file has the following layout, with all integers
+ * stored as 8-byte big-endian values:
+ *   magic       8 bytes  "SCRZ0001"
+ *   codec name  16 bytes (NUL-padded)
+ *   chunk size  bytes in each uncompressed chunk (last may be short)
+ *   file size   bytes in uncompressed file
+ *   chunks      number of chunks
+ *   table       compressed length of each chunk
+ *   data        compressed chunks, back to back
+ * Since the table gives the offset of every chunk, chunks can be
+ * decompressed independently of one another. */
+
+#include "scr_globals.h"
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define SCR_COMPRESS_MAGIC    ("SCRZ0001")
+#define SCR_COMPRESS_MAGICLEN (8)
+#define SCR_COMPRESS_NAMELEN  (16)
+#define SCR_COMPRESS_HDRLEN   (SCR_COMPRESS_MAGICLEN + SCR_COMPRESS_NAMELEN + 3 * 8)
+
+/* max number of codecs that can be registered */
+#define SCR_CODEC_MAX (16)
+
+/*
+=========================================
+Codecs
+=========================================
+*/
+
+static size_t scr_codec_zlib_bound(size_t count)
+{
+  return (size_t) compressBound((uLong) count);
+}
+
+static int scr_codec_zlib_compress(const void* src, size_t src_count, void* dst, size_t* dst_count)
+{
+  uLongf len = (uLongf) *dst_count;
+  if (compress2((Bytef*) dst, &len, (const Bytef*) src, (uLong) src_count, Z_BEST_SPEED) != Z_OK) {
+    return SCR_FAILURE;
+  }
+  *dst_count = (size_t) len;
+  return SCR_SUCCESS;
+}
+
+static int scr_codec_zlib_decompress(const void* src, size_t src_count, void* dst, size_t* dst_count)
+{
+  uLongf len = (uLongf) *dst_count;
+  if (uncompress((Bytef*) dst, &len, (const Bytef*) src, (uLong) src_count) != Z_OK) {
+    return SCR_FAILURE;
+  }
+  *dst_count = (size_t) len;
+  return SCR_SUCCESS;
+}
+
+static const scr_codec scr_codec_zlib = {
+  "zlib",
+  scr_codec_zlib_bound,
+  scr_codec_zlib_compress,
+  scr_codec_zlib_decompress,
+};
+
+/* list of available codecs, zlib is always available */
+static const scr_codec* scr_codecs[SCR_CODEC_MAX] = { &scr_codec_zlib };
+static int scr_codecs_count = 1;
+
+/* add a codec to the list of available codecs */
+int scr_codec_register(const scr_codec* codec)
+{
+  /* check that we have a valid name that fits in the file header */
+  if (codec == NULL || codec->name == NULL ||
+      strlen(codec->name) == 0 || strlen(codec->name) >= SCR_COMPRESS_NAMELEN)
+  {
+    scr_err("Invalid compression codec @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* don't allow two codecs with the same name */
+  if (scr_codec_lookup(codec->name) != NULL) {
+    scr_err("Compression codec `%s' is already registered @ %s:%d",
+      codec->name, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  if (scr_codecs_count >= SCR_CODEC_MAX) {
+    scr_err("Too many compression codecs registered @ %s:%d",
+      __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  scr_codecs[scr_codecs_count] = codec;
+  scr_codecs_count++;
+
+  return SCR_SUCCESS;
+}
+
+/* returns codec with given name, or NULL if not found */
+const scr_codec* scr_codec_lookup(const char* name)
+{
+  int i;
+  for (i = 0; i < scr_codecs_count; i++) {
+    if (strcmp(scr_codecs[i]->name, name) == 0) {
+      return scr_codecs[i];
+    }
+  }
+  return NULL;
+}
+
+/*
+=========================================
+Helper functions
+=========================================
+*/
+
+/* read count bytes from file at given offset, retry on short reads */
+static int scr_compress_pread(const char* file, int fd, void* buf, size_t count, off_t offset)
+{
+  char* ptr = (char*) buf;
+  while (count > 0) {
+    ssize_t rc = pread(fd, ptr, count, offset);
+    if (rc < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (rc <= 0) {
+      scr_err("Error reading %s at offset %llu: errno=%d %s @ %s:%d",
+        file, (unsigned long long) offset, errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+    ptr    += rc;
+    count  -= (size_t) rc;
+    offset += (off_t) rc;
+  }
+  return SCR_SUCCESS;
+}
+
+/* write count bytes to file at given offset, retry on short writes */
+static int scr_compress_pwrite(const char* file, int fd, const void* buf, size_t count, off_t offset)
+{
+  const char* ptr = (const char*) buf;
+  while (count > 0) {
+    ssize_t rc = pwrite(fd, ptr, count, offset);
+    if (rc < 0 && (errno == EINTR || errno == EAGAIN)) {
+      continue;
+    }
+    if (rc <= 0) {
+      scr_err("Error writing %s at offset %llu: errno=%d %s @ %s:%d",
+        file, (unsigned long long) offset, errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+    ptr    += rc;
+    count  -= (size_t) rc;
+    offset += (off_t) rc;
+  }
+  return SCR_SUCCESS;
+}
+
+/* describes the work to process a single chunk */
+typedef struct {
+  const scr_codec* codec;
+  int compress;         /* 1 to compress chunk, 0 to decompress */
+  const char* in_file;  /* file to read chunk from */
+  int in_fd;
+  off_t in_offset;      /* offset of chunk in input file */
+  size_t in_count;      /* number of bytes in input chunk */
+  char* in_buf;
+  const char* out_file; /* when decompressing, file to write chunk to */
+  int out_fd;
+  off_t out_offset;     /* when decompressing, offset of chunk in output file */
+  char* out_buf;
+  size_t out_size;      /* capacity of out_buf */
+  size_t out_count;     /* number of bytes produced */
+  int rc;
+} scr_compress_job;
+
+/* read, compress or decompress, and (when decompressing) write one chunk */
+static void* scr_compress_job_run(void* arg)
+{
+  scr_compress_job* job = (scr_compress_job*) arg;
+
+  job->rc = scr_compress_pread(job->in_file, job->in_fd, job->in_buf, job->in_count, job->in_offset);
+  if (job->rc != SCR_SUCCESS) {
+    return NULL;
+  }
+
+  job->out_count = job->out_size;
+  if (job->compress) {
+    job->rc = job->codec->compress(job->in_buf, job->in_count, job->out_buf, &job->out_count);
+  } else {
+    job->rc = job->codec->decompress(job->in_buf, job->in_count, job->out_buf, &job->out_count);
+    if (job->rc == SCR_SUCCESS) {
+      job->rc = scr_compress_pwrite(job->out_file, job->out_fd, job->out_buf, job->out_count, job->out_offset);
+    }
+  }
+  if (job->rc != SCR_SUCCESS) {
+    scr_err("Failed to %s chunk of %s with codec %s @ %s:%d",
+      job->compress ? "compress" : "decompress", job->in_file, job->codec->name, __FILE__, __LINE__
+    );
+  }
+
+  return NULL;
+}
+
+/* execute a batch of jobs concurrently, the calling thread runs
+ * the first job itself, returns SCR_SUCCESS if all jobs succeed */
+static int scr_compress_run(scr_compress_job* jobs, int count)
+{
+  int i;
+  pthread_t* tids = (pthread_t*) SCR_MALLOC(count * sizeof(pthread_t));
+  int* started = (int*) SCR_MALLOC(count * sizeof(int));
+
+  /* start a thread for each job after the first */
+  for (i = 1; i < count; i++) {
+    started[i] = (pthread_create(&tids[i], NULL, scr_compress_job_run, &jobs[i]) == 0);
+    if (! started[i]) {
+      /* failed to start a thread, so just run the job here */
+      scr_compress_job_run(&jobs[i]);
+    }
+  }
+
+  /* process the first job ourself */
+  if (count > 0) {
+    scr_compress_job_run(&jobs[0]);
+  }
+
+  /* wait for other threads to finish */
+  int rc = SCR_SUCCESS;
+  for (i = 0; i < count; i++) {
+    if (i > 0 && started[i]) {
+      pthread_join(tids[i], NULL);
+    }
+    if (jobs[i].rc != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  scr_free(&started);
+  scr_free(&tids);
+
+  return rc;
+}
+
+/*
+=========================================
+Compress and decompress files
+=========================================
+*/
+
+/* compress src file into dst file using chunks of chunk_size bytes */
+int scr_compress_file(
+  const char* src_file,
+  const char* dst_file,
+  const scr_codec* codec,
+  size_t chunk_size,
+  int threads,
+  unsigned long* out_bytes)
+{
+  int rc = SCR_SUCCESS;
+  *out_bytes = 0;
+
+  if (chunk_size == 0) {
+    chunk_size = SCR_COMPRESS_CHUNK;
+  }
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  /* open source file and get its size */
+  int fd_src = scr_open(src_file, O_RDONLY);
+  if (fd_src < 0) {
+    scr_err("Opening file to compress: %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  struct stat stat_buf;
+  if (fstat(fd_src, &stat_buf) != 0) {
+    scr_err("Failed to stat %s: errno=%d %s @ %s:%d",
+      src_file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+  uint64_t file_size  = (uint64_t) stat_buf.st_size;
+  uint64_t num_chunks = (file_size + chunk_size - 1) / chunk_size;
+
+  /* open destination file */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd_dst = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd_dst < 0) {
+    scr_err("Opening file for writing: %s @ %s:%d",
+      dst_file, __FILE__, __LINE__
+    );
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+
+  /* build header, we fill in the table after compressing each chunk */
+  size_t header_size = SCR_COMPRESS_HDRLEN + num_chunks * 8;
+  unsigned char* header = (unsigned char*) SCR_MALLOC(header_size);
+  memset(header, 0, header_size);
+  memcpy(header, SCR_COMPRESS_MAGIC, SCR_COMPRESS_MAGICLEN);
+  strncpy((char*) header + SCR_COMPRESS_MAGICLEN, codec->name, SCR_COMPRESS_NAMELEN - 1);
+  unsigned char* fields = header + SCR_COMPRESS_MAGICLEN + SCR_COMPRESS_NAMELEN;
+  scr_pack_be(fields + 0,  (uint64_t) chunk_size, 8);
+  scr_pack_be(fields + 8,  file_size, 8);
+  scr_pack_be(fields + 16, num_chunks, 8);
+  unsigned char* table = header + SCR_COMPRESS_HDRLEN;
+
+  /* allocate a job and buffers for each thread */
+  size_t bound = codec->bound(chunk_size);
+  scr_compress_job* jobs = (scr_compress_job*) SCR_MALLOC(threads * sizeof(scr_compress_job));
+  int i;
+  for (i = 0; i < threads; i++) {
+    jobs[i].codec    = codec;
+    jobs[i].compress = 1;
+    jobs[i].in_file  = src_file;
+    jobs[i].in_fd    = fd_src;
+    jobs[i].in_buf   = (char*) SCR_MALLOC(chunk_size);
+    jobs[i].out_file = dst_file;
+    jobs[i].out_fd   = fd_dst;
+    jobs[i].out_buf  = (char*) SCR_MALLOC(bound);
+    jobs[i].out_size = bound;
+  }
+
+  /* compress chunks in batches, one chunk per thread,
+   * then append the compressed chunks to the file in order */
+  off_t pos = (off_t) header_size;
+  uint64_t chunk;
+  for (chunk = 0; chunk < num_chunks && rc == SCR_SUCCESS; chunk += threads) {
+    int count = threads;
+    if (chunk + count > num_chunks) {
+      count = (int) (num_chunks - chunk);
+    }
+    for (i = 0; i < count; i++) {
+      uint64_t offset = (chunk + i) * chunk_size;
+      jobs[i].in_offset = (off_t) offset;
+      jobs[i].in_count  = (size_t) ((file_size - offset < chunk_size) ? file_size - offset : chunk_size);
+    }
+
+    rc = scr_compress_run(jobs, count);
+
+    for (i = 0; i < count && rc == SCR_SUCCESS; i++) {
+      rc = scr_compress_pwrite(dst_file, fd_dst, jobs[i].out_buf, jobs[i].out_count, pos);
+      scr_pack_be(table + (chunk + i) * 8, (uint64_t) jobs[i].out_count, 8);
+      pos += (off_t) jobs[i].out_count;
+    }
+  }
+
+  /* write the header now that we have the chunk table */
+  if (rc == SCR_SUCCESS) {
+    rc = scr_compress_pwrite(dst_file, fd_dst, header, header_size, 0);
+  }
+
+  /* free jobs */
+  for (i = 0; i < threads; i++) {
+    scr_free(&jobs[i].in_buf);
+    scr_free(&jobs[i].out_buf);
+  }
+  scr_free(&jobs);
+  scr_free(&header);
+
+  if (scr_close(dst_file, fd_dst) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src_file, fd_src);
+
+  if (rc == SCR_SUCCESS) {
+    *out_bytes = (unsigned long) pos;
+  } else {
+    scr_file_unlink(dst_file);
+  }
+
+  return rc;
+}
+
+/* decompress src file written by scr_compress_file into dst file */
+int scr_decompress_file(
+  const char* src_file,
+  const char* dst_file,
+  int threads,
+  unsigned long* out_bytes)
+{
+  int rc = SCR_SUCCESS;
+  *out_bytes = 0;
+
+  if (threads < 1) {
+    threads = 1;
+  }
+
+  /* open source file */
+  int fd_src = scr_open(src_file, O_RDONLY);
+  if (fd_src < 0) {
+    scr_err("Opening file to decompress: %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* read and check fixed portion of header */
+  unsigned char fixed[SCR_COMPRESS_HDRLEN];
+  if (scr_compress_pread(src_file, fd_src, fixed, sizeof(fixed), 0) != SCR_SUCCESS ||
+      memcmp(fixed, SCR_COMPRESS_MAGIC, SCR_COMPRESS_MAGICLEN) != 0)
+  {
+    scr_err("Invalid compressed file header in %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+
+  /* lookup codec used to compress the file */
+  char name[SCR_COMPRESS_NAMELEN];
+  memcpy(name, fixed + SCR_COMPRESS_MAGICLEN, SCR_COMPRESS_NAMELEN);
+  name[SCR_COMPRESS_NAMELEN - 1] = '\0';
+  const scr_codec* codec = scr_codec_lookup(name);
+  if (codec == NULL) {
+    scr_err("Unknown compression codec `%s' in %s @ %s:%d",
+      name, src_file, __FILE__, __LINE__
+    );
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+
+  unsigned char* fields = fixed + SCR_COMPRESS_MAGICLEN + SCR_COMPRESS_NAMELEN;
+  uint64_t chunk_size = scr_unpack_be(fields + 0, 8);
+  uint64_t file_size  = scr_unpack_be(fields + 8, 8);
+  uint64_t num_chunks = scr_unpack_be(fields + 16, 8);
+  if (chunk_size == 0 || num_chunks != (file_size + chunk_size - 1) / chunk_size) {
+    scr_err("Invalid chunk size or count in %s @ %s:%d",
+      src_file, __FILE__, __LINE__
+    );
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+
+  /* read the chunk table */
+  size_t table_size = num_chunks * 8;
+  unsigned char* table = (unsigned char*) SCR_MALLOC(table_size);
+  if (scr_compress_pread(src_file, fd_src, table, table_size, SCR_COMPRESS_HDRLEN) != SCR_SUCCESS) {
+    scr_free(&table);
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+
+  /* open destination file */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd_dst = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd_dst < 0) {
+    scr_err("Opening file for writing: %s @ %s:%d",
+      dst_file, __FILE__, __LINE__
+    );
+    scr_free(&table);
+    scr_close(src_file, fd_src);
+    return SCR_FAILURE;
+  }
+
+  /* allocate a job and buffers for each thread */
+  size_t bound = codec->bound((size_t) chunk_size);
+  scr_compress_job* jobs = (scr_compress_job*) SCR_MALLOC(threads * sizeof(scr_compress_job));
+  int i;
+  for (i = 0; i < threads; i++) {
+    jobs[i].codec    = codec;
+    jobs[i].compress = 0;
+    jobs[i].in_file  = src_file;
+    jobs[i].in_fd    = fd_src;
+    jobs[i].in_buf   = (char*) SCR_MALLOC(bound);
+    jobs[i].out_file = dst_file;
+    jobs[i].out_fd   = fd_dst;
+    jobs[i].out_buf  = (char*) SCR_MALLOC((size_t) chunk_size);
+    jobs[i].out_size = (size_t) chunk_size;
+  }
+
+  /* decompress chunks in batches, since we know where each chunk
+   * starts in both files, each thread writes its chunk directly */
+  off_t pos = (off_t) (SCR_COMPRESS_HDRLEN + table_size);
+  uint64_t chunk;
+  for (chunk = 0; chunk < num_chunks && rc == SCR_SUCCESS; chunk += threads) {
+    int count = threads;
+    if (chunk + count > num_chunks) {
+      count = (int) (num_chunks - chunk);
+    }
+    for (i = 0; i < count; i++) {
+      uint64_t length = scr_unpack_be(table + (chunk + i) * 8, 8);
+      if (length > bound) {
+        scr_err("Invalid chunk length in %s @ %s:%d",
+          src_file, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+        break;
+      }
+      jobs[i].in_offset  = pos;
+      jobs[i].in_count   = (size_t) length;
+      jobs[i].out_offset = (off_t) ((chunk + i) * chunk_size);
+      pos += (off_t) length;
+    }
+
+    if (rc == SCR_SUCCESS) {
+      rc = scr_compress_run(jobs, count);
+    }
+
+    /* verify that each chunk expanded to its full size */
+    for (i = 0; i < count && rc == SCR_SUCCESS; i++) {
+      uint64_t offset = (chunk + i) * chunk_size;
+      uint64_t expect = (file_size - offset < chunk_size) ? file_size - offset : chunk_size;
+      if ((uint64_t) jobs[i].out_count != expect) {
+        scr_err("Chunk at offset %llu of %s decompressed to %llu bytes, expected %llu @ %s:%d",
+          (unsigned long long) offset, src_file,
+          (unsigned long long) jobs[i].out_count, (unsigned long long) expect,
+          __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+    }
+  }
+
+  /* free jobs */
+  for (i = 0; i < threads; i++) {
+    scr_free(&jobs[i].in_buf);
+    scr_free(&jobs[i].out_buf);
+  }
+  scr_free(&jobs);
+  scr_free(&table);
+
+  if (scr_close(dst_file, fd_dst) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
+  scr_close(src_file, fd_src);
+
+  if (rc == SCR_SUCCESS) {
+    *out_bytes = (unsigned long) file_size;
+  } else {
+    scr_file_unlink(dst_file);
+  }
+
+  return rc;
+}
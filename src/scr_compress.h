@@ -0,0 +1,71 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_COMPRESS_H
+#define SCR_COMPRESS_H
+
+#include <stddef.h>
+
+/* file name extension used for compressed files */
+#define SCR_COMPRESS_EXT (".scrz")
+
+/* a compression codec operates on a single chunk held in memory,
+ * compress and decompress are called concurrently from multiple
+ * threads, so they must not modify any shared state */
+typedef struct {
+  const char* name; /* name used in SCR_FLUSH_COMPRESS and in file headers */
+
+  /* returns max number of bytes compress may produce from count bytes */
+  size_t (*bound)(size_t count);
+
+  /* compress src_count bytes from src into dst, which has space for
+   * *dst_count bytes, sets *dst_count to the number of bytes written,
+   * returns SCR_SUCCESS on success */
+  int (*compress)(const void* src, size_t src_count, void* dst, size_t* dst_count);
+
+  /* decompress src_count bytes from src into dst, which has space for
+   * *dst_count bytes, sets *dst_count to the number of bytes written,
+   * returns SCR_SUCCESS on success */
+  int (*decompress)(const void* src, size_t src_count, void* dst, size_t* dst_count);
+} scr_codec;
+
+/* add a codec to the list of available codecs, the codec structure
+ * must remain valid until the library is finalized */
+int scr_codec_register(const scr_codec* codec);
+
+/* returns codec with given name, or NULL if not found */
+const scr_codec* scr_codec_lookup(const char* name);
+
+/* compress src file into dst file by splitting it into chunks of
+ * chunk_size bytes which are compressed using up to threads threads,
+ * the size of each compressed chunk is recorded in the header of dst
+ * so that chunks can later be decompressed in parallel, returns the
+ * number of bytes written to dst in out_bytes */
+int scr_compress_file(
+  const char* src_file,
+  const char* dst_file,
+  const scr_codec* codec,
+  size_t chunk_size,
+  int threads,
+  unsigned long* out_bytes
+);
+
+/* decompress src file written by scr_compress_file into dst file,
+ * using up to threads threads, returns the number of bytes written
+ * to dst in out_bytes */
+int scr_decompress_file(
+  const char* src_file,
+  const char* dst_file,
+  int threads,
+  unsigned long* out_bytes
+);
+
+#endif
@@ -152,6 +152,33 @@
 #define SCR_FILE_BUF_SIZE (1024*1024)
 #endif
 
+/* number of buffers used to overlap reads and writes when copying a file */
+#ifndef SCR_FILE_COPY_BUFS
+#define SCR_FILE_COPY_BUFS (2)
+#endif
+
+/* whether to copy files with O_DIRECT, a bitmask of
+ * SCR_FILE_COPY_DIRECT_SRC (1) and SCR_FILE_COPY_DIRECT_DST (2) */
+#ifndef SCR_FILE_COPY_DIRECT
+#define SCR_FILE_COPY_DIRECT (0)
+#endif
+
+/* whether to first try to copy files within the kernel,
+ * via reflink, copy_file_range, or sendfile */
+#ifndef SCR_FILE_COPY_KERNEL
+#define SCR_FILE_COPY_KERNEL (1)
+#endif
+
+/* max number of bytes to request in a single kernel copy call */
+#ifndef SCR_FILE_COPY_KERNEL_CHUNK
+#define SCR_FILE_COPY_KERNEL_CHUNK (1024*1024*1024)
+#endif
+
+/* alignment of buffers, offsets, and lengths for O_DIRECT */
+#ifndef SCR_FILE_COPY_ALIGN
+#define SCR_FILE_COPY_ALIGN (4096)
+#endif
+
 /* whether file metadata should also be copied */
 #ifndef SCR_COPY_METADATA
 #define SCR_COPY_METADATA (1)
@@ -172,6 +199,11 @@
 #define SCR_DISTRIBUTE (1)
 #endif
 
+/* whether to restore datasets that fail to rebuild by fetching only the lost files */
+#ifndef SCR_DISTRIBUTE_RESTORE
+#define SCR_DISTRIBUTE_RESTORE (1)
+#endif
+
 /* whether fetch operations should be enabled by default */
 #ifndef SCR_FETCH
 #define SCR_FETCH (1)
@@ -182,6 +214,32 @@
 #define SCR_FETCH_WIDTH (256)
 #endif
 
+/* whether the leader of each storage group should read files for all procs in its group */
+#ifndef SCR_FETCH_AGGREGATE
+#define SCR_FETCH_AGGREGATE (0)
+#endif
+
+/* whether to return from SCR_Init while files are fetched in the background */
+#ifndef SCR_FETCH_STREAM
+#define SCR_FETCH_STREAM (0)
+#endif
+
+/* whether processes that hold valid files in cache skip them during fetch */
+#ifndef SCR_FETCH_PARTIAL
+#define SCR_FETCH_PARTIAL (1)
+#endif
+
+/* whether to read metadata of the fallback checkpoint during a fetch */
+#ifndef SCR_FETCH_PREFETCH
+#define SCR_FETCH_PREFETCH (0)
+#endif
+
+/* whether to restart on a different number of processes by
+ * redistributing the files of the dataset */
+#ifndef SCR_FETCH_REMAP
+#define SCR_FETCH_REMAP (0)
+#endif
+
 /* AXL type to use when fetching datasets */
 #ifndef SCR_FETCH_TYPE
 #define SCR_FETCH_TYPE ("SYNC")
@@ -202,6 +260,11 @@
 #define SCR_FLUSH_WIDTH (SCR_FETCH_WIDTH)
 #endif
 
+/* whether the leader of each storage group should write files for all procs in its group */
+#ifndef SCR_FLUSH_AGGREGATE
+#define SCR_FLUSH_AGGREGATE (0)
+#endif
+
 /* AXL type to use when flushing datasets */
 #ifndef SCR_FLUSH_TYPE
 #define SCR_FLUSH_TYPE ("SYNC")
@@ -222,14 +285,49 @@
 #define SCR_FLUSH_ASYNC (0)
 #endif
 
-/* aggregrate bandwidth limit to impose during asynchronous flushes */
+/* aggregrate bandwidth limit to impose during asynchronous flushes in bytes/sec (0 disables) */
 #ifndef SCR_FLUSH_ASYNC_BW
-#define SCR_FLUSH_ASYNC_BW (200*1024*1024)
+#define SCR_FLUSH_ASYNC_BW (0)
 #endif
 
-/* maximum percent cpu time allowed during asynchronous flushes (does not yet work well) */
+/* maximum percent of wall time with active transfers during asynchronous flushes (0 disables) */
 #ifndef SCR_FLUSH_ASYNC_PERCENT
-#define SCR_FLUSH_ASYNC_PERCENT (0.0) /* TODO: the fsync complicates this throttling, disable it for now */
+#define SCR_FLUSH_ASYNC_PERCENT (0.0)
+#endif
+
+/* max number of asynchronous flushes that may be in progress at once */
+#ifndef SCR_FLUSH_ASYNC_DEPTH
+#define SCR_FLUSH_ASYNC_DEPTH (1)
+#endif
+
+/* number of bytes in each chunk when compressing files during a flush */
+#ifndef SCR_COMPRESS_CHUNK
+#define SCR_COMPRESS_CHUNK (4*1024*1024)
+#endif
+
+/* number of threads each process uses to compress and decompress files */
+#ifndef SCR_COMPRESS_THREADS
+#define SCR_COMPRESS_THREADS (4)
+#endif
+
+/* whether to pack files into a few large container files during a flush */
+#ifndef SCR_USE_CONTAINERS
+#define SCR_USE_CONTAINERS (0)
+#endif
+
+/* max number of bytes to write to a container file */
+#ifndef SCR_CONTAINER_SIZE
+#define SCR_CONTAINER_SIZE (100ULL*1024*1024*1024)
+#endif
+
+/* each file starts at a multiple of this many bytes within a container */
+#ifndef SCR_CONTAINER_ALIGN
+#define SCR_CONTAINER_ALIGN (1024*1024)
+#endif
+
+/* number of files to split the rank2file map of a dataset across */
+#ifndef SCR_RANK2FILE_STRIPES
+#define SCR_RANK2FILE_STRIPES (1)
 #endif
 
 /* max number of checkpoints to keep in prefix (0 disables) */
@@ -256,6 +354,24 @@
 #define SCR_CRC_ON_DELETE (0)
 #endif
 
+/* whether to compute redundancy data in the background after
+ * SCR_Complete_output returns, requires MPI_THREAD_MULTIPLE */
+#ifndef SCR_ENCODE_ASYNC
+#define SCR_ENCODE_ASYNC (0)
+#endif
+
+/* number of threads each process uses to compute checksums,
+ * 0 divides the cores on the node among the processes on the node */
+#ifndef SCR_CRC_THREADS
+#define SCR_CRC_THREADS (0)
+#endif
+
+/* files larger than this are checksummed in pieces of this size
+ * in parallel, when the checksum algorithm allows */
+#ifndef SCR_CRC_CHUNK
+#define SCR_CRC_CHUNK (64*1024*1024)
+#endif
+
 /* =========================================================================
  * The following settings adjust when SCR_Need_checkpoint() will return true.
  * If all settings are 0, all options are disabled and Need_checkpoint() always returns true.
@@ -276,6 +392,19 @@
 #define SCR_CHECKPOINT_OVERHEAD (0)
 #endif
 
+/* whether SCR_Need_checkpoint avoids global synchronization by
+ * returning the decision rank 0 made during the previous call */
+#ifndef SCR_NEED_CHECKPOINT_NONBLOCKING
+#define SCR_NEED_CHECKPOINT_NONBLOCKING (0)
+#endif
+
+/* model to compute the optimal time between checkpoints from the
+ * checkpoint cost and interruptions recorded across runs,
+ * 0 to disable, 1 for Young, 2 for Daly */
+#ifndef SCR_CHECKPOINT_MODEL
+#define SCR_CHECKPOINT_MODEL (0)
+#endif
+
 /* =========================================================================
  * The following applies to the scr_transfer process.
  * ========================================================================= */
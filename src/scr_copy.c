@@ -61,6 +61,8 @@ struct arglist {
   int id;                 /* dataset id */
   char* prefix;           /* prefix directory */
   unsigned long buf_size; /* number of bytes to copy file data to file system */
+  int num_bufs;           /* number of buffers to overlap reads and writes */
+  int direct;             /* whether to copy file data with O_DIRECT */
   int crc_flag;           /* whether to compute crc32 during copy */
   int partner_flag;       /* whether to copy data for partner */
 };
@@ -73,6 +75,8 @@ int process_args(int argc, char **argv, struct arglist* args)
     {"id",         required_argument, NULL, 'i'},
     {"prefix",     required_argument, NULL, 'd'},
     {"buf",        required_argument, NULL, 'b'},
+    {"bufs",       required_argument, NULL, 'n'},
+    {"direct",     no_argument,       NULL, 'D'},
     {"crc",        no_argument,       NULL, 'r'},
     {"partner",    no_argument,       NULL, 'p'},
     {0, 0, 0, 0}
@@ -83,6 +87,8 @@ int process_args(int argc, char **argv, struct arglist* args)
   args->id             = -1;
   args->prefix         = NULL;
   args->buf_size       = SCR_FILE_BUF_SIZE;
+  args->num_bufs       = SCR_FILE_COPY_BUFS;
+  args->direct         = SCR_FILE_COPY_DIRECT;
   args->crc_flag       = SCR_CRC_ON_FLUSH;
   args->partner_flag   = 0;
 
@@ -92,7 +98,7 @@ int process_args(int argc, char **argv, struct arglist* args)
   do {
     /* read in our next option */
     int option_index = 0;
-    c = getopt_long(argc, argv, "c:i:d:b:rph", long_options, &option_index);
+    c = getopt_long(argc, argv, "c:i:d:b:n:Drph", long_options, &option_index);
     switch (c) {
       case 'c':
         /* control directory */
@@ -123,6 +129,20 @@ int process_args(int argc, char **argv, struct arglist* args)
         }
         args->buf_size = (unsigned long) bytes;
         break;
+      case 'n':
+        /* number of buffers to overlap reads and writes */
+        args->num_bufs = atoi(optarg);
+        if (args->num_bufs < 2) {
+          scr_err("%s: Number of buffers must be at least 2 '--bufs %s'",
+            PROG, optarg
+          );
+          return 0;
+        }
+        break;
+      case 'D':
+        /* read cache and write file system with O_DIRECT */
+        args->direct = SCR_FILE_COPY_DIRECT_SRC | SCR_FILE_COPY_DIRECT_DST;
+        break;
       case 'r':
         /* compute and record crc32 during copy */
         args->crc_flag = 1;
@@ -345,17 +365,24 @@ static int copy_files_for_filemap(
       spath_reduce(dst_path);
       char* dst_file = spath_strdup(dst_path);
   
-      /* copy the file and optionally compute the crc during the copy */
+      /* verify with the algorithm of a recorded checksum, if any,
+       * otherwise record a checksum using the fastest algorithm */
+      char* meta_name;
+      uint64_t meta_value;
+      int meta_valid = (scr_meta_get_checksum(meta, &meta_name, &meta_value) == SCR_SUCCESS);
+      const char* name = meta_valid ? meta_name : scr_checksum_default();
+
+      /* copy the file and optionally compute the checksum during the copy */
       int crc_valid = 0;
-      uLong crc = crc32(0L, Z_NULL, 0);
-      uLong* crc_p = NULL;
-      if (args->crc_flag) {
+      scr_checksum ck;
+      scr_checksum* crc_p = NULL;
+      if (args->crc_flag && scr_checksum_init(&ck, name) == SCR_SUCCESS) {
         crc_valid = 1;
-        crc_p = &crc;
+        crc_p = &ck;
       }
       if (strcmp(file, dst_file) != 0) {
         /* in case of bypass, only copy file if source and dest paths are different */
-        if (scr_file_copy(file, dst_file, args->buf_size, crc_p) != SCR_SUCCESS) {
+        if (scr_file_copy_pipeline(file, dst_file, args->buf_size, args->num_bufs, args->direct, crc_p) != SCR_SUCCESS) {
           crc_valid = 0;
           rc = 1;
         }
@@ -376,12 +403,12 @@ static int copy_files_for_filemap(
       /* add this file to the rank_map */
       scr_filemap_add_file(rank_map, file);
   
-      /* if file has crc32, check it against the one computed during
-       * the copy, otherwise if crc_flag is set, record crc32 */
+      /* if file has a checksum, check it against the one computed during
+       * the copy, otherwise if crc_flag is set, record the checksum */
       if (crc_valid) {
-        uLong meta_crc;
-        if (scr_meta_get_crc32(meta, &meta_crc) == SCR_SUCCESS) {
-          if (crc != meta_crc) {
+        uint64_t value = scr_checksum_value(&ck);
+        if (meta_valid) {
+          if (value != meta_value) {
             /* detected a crc mismatch during the copy */
   
             /* TODO: unlink the copied file */
@@ -391,8 +418,8 @@ static int copy_files_for_filemap(
             scr_meta_set_complete(meta, 0);
   
             rc = 1;
-            scr_err("scr_copy: CRC32 mismatch detected when flushing file %s to %s @ %s:%d",
-              file, dst_file, __FILE__, __LINE__
+            scr_err("scr_copy: %s mismatch detected when flushing file %s to %s @ %s:%d",
+              name, file, dst_file, __FILE__, __LINE__
             );
   
             /* TODO: would be good to log this, but right now only
@@ -404,9 +431,9 @@ static int copy_files_for_filemap(
             */
           }
         } else {
-          /* the crc was not already in the metafile, but we just
+          /* the checksum was not already in the metafile, but we just
            * computed it, so set it */
-          scr_meta_set_crc32(meta, crc);
+          scr_meta_set_checksum(meta, name, value);
         }
       }
   
@@ -440,7 +467,7 @@ static int copy_files_for_filemap(
   }
 #endif
   char* dst_filemap = spath_strdup(path_rank);
-  if (scr_file_copy(src_filemap, dst_filemap, args->buf_size, NULL) != SCR_SUCCESS) {
+  if (scr_file_copy_pipeline(src_filemap, dst_filemap, args->buf_size, args->num_bufs, args->direct, NULL) != SCR_SUCCESS) {
     rc = 1;
   }
   scr_free(&dst_filemap);
@@ -477,7 +504,7 @@ static int copy_files_redset(
   char* dst_file = spath_strdup(dst_path);
 
   /* copy redset file to prefix directory */
-  if (scr_file_copy(file, dst_file, args->buf_size, NULL) != SCR_SUCCESS) {
+  if (scr_file_copy_pipeline(file, dst_file, args->buf_size, args->num_bufs, args->direct, NULL) != SCR_SUCCESS) {
     rc = 1;
   }
 
@@ -11,7 +11,9 @@
 
 /* Utility to compute the crc32 value of a file.
  * Given a filename as a command line argument,
- * compute and print out that file's crc32 value. */
+ * compute and print out that file's crc32 value.
+ * An optional second argument names a different checksum
+ * algorithm, e.g., CRC32C or HASH64. */
 
 #include "scr.h"
 #include "scr_io.h"
@@ -42,17 +44,23 @@ int main(int argc, char* argv[])
   /* read in the filename */
   char* filename = strdup(argv[1]);
 
+  /* get the checksum algorithm, default to crc32 */
+  const char* name = SCR_CHECKSUM_CRC32;
+  if (argc > 2) {
+    name = argv[2];
+  }
+
   /* open the file for reading */
-  uLong crc = crc32(0L, Z_NULL, 0);
-  if (scr_crc32(filename, &crc) != SCR_SUCCESS) {
-    scr_err("Failed to compute CRC32 for file %s @ file %s:%d",
-            filename, __FILE__, __LINE__
+  uint64_t value;
+  if (scr_checksum_file(filename, name, &value) != SCR_SUCCESS) {
+    scr_err("Failed to compute %s for file %s @ file %s:%d",
+            name, filename, __FILE__, __LINE__
     );
     return 1;
   }
 
-  /* print out the crc32 value */
-  printf("%lx\n", (unsigned long) crc);
+  /* print out the checksum value */
+  printf("%llx\n", (unsigned long long) value);
 
   /* free off the string we strdup'ed at the start */
   scr_free(&filename);
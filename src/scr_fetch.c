@@ -37,6 +37,8 @@
 #include "kvtree_util.h"
 #include "axl_mpi.h"
 
+#include <pthread.h>
+
 /*
 =========================================
 Fetch functions
@@ -57,18 +59,209 @@ Fetch functions
  *        - Optionally check CRC32 values as files are read in
  *   6) If successful, stop, otherwise mark this checkpoint as bad
  *      and repeat #2
+ *
+ * With SCR_FETCH_STREAM, step 5 only records the list of files and
+ * starts a thread on each process to copy its files in the background,
+ * in the order the application routed them when it wrote the checkpoint.
+ * SCR_Route_file waits for the file it was asked for, and the remaining
+ * work of the fetch (redundancy encoding, flush file) is done in
+ * scr_fetch_stream_finish once all files have arrived.
  */
 
-/* read contents of summary file */
+/* read the summary file in the given dataset directory into header,
+ * only called by rank 0 */
+static int scr_fetch_summary_read(const char* summary_dir, kvtree* header)
+{
+  int rc = SCR_SUCCESS;
+
+  /* build path to summary file */
+  spath* summary_path = spath_from_str(summary_dir);
+  spath_reduce(summary_path);
+  spath_append_str(summary_path, "summary.scr");
+  const char* summary_file = spath_strdup(summary_path);
+
+  /* open file for reading */
+  int fd = scr_open(summary_file, O_RDONLY);
+  if (fd >= 0) {
+    /* read summary hash */
+    ssize_t header_size = kvtree_read_fd(summary_file, fd, header);
+    if (header_size < 0) {
+      rc = SCR_FAILURE;
+    }
+
+    /* TODO: check that the version is correct */
+
+    /* close the file */
+    scr_close(summary_file, fd);
+  } else {
+    scr_err("Failed to open summary file %s @ %s:%d",
+      summary_file, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  /* free summary path and string */
+  scr_free(&summary_file);
+  spath_delete(&summary_path);
+
+  return rc;
+}
+
+/* metadata of the checkpoint scr_fetch_latest will try next if the
+ * current one fails, read in the background during the current fetch */
+typedef struct {
+  int id;                   /* dataset id being prefetched */
+  char* fetch_dir;          /* dataset directory in prefix */
+  unsigned long per_stripe; /* ranks per rank2file stripe, 0 if no binary manifest */
+  kvtree* header;           /* summary file, only read on rank 0 */
+  kvtree* filelist;         /* rank2file entry of this process */
+  MPI_Comm stripe_comm;     /* procs whose entries are in our rank2file stripe */
+  char* stripe_buf;         /* stripe file, only read on rank 0 of stripe_comm */
+  size_t stripe_size;       /* size of stripe_buf in bytes */
+  int rc;                   /* SCR_SUCCESS if this process read its part */
+  pthread_t thread;         /* thread reading the metadata */
+} scr_fetch_prefetch_state;
+
+/* prefetch in progress, NULL if none */
+static scr_fetch_prefetch_state* scr_fetch_prefetch_st = NULL;
+
+static void scr_fetch_prefetch_state_free(scr_fetch_prefetch_state** ptr_st)
+{
+  scr_fetch_prefetch_state* st = *ptr_st;
+  if (st == NULL) {
+    return;
+  }
+  scr_free(&st->fetch_dir);
+  kvtree_delete(&st->header);
+  kvtree_delete(&st->filelist);
+  scr_free(&st->stripe_buf);
+  if (st->stripe_comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&st->stripe_comm);
+  }
+  scr_free(ptr_st);
+}
+
+/* reads summary on rank 0 and, so that only one process per stripe
+ * touches the file system while the current fetch is running, the
+ * rank2file stripe on the first rank of each stripe, entries are
+ * handed out to the other ranks in scr_fetch_prefetch_finish */
+static void* scr_fetch_prefetch_thread(void* arg)
+{
+  scr_fetch_prefetch_state* st = (scr_fetch_prefetch_state*) arg;
+
+  if (scr_my_rank_world == 0) {
+    if (scr_fetch_summary_read(st->fetch_dir, st->header) != SCR_SUCCESS) {
+      st->rc = SCR_FAILURE;
+    }
+  }
+
+  /* the kvtree map of older datasets can only be read collectively */
+  if (st->per_stripe > 0 && (unsigned long) scr_my_rank_world % st->per_stripe == 0) {
+    int stripe = (int) ((unsigned long) scr_my_rank_world / st->per_stripe);
+    if (scr_rank2file_load_stripe(st->fetch_dir, stripe, &st->stripe_buf, &st->stripe_size) != SCR_SUCCESS) {
+      st->rc = SCR_FAILURE;
+    }
+  }
+
+  return NULL;
+}
+
+/* start reading metadata of the given dataset in the background,
+ * this must be called by all procs */
+static void scr_fetch_prefetch_start(int id)
+{
+  scr_fetch_prefetch_state* st = (scr_fetch_prefetch_state*) SCR_MALLOC(sizeof(scr_fetch_prefetch_state));
+  st->id          = id;
+  st->header      = kvtree_new();
+  st->filelist    = kvtree_new();
+  st->stripe_comm = MPI_COMM_NULL;
+  st->stripe_buf  = NULL;
+  st->stripe_size = 0;
+  st->rc          = SCR_SUCCESS;
+
+  /* get path to dataset metadata directory in prefix as string */
+  spath* path = spath_from_str(scr_prefix_scr);
+  spath_append_strf(path, "scr.dataset.%d", id);
+  st->fetch_dir = spath_strdup(path);
+  spath_delete(&path);
+
+  /* the layout of the rank2file manifest is read collectively,
+   * if it can't be read or was written by a job of a different
+   * size, we only prefetch the summary */
+  unsigned long map_ranks;
+  if (scr_rank2file_layout(st->fetch_dir, scr_comm_world, &st->per_stripe, &map_ranks) != SCR_SUCCESS ||
+      map_ranks != (unsigned long) scr_ranks_world)
+  {
+    st->per_stripe = 0;
+  }
+
+  /* group procs by the stripe that holds their rank2file entry */
+  if (st->per_stripe > 0) {
+    int stripe = (int) ((unsigned long) scr_my_rank_world / st->per_stripe);
+    MPI_Comm_split(scr_comm_world, stripe, scr_my_rank_world, &st->stripe_comm);
+  }
+
+  /* give up on the prefetch if any process fails to start its thread */
+  int started = (pthread_create(&st->thread, NULL, scr_fetch_prefetch_thread, (void*) st) == 0);
+  if (! scr_alltrue(started, scr_comm_world)) {
+    if (started) {
+      pthread_join(st->thread, NULL);
+    }
+    scr_fetch_prefetch_state_free(&st);
+    return;
+  }
+
+  if (scr_my_rank_world == 0) {
+    scr_dbg(2, "Prefetching metadata of dataset %d", id);
+  }
+
+  scr_fetch_prefetch_st = st;
+}
+
+/* wait for any prefetch to finish, returns its state if it is for the
+ * given dataset and all procs read their part, otherwise discards it
+ * and returns NULL, this must be called by all procs */
+static scr_fetch_prefetch_state* scr_fetch_prefetch_finish(int id)
+{
+  scr_fetch_prefetch_state* st = scr_fetch_prefetch_st;
+  if (st == NULL) {
+    return NULL;
+  }
+  scr_fetch_prefetch_st = NULL;
+
+  pthread_join(st->thread, NULL);
+
+  /* hand out the rank2file entries read by the first rank of each stripe */
+  if (st->id == id && st->per_stripe > 0) {
+    if (scr_rank2file_scatter_stripe(st->stripe_buf, st->stripe_size, st->rc == SCR_SUCCESS,
+      st->filelist, st->stripe_comm) != SCR_SUCCESS)
+    {
+      st->rc = SCR_FAILURE;
+    }
+    scr_free(&st->stripe_buf);
+  }
+
+  int valid = (st->id == id && st->rc == SCR_SUCCESS);
+  if (! scr_alltrue(valid, scr_comm_world)) {
+    scr_fetch_prefetch_state_free(&st);
+    return NULL;
+  }
+
+  return st;
+}
+
+/* read contents of summary file, uses the copy read by a prefetch
+ * if one is given */
 static int scr_fetch_summary(
   const char* summary_dir,
-  kvtree* summary_hash)
+  kvtree* summary_hash,
+  const scr_fetch_prefetch_state* prefetch)
 {
   /* assume that we won't succeed in our fetch attempt */
   int rc = SCR_SUCCESS;
 
   /* check whether summary file exists and is readable */
-  if (scr_my_rank_world == 0) {
+  if (scr_my_rank_world == 0 && prefetch == NULL) {
     /* check that we can access the directory */
     if (scr_file_is_readable(summary_dir) != SCR_SUCCESS) {
       scr_err("Failed to access summary directory %s @ %s:%d",
@@ -87,41 +280,14 @@ static int scr_fetch_summary(
   /* add path to summary info */
   kvtree_util_set_str(summary_hash, SCR_KEY_PATH, summary_dir);
 
-  /* build path to summary file */
-  spath* meta_path = spath_from_str(summary_dir);
-  spath_reduce(meta_path);
-
   /* rank 0 reads the summary file */
   kvtree* header = kvtree_new();
   if (scr_my_rank_world == 0) {
-    /* build path to summary file */
-    spath* summary_path = spath_dup(meta_path);
-    spath_append_str(summary_path, "summary.scr");
-    const char* summary_file = spath_strdup(summary_path);
-
-    /* open file for reading */
-    int fd = scr_open(summary_file, O_RDONLY);
-    if (fd >= 0) {
-      /* read summary hash */
-      ssize_t header_size = kvtree_read_fd(summary_file, fd, header);
-      if (header_size < 0) {
-        rc = SCR_FAILURE;
-      }
-
-      /* TODO: check that the version is correct */
-
-      /* close the file */
-      scr_close(summary_file, fd);
+    if (prefetch != NULL) {
+      kvtree_merge(header, prefetch->header);
     } else {
-      scr_err("Failed to open summary file %s @ %s:%d",
-        summary_file, __FILE__, __LINE__
-      );
-      rc = SCR_FAILURE;
+      rc = scr_fetch_summary_read(summary_dir, header);
     }
-
-    /* free summary path and string */
-    scr_free(&summary_file);
-    spath_delete(&summary_path);
   }
 
   /* broadcast success code from rank 0 */
@@ -143,50 +309,627 @@ cleanup:
   /* free the header hash */
   kvtree_delete(&header);
 
-  /* free path for dataset directory */
-  spath_delete(&meta_path);
+  return rc;
+}
+
+/* extract a file from its segments in the container files in fetch_dir,
+ * where file_hash is the rank2file entry for the file */
+static int scr_fetch_container_file(
+  const char* fetch_dir,
+  const kvtree* file_hash,
+  const char* dest_file,
+  char* buf,
+  size_t bufsize)
+{
+  int rc = SCR_SUCCESS;
+
+  /* open the destination file */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd_dest = scr_open(dest_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  if (fd_dest < 0) {
+    scr_err("Opening file for writing: %s @ %s:%d",
+      dest_file, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* read each segment in order from its container */
+  int seg = 0;
+  kvtree* seg_hash;
+  while (rc == SCR_SUCCESS && (seg_hash = kvtree_get_kv_int(file_hash, SCR_KEY_SEGMENT, seg)) != NULL) {
+    int ctr;
+    unsigned long offset, length;
+    if (kvtree_util_get_int(seg_hash, SCR_KEY_CONTAINER, &ctr) != KVTREE_SUCCESS ||
+        kvtree_util_get_bytecount(seg_hash, SCR_KEY_OFFSET, &offset) != KVTREE_SUCCESS ||
+        kvtree_util_get_bytecount(seg_hash, SCR_KEY_LENGTH, &length) != KVTREE_SUCCESS)
+    {
+      scr_err("Invalid container segment %d for %s @ %s:%d",
+        seg, dest_file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    char* ctr_file = scr_flush_container_path(fetch_dir, ctr);
+    int fd_ctr = scr_open(ctr_file, O_RDONLY);
+    if (fd_ctr < 0 || scr_lseek(ctr_file, fd_ctr, (off_t) offset, SEEK_SET) != SCR_SUCCESS) {
+      scr_err("Failed to open container file %s at offset %lu @ %s:%d",
+        ctr_file, offset, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+
+    /* copy bytes from container to file */
+    while (rc == SCR_SUCCESS && length > 0) {
+      size_t count = bufsize;
+      if (count > length) {
+        count = (size_t) length;
+      }
+      if (scr_read(ctr_file, fd_ctr, buf, count) != (ssize_t) count ||
+          scr_write(dest_file, fd_dest, buf, count) != (ssize_t) count)
+      {
+        scr_err("Failed to copy %lu bytes from %s to %s @ %s:%d",
+          (unsigned long) count, ctr_file, dest_file, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+      length -= count;
+    }
+
+    if (fd_ctr >= 0 && scr_close(ctr_file, fd_ctr) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+    scr_free(&ctr_file);
+    seg++;
+  }
+
+  if (scr_close(dest_file, fd_dest) != SCR_SUCCESS) {
+    rc = SCR_FAILURE;
+  }
 
   return rc;
 }
 
-/* fetch files from fetch_dir into cache_dir and update filemap */
+/* extract files from container files in fetch_dir, limiting the number
+ * of procs reading at once to width, returns SCR_SUCCESS on all procs
+ * if all succeeded */
+static int scr_fetch_containers(
+  const char* fetch_dir,
+  const kvtree* files,
+  const char** dest_filelist,
+  int width,
+  MPI_Comm comm)
+{
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* allocate buffer to copy data */
+  size_t bufsize = scr_file_buf_size;
+  char* buf = (char*) SCR_MALLOC(bufsize);
+
+  /* read in rounds, with width procs reading in each round */
+  if (width <= 0 || width > ranks) {
+    width = ranks;
+  }
+  int success = 1;
+  int rounds = (ranks + width - 1) / width;
+  int round;
+  for (round = 0; round < rounds; round++) {
+    if (rank / width == round) {
+      int i = 0;
+      kvtree_elem* elem;
+      for (elem = kvtree_elem_first(files);
+           elem != NULL;
+           elem = kvtree_elem_next(elem))
+      {
+        const kvtree* file_hash = kvtree_elem_hash(elem);
+        if (scr_fetch_container_file(fetch_dir, file_hash, dest_filelist[i], buf, bufsize) != SCR_SUCCESS) {
+          success = 0;
+          break;
+        }
+        i++;
+      }
+    }
+
+    /* wait for this round to finish before starting the next */
+    MPI_Barrier(comm);
+  }
+
+  scr_free(&buf);
+
+  if (! scr_alltrue(success, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* decompress each file flagged in compressed, which was fetched into
+ * cache under its compressed name, and replace its entries in the source
+ * and destination lists with the names of the uncompressed files */
+static int scr_fetch_decompress(
+  int id,
+  const char* fetch_dir,
+  const char* cache_dir,
+  int num_files,
+  const int* compressed,
+  const char** src_filelist,
+  const char** dest_filelist)
+{
+  int rc = SCR_SUCCESS;
+
+  /* start timer */
+  time_t timestamp_start = scr_log_seconds();
+  double time_start = MPI_Wtime();
+
+  size_t extlen = strlen(SCR_COMPRESS_EXT);
+  double counts[2] = {0.0, 0.0};
+  int i;
+  for (i = 0; i < num_files; i++) {
+    if (! compressed[i]) {
+      continue;
+    }
+
+    /* strip extension from names to get names of the original file */
+    const char* staged = dest_filelist[i];
+    size_t len = strlen(staged);
+    size_t srclen = strlen(src_filelist[i]);
+    if (len <= extlen || strcmp(staged + len - extlen, SCR_COMPRESS_EXT) != 0 ||
+        srclen <= extlen)
+    {
+      scr_err("Compressed file %s is missing %s extension @ %s:%d",
+        staged, SCR_COMPRESS_EXT, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+      continue;
+    }
+    char* dest = strndup(staged, len - extlen);
+    char* src  = strndup(src_filelist[i], srclen - extlen);
+
+    /* decompress file and delete the compressed copy */
+    unsigned long bytes;
+    if (scr_decompress_file(staged, dest, scr_compress_threads, &bytes) == SCR_SUCCESS) {
+      counts[0] += (double) bytes;
+      counts[1] += 1.0;
+    } else {
+      rc = SCR_FAILURE;
+    }
+    scr_file_unlink(staged);
+
+    /* replace names in our lists */
+    scr_free(&src_filelist[i]);
+    scr_free(&dest_filelist[i]);
+    src_filelist[i]  = src;
+    dest_filelist[i] = dest;
+  }
+
+  /* report decompression throughput */
+  double time_diff = MPI_Wtime() - time_start;
+  double total[2];
+  double max_time;
+  MPI_Reduce(counts, total, 2, MPI_DOUBLE, MPI_SUM, 0, scr_comm_world);
+  MPI_Reduce(&time_diff, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, scr_comm_world);
+  if (scr_my_rank_world == 0 && total[1] > 0.0) {
+    double bw = (max_time > 0.0) ? total[0] / (1024.0 * 1024.0 * max_time) : 0.0;
+    scr_dbg(1, "scr_fetch_decompress: %f secs, %e bytes, %f MB/s",
+      max_time, total[0], bw
+    );
+
+    if (scr_log_enable) {
+      int total_files = (int) total[1];
+      scr_log_transfer("DECOMPRESS", fetch_dir, cache_dir, &id, NULL,
+        &timestamp_start, &max_time, &total[0], &total_files
+      );
+    }
+  }
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, scr_comm_world)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* states of a file in a streaming fetch */
+#define SCR_FETCH_STREAM_PENDING (0)
+#define SCR_FETCH_STREAM_ACTIVE  (1)
+#define SCR_FETCH_STREAM_DONE    (2)
+#define SCR_FETCH_STREAM_FAILED  (3)
+
+/* tag used to hand window slots between stream threads */
+#define SCR_FETCH_STREAM_TAG (1002)
+
+/* state of a dataset being fetched in the background */
+typedef struct {
+  int id;                  /* dataset id */
+  int ckpt_id;             /* checkpoint id of dataset */
+  char* name;              /* name of dataset */
+  char* fetch_dir;         /* dataset directory in prefix */
+  char* cache_dir;         /* cache directory receiving files */
+  kvtree* reddesc;         /* redundancy descriptor to apply once all files arrive */
+  int num_files;           /* number of files this process fetches */
+  char** src_filelist;     /* source path of each file */
+  char** dest_filelist;    /* cache path of each file */
+  int* order;              /* indices of files in the order to fetch them */
+  int* state;              /* state of each file */
+  int next;                /* position in order of next file to fetch */
+  int wanted;              /* index of a file someone is waiting on, -1 if none */
+  int failed;              /* set if any file failed to copy */
+  pthread_t thread;        /* thread copying files */
+  pthread_mutex_t lock;    /* protects state, next, wanted, and failed */
+  pthread_cond_t cond;     /* signaled whenever a file completes */
+  int width;               /* max number of procs reading at once, 0 for no limit */
+  int rank;                /* our rank in comm */
+  int ranks;               /* number of ranks in comm */
+  MPI_Comm comm;           /* communicator used by thread to pass window slots */
+  double bytes;            /* total bytes in dataset, for logging */
+  int files;               /* total files in dataset, for logging */
+  time_t timestamp_start;  /* time fetch started, for logging */
+  double time_start;
+} scr_fetch_stream_state;
+
+/* dataset currently being fetched in the background, if any */
+static scr_fetch_stream_state* scr_fetch_stream_st = NULL;
+
+static void scr_fetch_stream_state_free(scr_fetch_stream_state** ptr_st)
+{
+  scr_fetch_stream_state* st = *ptr_st;
+  int i;
+  for (i = 0; i < st->num_files; i++) {
+    scr_free(&st->src_filelist[i]);
+    scr_free(&st->dest_filelist[i]);
+  }
+  scr_free(&st->src_filelist);
+  scr_free(&st->dest_filelist);
+  scr_free(&st->order);
+  scr_free(&st->state);
+  kvtree_delete(&st->reddesc);
+  scr_free(&st->cache_dir);
+  scr_free(&st->fetch_dir);
+  scr_free(&st->name);
+  pthread_cond_destroy(&st->cond);
+  pthread_mutex_destroy(&st->lock);
+  if (st->comm != MPI_COMM_NULL) {
+    MPI_Comm_free(&st->comm);
+  }
+  scr_free(ptr_st);
+}
+
+/* background thread to copy files into cache, copies a file someone
+ * is waiting on before any others, to limit the number of processes
+ * reading at once to width, a process waits for the one width ranks
+ * ahead of it to copy all of its files before it starts */
+static void* scr_fetch_stream_thread(void* arg)
+{
+  scr_fetch_stream_state* st = (scr_fetch_stream_state*) arg;
+
+  /* wait for our turn */
+  int token = 1;
+  if (st->width > 0 && st->rank >= st->width) {
+    MPI_Recv(&token, 1, MPI_INT, st->rank - st->width, SCR_FETCH_STREAM_TAG, st->comm, MPI_STATUS_IGNORE);
+  }
+
+  pthread_mutex_lock(&st->lock);
+  while (1) {
+    /* pick the next file to copy */
+    int idx = -1;
+    if (st->wanted >= 0 && st->state[st->wanted] == SCR_FETCH_STREAM_PENDING) {
+      idx = st->wanted;
+    } else {
+      while (st->next < st->num_files &&
+             st->state[st->order[st->next]] != SCR_FETCH_STREAM_PENDING)
+      {
+        st->next++;
+      }
+      if (st->next < st->num_files) {
+        idx = st->order[st->next];
+      }
+    }
+
+    /* all done */
+    if (idx < 0) {
+      break;
+    }
+
+    /* copy file without holding the lock */
+    st->state[idx] = SCR_FETCH_STREAM_ACTIVE;
+    pthread_mutex_unlock(&st->lock);
+    int rc = scr_file_copy(st->src_filelist[idx], st->dest_filelist[idx], scr_file_buf_size, NULL);
+    pthread_mutex_lock(&st->lock);
+
+    if (rc == SCR_SUCCESS) {
+      st->state[idx] = SCR_FETCH_STREAM_DONE;
+    } else {
+      st->state[idx] = SCR_FETCH_STREAM_FAILED;
+      st->failed = 1;
+    }
+    pthread_cond_broadcast(&st->cond);
+  }
+  pthread_mutex_unlock(&st->lock);
+
+  /* hand our slot to the next process */
+  if (st->width > 0 && st->rank + st->width < st->ranks) {
+    MPI_Send(&token, 1, MPI_INT, st->rank + st->width, SCR_FETCH_STREAM_TAG, st->comm);
+  }
+
+  return NULL;
+}
+
+/* returns 1 if files may be copied in the background, the threads pass
+ * messages to keep the number of readers within SCR_FETCH_WIDTH, which
+ * needs MPI_THREAD_MULTIPLE unless all procs fit in the window */
+static int scr_fetch_stream_allowed(void)
+{
+  if (scr_fetch_width <= 0 || scr_fetch_width >= scr_ranks_world) {
+    return 1;
+  }
+
+  int provided;
+  MPI_Query_thread(&provided);
+  if (provided < MPI_THREAD_MULTIPLE) {
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "MPI_THREAD_MULTIPLE is required to stream a fetch wider than SCR_FETCH_WIDTH, fetching now");
+    }
+    return 0;
+  }
+  return 1;
+}
+
+/* start thread to copy files into cache in the given order,
+ * copies file lists, returns SCR_SUCCESS on all procs if all
+ * procs started their thread */
+static int scr_fetch_stream_start(
+  int id,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  const int* order)
+{
+  scr_fetch_stream_state* st = (scr_fetch_stream_state*) SCR_MALLOC(sizeof(scr_fetch_stream_state));
+  memset(st, 0, sizeof(scr_fetch_stream_state));
+  st->id        = id;
+  st->num_files = num_files;
+  st->wanted    = -1;
+  st->src_filelist  = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  st->dest_filelist = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  st->order = (int*) SCR_MALLOC(num_files * sizeof(int));
+  st->state = (int*) SCR_MALLOC(num_files * sizeof(int));
+  int i;
+  for (i = 0; i < num_files; i++) {
+    st->src_filelist[i]  = strdup(src_filelist[i]);
+    st->dest_filelist[i] = strdup(dest_filelist[i]);
+    st->order[i] = order[i];
+    st->state[i] = SCR_FETCH_STREAM_PENDING;
+  }
+  pthread_mutex_init(&st->lock, NULL);
+  pthread_cond_init(&st->cond, NULL);
+
+  /* limit the number of procs reading at once to the fetch width,
+   * the thread passes slots on its own communicator */
+  MPI_Comm_rank(scr_comm_world, &st->rank);
+  MPI_Comm_size(scr_comm_world, &st->ranks);
+  st->width = scr_fetch_width;
+  if (st->width <= 0 || st->width >= st->ranks) {
+    st->width = 0;
+  }
+  st->comm = MPI_COMM_NULL;
+  if (st->width > 0) {
+    MPI_Comm_dup(scr_comm_world, &st->comm);
+  }
+
+  int thread_rc = pthread_create(&st->thread, NULL, scr_fetch_stream_thread, st);
+  if (! scr_alltrue(thread_rc == 0, scr_comm_world)) {
+    /* someone failed to start a thread, wait for those that did */
+    if (thread_rc == 0) {
+      pthread_join(st->thread, NULL);
+    } else {
+      scr_err("Failed to start thread to fetch dataset %d @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+
+      /* pass our slot along so threads behind us in the window finish */
+      int token = 1;
+      if (st->width > 0 && st->rank >= st->width) {
+        MPI_Recv(&token, 1, MPI_INT, st->rank - st->width, SCR_FETCH_STREAM_TAG, st->comm, MPI_STATUS_IGNORE);
+      }
+      if (st->width > 0 && st->rank + st->width < st->ranks) {
+        MPI_Send(&token, 1, MPI_INT, st->rank + st->width, SCR_FETCH_STREAM_TAG, st->comm);
+      }
+    }
+    scr_fetch_stream_state_free(&st);
+    return SCR_FAILURE;
+  }
+
+  scr_fetch_stream_st = st;
+  return SCR_SUCCESS;
+}
+
+/* wait until given file has been copied into cache, returns SCR_SUCCESS
+ * if the file is in cache or is not part of a streaming fetch */
+int scr_fetch_stream_wait(const char* file)
+{
+  scr_fetch_stream_state* st = scr_fetch_stream_st;
+  if (st == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* look up the file */
+  int idx;
+  for (idx = 0; idx < st->num_files; idx++) {
+    if (strcmp(st->dest_filelist[idx], file) == 0) {
+      break;
+    }
+  }
+  if (idx == st->num_files) {
+    return SCR_SUCCESS;
+  }
+
+  /* move file to the front of the line and wait for it */
+  pthread_mutex_lock(&st->lock);
+  if (st->state[idx] == SCR_FETCH_STREAM_PENDING) {
+    st->wanted = idx;
+  }
+  while (st->state[idx] == SCR_FETCH_STREAM_PENDING ||
+         st->state[idx] == SCR_FETCH_STREAM_ACTIVE)
+  {
+    pthread_cond_wait(&st->cond, &st->lock);
+  }
+  int rc = (st->state[idx] == SCR_FETCH_STREAM_DONE) ? SCR_SUCCESS : SCR_FAILURE;
+  pthread_mutex_unlock(&st->lock);
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to fetch %s into cache @ %s:%d",
+      st->src_filelist[idx], __FILE__, __LINE__
+    );
+  }
+
+  return rc;
+}
+
+/* wait for a streaming fetch to bring all files into cache, then
+ * record their metadata and apply the redundancy scheme, sets id to
+ * the dataset that was fetched or -1 if none was in progress,
+ * returns SCR_SUCCESS on all procs if all procs succeeded */
+int scr_fetch_stream_finish(scr_cache_index* cindex, int* id)
+{
+  *id = -1;
+
+  scr_fetch_stream_state* st = scr_fetch_stream_st;
+  if (st == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* wait for thread to copy all of our files */
+  pthread_join(st->thread, NULL);
+  scr_fetch_stream_st = NULL;
+  *id = st->id;
+
+  int rc = SCR_SUCCESS;
+  if (! scr_alltrue(st->failed == 0, scr_comm_world)) {
+    rc = SCR_FAILURE;
+  }
+
+  /* now that the files are in cache, record their size and mark them complete */
+  scr_filemap* map = scr_filemap_new();
+  scr_cache_get_map(cindex, st->id, map);
+  if (rc == SCR_SUCCESS) {
+    int i;
+    for (i = 0; i < st->num_files; i++) {
+      const char* dest_file = st->dest_filelist[i];
+      scr_meta* meta = scr_meta_new();
+      scr_filemap_get_meta(map, dest_file, meta);
+
+      struct stat stat_buf;
+      if (stat(dest_file, &stat_buf) == 0) {
+        unsigned long filesize = (unsigned long) stat_buf.st_size;
+        scr_meta_set_filesize(meta, filesize);
+        scr_meta_set_stat(meta, &stat_buf);
+      }
+      scr_meta_set_complete(meta, 1);
+
+      scr_filemap_set_meta(map, dest_file, meta);
+      scr_meta_delete(&meta);
+    }
+    scr_cache_set_map(cindex, st->id, map);
+
+    /* apply redundancy scheme */
+    scr_reddesc rd;
+    scr_reddesc* c = &rd;
+    scr_reddesc_init(c);
+    scr_reddesc_create_from_hash(c, -1, st->reddesc);
+    rc = scr_reddesc_apply(map, c, st->id, NULL);
+    scr_reddesc_free(c);
+  }
+  scr_filemap_delete(&map);
+
+  if (rc == SCR_SUCCESS) {
+    /* update our flush file to indicate this checkpoint is in cache
+     * as well as the parallel file system */
+    scr_flush_file_location_set(st->id, SCR_FLUSH_KEY_LOCATION_CACHE);
+    scr_flush_file_location_set(st->id, SCR_FLUSH_KEY_LOCATION_PFS);
+    scr_flush_file_location_unset(st->id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
+  }
+
+  /* stop timer, compute bandwidth, and report performance */
+  if (scr_my_rank_world == 0) {
+    double time_end = MPI_Wtime();
+    double time_diff = time_end - st->time_start;
+    double bw = 0.0;
+    if (time_diff > 0.0) {
+      bw = st->bytes / (1024.0 * 1024.0 * time_diff);
+    }
+    scr_dbg(1, "scr_fetch_stream_finish: %f secs, %e bytes, %f MB/s, %f MB/s per proc",
+      time_diff, st->bytes, bw, bw/scr_ranks_world
+    );
+
+    /* log data on the fetch to the database */
+    if (scr_log_enable) {
+      if (rc == SCR_SUCCESS) {
+        scr_log_event("FETCH_SUCCESS", st->fetch_dir, &st->id, st->name, NULL, &time_diff);
+      } else {
+        scr_log_event("FETCH_FAIL", st->fetch_dir, &st->id, st->name, NULL, &time_diff);
+      }
+      scr_log_transfer("FETCH", st->fetch_dir, st->cache_dir, &st->id, st->name,
+        &st->timestamp_start, &time_diff, &st->bytes, &st->files
+      );
+    }
+  }
+
+  scr_fetch_stream_state_free(&st);
+
+  return rc;
+}
+
+/* fetch files from fetch_dir into cache_dir and update filemap,
+ * if stream is set and the dataset allows it, start copying files
+ * in the background and set streaming to 1 */
 static int scr_fetch_data(
   const kvtree* summary_hash,
   const char* fetch_dir,
   const char* cache_dir,
   scr_cache_index* cindex,
-  int id)
+  int id,
+  const scr_fetch_prefetch_state* prefetch,
+  int keep,
+  int stream,
+  int* streaming)
 {
   int rc = SCR_SUCCESS;
+  *streaming = 0;
 
-  /* build path to rank2file map */
-  spath* rank2file_path = spath_from_str(fetch_dir);
-  spath_append_str(rank2file_path, "rank2file");
-  const char* rank2file = spath_strdup(rank2file_path);
-
-  /* get the list of files to read */
+  /* get the list of files to read from the rank2file map,
+   * unless a prefetch already read our entry, if the dataset was
+   * written by a different number of ranks, this remaps its entries */
+  int remapped = 0;
   kvtree* filelist = kvtree_new();
-  if (kvtree_read_scatter(rank2file, filelist, scr_comm_world) != KVTREE_SUCCESS) {
-    scr_err("Failed to rank2file map: `%s' @ %s:%d",
-      rank2file, __FILE__, __LINE__
+  if (prefetch != NULL && prefetch->per_stripe > 0) {
+    kvtree_merge(filelist, prefetch->filelist);
+  } else if (scr_fetch_remap_filelist(fetch_dir, filelist, &remapped) != SCR_SUCCESS) {
+    scr_err("Failed to read rank2file map in `%s' @ %s:%d",
+      fetch_dir, __FILE__, __LINE__
     );
     kvtree_delete(&filelist);
-    scr_free(&rank2file);
     return SCR_FAILURE;
   }
-  scr_free(&rank2file);
-  spath_delete(&rank2file_path);
-
-  /* TODO: gather list of files to leader for each store descriptor,
-   * then use comm of store descriptor leaders in axl call,
-   * have leaders bcast success/fail back to all procs */
 
   /* allocate list of file names */
   kvtree* files = kvtree_get(filelist, "FILE");
   int num_files = kvtree_size(files);
+
+  /* files were packed into containers during the flush if the
+   * rank2file entries record the file size and segments */
+  int use_containers = 0;
+
+  /* track which files were compressed during the flush */
+  int use_compress = 0;
+  int* compressed = (int*) SCR_MALLOC(num_files * sizeof(int));
+
   const char** src_filelist  = (const char**) SCR_MALLOC(num_files * sizeof(char*));
   const char** dest_filelist = (const char**) SCR_MALLOC(num_files * sizeof(char*));
 
+  /* position of each file in the order the application routed them,
+   * files from datasets that did not record an order go last */
+  int* route_order = (int*) SCR_MALLOC(num_files * sizeof(int));
+
   /* create list of file names */
   int i = 0;
   kvtree_elem* elem;
@@ -197,6 +940,24 @@ static int scr_fetch_data(
     /* get the filename */
     const char* file = kvtree_elem_key(elem);
 
+    /* check whether this file was written to a container */
+    unsigned long size;
+    if (kvtree_util_get_bytecount(kvtree_elem_hash(elem), SCR_KEY_SIZE, &size) == KVTREE_SUCCESS) {
+      use_containers = 1;
+    }
+
+    /* check whether this file was compressed */
+    compressed[i] = 0;
+    kvtree_util_get_int(kvtree_elem_hash(elem), SCR_KEY_COMPRESS, &compressed[i]);
+    if (compressed[i]) {
+      use_compress = 1;
+    }
+
+    /* get the order in which this file was routed */
+    if (kvtree_util_get_int(kvtree_elem_hash(elem), SCR_KEY_ORDER, &route_order[i]) != KVTREE_SUCCESS) {
+      route_order[i] = num_files + i;
+    }
+
     /* prepend prefix directory to each file */
     spath* srcpath = spath_from_str(scr_prefix);
     spath_append_str(srcpath, file);
@@ -222,12 +983,149 @@ static int scr_fetch_data(
     i++;
   }
 
-  /* free the list of files */
-  kvtree_delete(&filelist);
+  /* when asked to keep files already in cache, a process that still
+   * holds all of its files skips the transfer and keeps its filemap,
+   * so that only processes that lost files read from the prefix */
+  int skip = 0;
+  if (keep && cache_dir != NULL && ! remapped) {
+    scr_filemap* cached = scr_filemap_new();
+    scr_cache_get_map(cindex, id, cached);
+    skip = 1;
+    size_t extlen = strlen(SCR_COMPRESS_EXT);
+    for (elem = kvtree_elem_first(files), i = 0;
+         elem != NULL && skip;
+         elem = kvtree_elem_next(elem), i++)
+    {
+      /* compressed files are held in cache under their original name */
+      char* cached_file = strdup(dest_filelist[i]);
+      size_t len = strlen(cached_file);
+      if (compressed[i] && len > extlen) {
+        cached_file[len - extlen] = '\0';
+      }
+
+      /* check that the cached copy is complete and matches its meta data */
+      if (! scr_bool_have_file(cached, cached_file, NULL)) {
+        skip = 0;
+      }
+
+      /* the check above compares the cached copy to the size in its
+       * meta data, for files in containers, also check it against the
+       * size recorded in the rank2file map, we don't stat the prefix
+       * copy since that would cost a metadata op per file in the job */
+      unsigned long size;
+      if (skip && ! compressed[i] &&
+          kvtree_util_get_bytecount(kvtree_elem_hash(elem), SCR_KEY_SIZE, &size) == KVTREE_SUCCESS &&
+          scr_file_size(cached_file) != size)
+      {
+        scr_dbg(2, "Cached file %s does not match %s", cached_file, src_filelist[i]);
+        skip = 0;
+      }
+
+      scr_free(&cached_file);
+    }
+    scr_filemap_delete(&cached);
+
+    /* report how many processes need to read files */
+    int readers;
+    int need = ! skip;
+    MPI_Reduce(&need, &readers, 1, MPI_INT, MPI_SUM, 0, scr_comm_world);
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Fetching files for %d of %d processes", readers, scr_ranks_world);
+    }
+  }
+
+  /* number of files this process transfers */
+  int xfer_files = skip ? 0 : num_files;
+  kvtree* xfer_list = skip ? NULL : files;
+
+  /* all procs must agree on whether to read from containers and decompress */
+  MPI_Allreduce(MPI_IN_PLACE, &use_containers, 1, MPI_INT, MPI_MAX, scr_comm_world);
+  MPI_Allreduce(MPI_IN_PLACE, &use_compress,   1, MPI_INT, MPI_MAX, scr_comm_world);
+
+  /* compressed files can't be read in place */
+  if (use_compress && cache_dir == NULL) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Cannot fetch compressed dataset with bypass @ %s:%d",
+        __FILE__, __LINE__
+      );
+    }
+    kvtree_delete(&filelist);
+    for (i = 0; i < num_files; i++) {
+      scr_free(&src_filelist[i]);
+      scr_free(&dest_filelist[i]);
+    }
+    scr_free(&src_filelist);
+    scr_free(&dest_filelist);
+    scr_free(&compressed);
+    scr_free(&route_order);
+    return SCR_FAILURE;
+  }
+
+  /* number of files to record in the filemap */
+  int map_files = xfer_files;
+
+  /* after a remap, move files that are still in the cache of some node
+   * to their new owner and only read the rest from the prefix directory */
+  if (remapped && cache_dir != NULL && ! use_containers && ! use_compress) {
+    int* have = (int*) SCR_MALLOC(num_files * sizeof(int));
+    scr_fetch_remap_cache(cindex, id, cache_dir, num_files, src_filelist, dest_filelist, have);
+
+    /* move files we still need to read to the front of the list */
+    xfer_files = 0;
+    for (i = 0; i < num_files; i++) {
+      if (! have[i]) {
+        const char* src  = src_filelist[i];
+        const char* dest = dest_filelist[i];
+        src_filelist[i]  = src_filelist[xfer_files];
+        dest_filelist[i] = dest_filelist[xfer_files];
+        src_filelist[xfer_files]  = src;
+        dest_filelist[xfer_files] = dest;
+        xfer_files++;
+      }
+    }
+
+    scr_free(&have);
+  }
 
   /* now we can finally fetch the actual files */
   int success = 1;
-  if (cache_dir != NULL) {
+  if (use_containers) {
+    if (cache_dir != NULL) {
+      /* extract files from containers into the cache directory,
+       * limiting the number of readers to the fetch width */
+      if (scr_fetch_containers(fetch_dir, xfer_list, dest_filelist, scr_fetch_width, scr_comm_world) != SCR_SUCCESS) {
+        success = 0;
+      }
+    } else {
+      /* files only exist within containers, so they can't be read in place */
+      scr_err("Cannot fetch dataset stored in container files with bypass @ %s:%d",
+        __FILE__, __LINE__
+      );
+      success = 0;
+    }
+  } else if (stream && ! keep && ! remapped && cache_dir != NULL && ! use_compress && ! scr_fetch_aggregate &&
+             scr_fetch_stream_allowed())
+  {
+    /* sort files by the order in which they were routed */
+    int* order = (int*) SCR_MALLOC(num_files * sizeof(int));
+    for (i = 0; i < num_files; i++) {
+      int j = i;
+      while (j > 0 && route_order[order[j - 1]] > route_order[i]) {
+        order[j] = order[j - 1];
+        j--;
+      }
+      order[j] = i;
+    }
+
+    /* copy files into cache in the background */
+    if (scr_fetch_stream_start(id, num_files, src_filelist, dest_filelist, order) == SCR_SUCCESS) {
+      *streaming = 1;
+    } else {
+      success = 0;
+    }
+
+    scr_free(&order);
+  } else if (cache_dir != NULL) {
     /* get the dataset corresponding to this id */
     scr_dataset* dataset = scr_dataset_new();
     scr_cache_index_get_dataset(cindex, id, dataset);
@@ -237,12 +1135,25 @@ static int scr_fetch_data(
     scr_dataset_get_name(dataset, &dset_name);
 
     /* get AXL transfer type */
-    //const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
     axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(SCR_FETCH_TYPE);
 
-    /* fetch these files into the directory */
-    if (scr_axl(dset_name, num_files, src_filelist, dest_filelist, xfer_type, scr_comm_world) != SCR_SUCCESS) {
-      success = 0;
+    if (scr_fetch_aggregate) {
+      /* have the leader of each store descriptor read files for all procs
+       * that share its cache, limiting the number of leaders to the fetch width */
+      const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
+      if (scr_axl_aggregate(dset_name, xfer_files, src_filelist, dest_filelist,
+        xfer_type, scr_fetch_width, "FETCH_WINDOW", fetch_dir, cache_dir, &id,
+        storedesc->comm, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+    } else {
+      /* fetch these files into the directory, limiting the number of readers to the fetch width */
+      if (scr_axl_window(dset_name, xfer_files, src_filelist, dest_filelist,
+        xfer_type, scr_fetch_width, "FETCH_WINDOW", fetch_dir, cache_dir, &id, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
     }
 
     /* free datase */
@@ -258,15 +1169,27 @@ static int scr_fetch_data(
     }
   }
 
+  /* free the list of files */
+  kvtree_delete(&filelist);
+
   /* check that all processes copied their file successfully */
   if (! scr_alltrue(success, scr_comm_world)) {
     /* TODO: auto delete files? */
     rc = SCR_FAILURE;
   }
 
+  /* expand any compressed files */
+  if (rc == SCR_SUCCESS && use_compress) {
+    if (scr_fetch_decompress(id, fetch_dir, cache_dir, xfer_files, compressed, src_filelist, dest_filelist) != SCR_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  }
+  scr_free(&compressed);
+  scr_free(&route_order);
+
   /* create a filemap for the files we just read in */
   scr_filemap* map = scr_filemap_new();
-  for (i = 0; i < num_files; i++) {
+  for (i = 0; i < map_files; i++) {
     /* get source and destination file names */
     const char* src_file  = src_filelist[i];
     const char* dest_file = dest_filelist[i];
@@ -274,9 +1197,10 @@ static int scr_fetch_data(
     /* add file to map */
     scr_filemap_add_file(map, dest_file);
 
-    /* define meta for file */
+    /* define meta for file, files still being streamed are
+     * marked as incomplete until they arrive */
     scr_meta* meta = scr_meta_new();
-    scr_meta_set_complete(meta, 1);
+    scr_meta_set_complete(meta, ! *streaming);
     scr_meta_set_ranks(meta, scr_ranks_world);
     scr_meta_set_orig(meta, src_file);
 
@@ -299,9 +1223,10 @@ static int scr_fetch_data(
     spath_delete(&path_name);
     spath_delete(&path_abs);
 
-    /* stat the file to get its size and other metadata */
+    /* stat the file to get its size and other metadata,
+     * this is done in scr_fetch_stream_finish for streamed files */
     struct stat stat_buf;
-    int stat_rc = stat(dest_file, &stat_buf);
+    int stat_rc = *streaming ? -1 : stat(dest_file, &stat_buf);
     if (stat_rc == 0) {
       unsigned long filesize = (unsigned long) stat_buf.st_size;
       scr_meta_set_filesize(meta, filesize);
@@ -313,8 +1238,10 @@ static int scr_fetch_data(
     scr_meta_delete(&meta);
   }
 
-  /* write out filemap */
-  scr_cache_set_map(cindex, id, map);
+  /* write out filemap, unless we kept the one we already had */
+  if (! skip) {
+    scr_cache_set_map(cindex, id, map);
+  }
   scr_filemap_delete(&map);
 
   /* free memory allocated for file list */
@@ -329,8 +1256,14 @@ static int scr_fetch_data(
   return rc;
 }
 
-/* fetch files from given dataset from parallel file system */
-int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name, int* checkpoint_id)
+/* fetch files from given dataset from parallel file system,
+ * using metadata read by a prefetch if one is given */
+static int scr_fetch_dset_prefetched(
+  scr_cache_index* cindex,
+  int dset_id,
+  const char* dset_name,
+  int* checkpoint_id,
+  const scr_fetch_prefetch_state* prefetch)
 {
   /* get path to dataset metadata directory in prefix as string */
   spath* path = spath_from_str(scr_prefix_scr);
@@ -365,7 +1298,7 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
   kvtree* summary_hash = kvtree_new();
 
   /* read the summary file for this dataset */
-  if (scr_fetch_summary(fetch_dir, summary_hash) != SCR_SUCCESS) {
+  if (scr_fetch_summary(fetch_dir, summary_hash, prefetch) != SCR_SUCCESS) {
     if (scr_my_rank_world == 0) {
       scr_dbg(1, "Failed to read summary file @ %s:%d", __FILE__, __LINE__);
       if (scr_log_enable) {
@@ -451,9 +1384,21 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
     target_dir = NULL;
   }
 
+  /* if some process still has files for this dataset in cache from
+   * an earlier run, processes whose files are all valid keep them */
+  int keep = 0;
+  if (scr_fetch_partial) {
+    scr_filemap* cached = scr_filemap_new();
+    scr_cache_get_map(cindex, dset_id, cached);
+    keep = (scr_filemap_num_files(cached) > 0);
+    scr_filemap_delete(&cached);
+    MPI_Allreduce(MPI_IN_PLACE, &keep, 1, MPI_INT, MPI_MAX, scr_comm_world);
+  }
+
   /* now we can finally fetch the actual files */
   int success = 1;
-  if (scr_fetch_data(summary_hash, fetch_dir, target_dir, cindex, dset_id) != SCR_SUCCESS) {
+  int streaming = 0;
+  if (scr_fetch_data(summary_hash, fetch_dir, target_dir, cindex, dset_id, prefetch, keep, scr_fetch_stream, &streaming) != SCR_SUCCESS) {
     success = 0;
   }
 
@@ -487,12 +1432,39 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
     return SCR_FAILURE;
   }
 
+  /* if files are still arriving in the background, the rest of the
+   * fetch is done in scr_fetch_stream_finish */
+  if (streaming) {
+    scr_fetch_stream_state* st = scr_fetch_stream_st;
+    st->ckpt_id   = ckpt_id;
+    st->name      = strdup(dset_name);
+    st->fetch_dir = strdup(fetch_dir);
+    st->cache_dir = strdup(cache_dir);
+    st->reddesc   = kvtree_new();
+    scr_reddesc_store_to_hash(c, st->reddesc);
+    st->bytes = (double) bytes;
+    st->files = files;
+    if (scr_my_rank_world == 0) {
+      st->timestamp_start = timestamp_start;
+      st->time_start      = time_start;
+      scr_dbg(1, "Fetching %s in the background", dset_name);
+    }
+
+    /* record checkpoint id */
+    *checkpoint_id = ckpt_id;
+
+    scr_free(&cache_dir);
+    scr_reddesc_free(c);
+    scr_free(&fetch_dir);
+    return SCR_SUCCESS;
+  }
+
   /* read file map for this dataset */
   scr_filemap* map = scr_filemap_new();
   scr_cache_get_map(cindex, dset_id, map);
 
   /* apply redundancy scheme */
-  int rc = scr_reddesc_apply(map, c, dset_id);
+  int rc = scr_reddesc_apply(map, c, dset_id, NULL);
   if (rc == SCR_SUCCESS) {
     /* record checkpoint id */
     *checkpoint_id = ckpt_id;
@@ -550,10 +1522,142 @@ int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name,
   return rc;
 }
 
+/* fetch files from given dataset from parallel file system */
+int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name, int* checkpoint_id)
+{
+  return scr_fetch_dset_prefetched(cindex, dset_id, dset_name, checkpoint_id, NULL);
+}
+
+/* restore a checkpoint in cache that its redundancy scheme failed to
+ * rebuild, processes that still hold all of their files keep them,
+ * and only processes that lost files read them from the prefix
+ * directory, then the redundancy scheme is applied again */
+int scr_fetch_restore(scr_cache_index* cindex, int id)
+{
+  /* every process has the dataset and cache directory after they
+   * were distributed during the rebuild */
+  char* name = NULL;
+  int ckpt_id = -1;
+  scr_dataset* dataset = scr_dataset_new();
+  if (scr_cache_index_get_dataset(cindex, id, dataset) == SCR_SUCCESS) {
+    char* dset_name;
+    if (scr_dataset_get_name(dataset, &dset_name) == SCR_SUCCESS) {
+      name = strdup(dset_name);
+    }
+    scr_dataset_get_ckpt(dataset, &ckpt_id);
+  }
+  scr_dataset_delete(&dataset);
+
+  char* cache_dir = NULL;
+  char* dir;
+  if (scr_cache_index_get_dir(cindex, id, &dir) == SCR_SUCCESS) {
+    cache_dir = strdup(dir);
+  }
+
+  /* files of a bypass dataset are not in cache */
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+
+  /* we can only restore checkpoints we know how to find in the prefix */
+  int valid = (name != NULL && ckpt_id >= 0 && cache_dir != NULL && ! bypass);
+  if (! scr_alltrue(valid, scr_comm_world)) {
+    scr_free(&cache_dir);
+    scr_free(&name);
+    return SCR_FAILURE;
+  }
+
+  /* rank 0 checks that the dataset was completely flushed */
+  int flushed = 0;
+  if (scr_my_rank_world == 0) {
+    kvtree* index_hash = kvtree_new();
+    if (scr_index_read(scr_prefix_path, index_hash) == SCR_SUCCESS) {
+      int complete = 0;
+      if (scr_index_get_complete(index_hash, id, name, &complete) == SCR_SUCCESS && complete == 1) {
+        flushed = 1;
+      }
+    }
+    kvtree_delete(&index_hash);
+
+    if (! flushed) {
+      scr_dbg(1, "Dataset %d is not in the prefix directory, cannot restore it", id);
+    }
+  }
+  MPI_Bcast(&flushed, 1, MPI_INT, 0, scr_comm_world);
+  if (! flushed) {
+    scr_free(&cache_dir);
+    scr_free(&name);
+    return SCR_FAILURE;
+  }
+
+  /* get path to dataset metadata directory in prefix as string */
+  spath* path = spath_from_str(scr_prefix_scr);
+  spath_append_strf(path, "scr.dataset.%d", id);
+  char* fetch_dir = spath_strdup(path);
+  spath_delete(&path);
+
+  /* start timer */
+  time_t timestamp_start;
+  double time_start;
+  if (scr_my_rank_world == 0) {
+    timestamp_start = scr_log_seconds();
+    time_start = MPI_Wtime();
+    scr_dbg(1, "Attempting to restore dataset %d from %s", id, name);
+    if (scr_log_enable) {
+      scr_log_event("RESTORE_START", fetch_dir, &id, name, NULL, NULL);
+    }
+  }
+
+  /* read the lost files back into cache */
+  int rc = SCR_FAILURE;
+  kvtree* summary_hash = kvtree_new();
+  if (scr_fetch_summary(fetch_dir, summary_hash, NULL) == SCR_SUCCESS) {
+    int streaming;
+    if (scr_fetch_data(summary_hash, fetch_dir, cache_dir, cindex, id, NULL, 1, 0, &streaming) == SCR_SUCCESS) {
+      rc = SCR_SUCCESS;
+    }
+  }
+  kvtree_delete(&summary_hash);
+
+  /* compute redundancy data again, this sends data from surviving
+   * processes to the processes that replaced lost ones */
+  if (rc == SCR_SUCCESS) {
+    scr_reddesc* c = scr_reddesc_for_checkpoint(ckpt_id, scr_nreddescs, scr_reddescs);
+    scr_filemap* map = scr_filemap_new();
+    scr_cache_get_map(cindex, id, map);
+    rc = scr_reddesc_apply(map, c, id, NULL);
+    scr_filemap_delete(&map);
+  }
+
+  /* the checkpoint is in cache as well as the parallel file system */
+  if (rc == SCR_SUCCESS) {
+    scr_flush_file_location_set(id, SCR_FLUSH_KEY_LOCATION_PFS);
+  }
+
+  /* stop timer and report performance */
+  if (scr_my_rank_world == 0) {
+    double time_end = MPI_Wtime();
+    double time_diff = time_end - time_start;
+    scr_dbg(1, "scr_fetch_restore: return code %d, %f secs", rc, time_diff);
+    if (scr_log_enable) {
+      if (rc == SCR_SUCCESS) {
+        scr_log_event("RESTORE_SUCCESS", fetch_dir, &id, name, &timestamp_start, &time_diff);
+      } else {
+        scr_log_event("RESTORE_FAIL", fetch_dir, &id, name, &timestamp_start, &time_diff);
+      }
+    }
+  }
+
+  scr_free(&fetch_dir);
+  scr_free(&cache_dir);
+  scr_free(&name);
+
+  return rc;
+}
+
 /* attempt to fetch most recent checkpoint from prefix directory into
  * cache, fills in map if successful and sets fetch_attempted to 1 if
  * any fetch is attempted, returns SCR_SUCCESS if successful */
-int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
+int scr_fetch_latest(scr_cache_index* cindex, int keep_cache, int* fetch_attempted)
 {
   /* we only return success if we successfully fetch a checkpoint */
   int rc = SCR_FAILURE;
@@ -628,6 +1732,9 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
   char target[SCR_MAX_FILENAME];
   int target_id = -1;
   while (continue_fetching) {
+    /* id of the checkpoint we'd try if this one fails */
+    int next_id = -1;
+
     /* initialize our target directory to empty string */
     strcpy(target, "");
 
@@ -645,17 +1752,23 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
       }
 
       /* lookup the checkpoint id */
-      int next_id = -1;
+      int target_next_id = -1;
       if (strcmp(target, "") != 0) {
         /* we have a name, lookup the checkpoint id
          * corresponding to this name */
-        scr_index_get_id_by_name(index_hash, target, &next_id);
+        scr_index_get_id_by_name(index_hash, target, &target_next_id);
       } else {
         /* otherwise, just get the most recent complete checkpoint
          * (that's older than the current id) */
-        scr_index_get_most_recent_complete(index_hash, target_id, &next_id, target);
+        scr_index_get_most_recent_complete(index_hash, target_id, &target_next_id, target);
+      }
+      target_id = target_next_id;
+
+      /* look up the checkpoint we'd fall back to if this one fails */
+      if (scr_fetch_prefetch && strcmp(target, "") != 0 && target_id != -1) {
+        char next_name[SCR_MAX_FILENAME];
+        scr_index_get_most_recent_complete(index_hash, target_id, &next_id, next_name);
       }
-      target_id = next_id;
 
       /* TODODSET: need to verify that dataset is really a checkpoint
        * and keep searching if not */
@@ -675,15 +1788,30 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
 
     /* broadcast target id from rank 0 */
     MPI_Bcast(&target_id, 1, MPI_INT, 0, scr_comm_world);
+    MPI_Bcast(&next_id, 1, MPI_INT, 0, scr_comm_world);
 
     /* broadcast target name from rank 0 */
     scr_strn_bcast(target, sizeof(target), 0, scr_comm_world);
 
     /* check whether we've got a path */
     if (strcmp(target, "") != 0) {
+      /* pick up metadata we may have prefetched for this checkpoint,
+       * and read metadata of the next one while we fetch this one */
+      scr_fetch_prefetch_state* prefetch = scr_fetch_prefetch_finish(target_id);
+      if (next_id != -1) {
+        scr_fetch_prefetch_start(next_id);
+      }
+
+      /* drop any dataset we kept in cache other than the one we're
+       * about to fetch, so that we have room for the files we read */
+      if (keep_cache) {
+        scr_cache_delete_others(cindex, target_id);
+      }
+
       /* got something, attempt to fetch the checkpoint */
       int ckpt_id;
-      rc = scr_fetch_dset(cindex, target_id, target, &ckpt_id);
+      rc = scr_fetch_dset_prefetched(cindex, target_id, target, &ckpt_id, prefetch);
+      scr_fetch_prefetch_state_free(&prefetch);
       if (rc == SCR_SUCCESS) {
         /* set the dataset and checkpoint ids */
         scr_dataset_id    = target_id;
@@ -714,6 +1842,10 @@ int scr_fetch_latest(scr_cache_index* cindex, int* fetch_attempted)
     }
   }
 
+  /* discard metadata of a fallback checkpoint we didn't need */
+  scr_fetch_prefetch_state* prefetch = scr_fetch_prefetch_finish(-1);
+  scr_fetch_prefetch_state_free(&prefetch);
+
   /* delete the index hash */
   if (scr_my_rank_world == 0) {
     kvtree_delete(&index_hash);
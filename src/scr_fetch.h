@@ -12,11 +12,29 @@
 #ifndef SCR_FETCH_H
 #define SCR_FETCH_H
 
-/* attempt to fetch most recent checkpoint from prefix directory into cache */
-int scr_fetch_latest(scr_filemap* map, int* fetch_attempted);
+/* attempt to fetch most recent checkpoint from prefix directory into cache,
+ * if keep_cache is set, datasets left in cache by an earlier run are
+ * deleted before each fetch, except for the one being fetched */
+int scr_fetch_latest(scr_cache_index* cindex, int keep_cache, int* fetch_attempted);
 
 /* fetch files from given dataset id and name from parallel file system,
  * return its checkpoint id */
 int scr_fetch_dset(scr_cache_index* cindex, int dset_id, const char* dset_name, int* checkpoint_id);
 
+/* restore a checkpoint in cache that its redundancy scheme failed to
+ * rebuild by reading only the files that processes lost from the
+ * prefix directory, then apply redundancy again,
+ * returns SCR_SUCCESS on all procs if all procs succeeded */
+int scr_fetch_restore(scr_cache_index* cindex, int id);
+
+/* wait until given file has been copied into cache, returns SCR_SUCCESS
+ * if the file is in cache or is not part of a streaming fetch */
+int scr_fetch_stream_wait(const char* file);
+
+/* wait for a streaming fetch to bring all files into cache, then
+ * record their metadata and apply the redundancy scheme, sets id to
+ * the dataset that was fetched or -1 if none was in progress,
+ * returns SCR_SUCCESS on all procs if all procs succeeded */
+int scr_fetch_stream_finish(scr_cache_index* cindex, int* id);
+
 #endif
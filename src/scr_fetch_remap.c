@@ -0,0 +1,684 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+#include "scr_fetch_remap.h"
+
+#include "spath.h"
+#include "kvtree.h"
+#include "kvtree_util.h"
+#include "kvtree_mpi.h"
+
+#include <stdint.h>
+#include <limits.h>
+#include <dirent.h>
+
+/*
+=========================================
+Remap functions
+=========================================
+*/
+
+/* By default, the entries of old rank r are given to new rank
+ * r * new_ranks / old_ranks, so that each new rank takes a block of
+ * consecutive old ranks, and an application may install its own
+ * mapping with SCR_Set_remap.
+ *
+ * To find files in cache, the leader of each store reads the filemaps
+ * an earlier run left in the cache directory of the dataset and offers
+ * every complete file under its name in the prefix directory.  Each
+ * name is assigned to a directory process by hashing it.  Holders tell
+ * the directory process which files they have, and new owners tell it
+ * which files they want.  The directory process matches the two and
+ * tells each side who it exchanges the file with.  A file that is
+ * already at its destination path on the node of its new owner stays
+ * where it is, all others are sent in chunks over MPI, and the holder
+ * deletes its copy afterwards. */
+
+/* keys in messages exchanged to match holders and owners of files */
+#define SCR_FETCH_REMAP_KEY_HAVE    ("HAVE")    /* files offered by a store leader */
+#define SCR_FETCH_REMAP_KEY_WANT    ("WANT")    /* files requested by their new owner */
+#define SCR_FETCH_REMAP_KEY_LEADER  ("LEADER")  /* rank of store leader of the new owner */
+#define SCR_FETCH_REMAP_KEY_FROM    ("FROM")    /* tells owner which rank sends a file */
+#define SCR_FETCH_REMAP_KEY_TO      ("TO")      /* tells holder which rank gets a file */
+#define SCR_FETCH_REMAP_KEY_FAIL    ("FAIL")    /* tells owner that a file was not sent */
+#define SCR_FETCH_REMAP_KEY_PATH    ("PATH")
+#define SCR_FETCH_REMAP_KEY_SIZE    ("SIZE")
+#define SCR_FETCH_REMAP_KEY_RANK    ("RANK")
+#define SCR_FETCH_REMAP_KEY_TAG     ("TAG")
+#define SCR_FETCH_REMAP_KEY_INPLACE ("INPLACE")
+
+/* a file is identified by its index in the list of its owner, which
+ * is used as the message tag, so the index must fit in the tag range
+ * every MPI library supports, files beyond that are read from the
+ * prefix directory */
+#define SCR_FETCH_REMAP_MAX_TAG (32767)
+
+/* state of a file being sent or received */
+typedef struct {
+  int send;            /* whether we send (1) or receive (0) this file */
+  int rank;            /* process on the other end of the transfer */
+  int tag;             /* tag of messages for this file */
+  char* file;          /* path of the file in cache */
+  unsigned long size;  /* number of bytes in the file */
+  unsigned long done;  /* number of bytes transferred so far */
+  int fd;              /* file descriptor, -1 if not open */
+  int failed;          /* set if any part of the transfer failed */
+  char* buf;           /* buffer for the message in flight */
+  int count;           /* number of bytes in the message in flight */
+} scr_fetch_remap_xfer;
+
+/* return the new rank that owns the files of the given old rank */
+static int scr_fetch_remap_owner(int old_rank, int old_ranks, int new_ranks)
+{
+  if (scr_remap_fn != NULL) {
+    return scr_remap_fn(old_rank, old_ranks, new_ranks, scr_remap_arg);
+  }
+  return (int) ((uint64_t) old_rank * (uint64_t) new_ranks / (uint64_t) old_ranks);
+}
+
+/* collectively read the rank2file entries for the calling rank from
+ * the dataset directory and merge them into filelist, if the dataset
+ * was written by a different number of ranks and remapping is enabled,
+ * merge the entries of all old ranks that map to the calling rank and
+ * set remapped to 1 */
+int scr_fetch_remap_filelist(const char* dir, kvtree* filelist, int* remapped)
+{
+  *remapped = 0;
+
+  /* look up the number of ranks that wrote the dataset */
+  unsigned long per_stripe, map_ranks;
+  if (scr_rank2file_layout(dir, scr_comm_world, &per_stripe, &map_ranks) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* read our own entry if the number of ranks is the same, remapping
+   * is disabled, or there is no binary manifest to remap */
+  if (per_stripe == 0 || map_ranks == (unsigned long) scr_ranks_world ||
+      (! scr_fetch_remap && scr_remap_fn == NULL))
+  {
+    return scr_rank2file_read(dir, filelist, scr_comm_world);
+  }
+
+  if (map_ranks > (unsigned long) INT_MAX) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Invalid number of ranks %lu in rank2file map in %s @ %s:%d",
+        map_ranks, dir, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
+  /* every process computes the full mapping, so all of them agree on
+   * whether it is valid, and reads the entries of the old ranks it owns */
+  int rc = SCR_SUCCESS;
+  int old_ranks = (int) map_ranks;
+  int owned = 0;
+  int r;
+  for (r = 0; r < old_ranks; r++) {
+    int owner = scr_fetch_remap_owner(r, old_ranks, scr_ranks_world);
+    if (owner < 0 || owner >= scr_ranks_world) {
+      if (scr_my_rank_world == 0) {
+        scr_err("Remapping rank %d of %d gives invalid rank %d of %d @ %s:%d",
+          r, old_ranks, owner, scr_ranks_world, __FILE__, __LINE__
+        );
+      }
+      rc = SCR_FAILURE;
+      break;
+    }
+
+    if (owner == scr_my_rank_world) {
+      if (scr_rank2file_read_rank(dir, r, per_stripe, filelist) != SCR_SUCCESS) {
+        scr_err("Failed to read rank2file entry of rank %d in %s @ %s:%d",
+          r, dir, __FILE__, __LINE__
+        );
+        rc = SCR_FAILURE;
+      }
+      owned++;
+    }
+  }
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, scr_comm_world)) {
+    return SCR_FAILURE;
+  }
+
+  scr_dbg(2, "Rank %d owns files of %d of %d ranks", scr_my_rank_world, owned, old_ranks);
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "Remapping files of %d ranks onto %d ranks", old_ranks, scr_ranks_world);
+  }
+
+  *remapped = 1;
+  return SCR_SUCCESS;
+}
+
+/* return the process that matches holders and owners of the given file */
+static int scr_fetch_remap_dir_rank(const char* name)
+{
+  /* djb2 string hash */
+  unsigned long hash = 5381;
+  const unsigned char* c;
+  for (c = (const unsigned char*) name; *c != '\0'; c++) {
+    hash = hash * 33 + *c;
+  }
+  return (int) (hash % (unsigned long) scr_ranks_world);
+}
+
+/* return the hash of messages under the given key for the given rank,
+ * creating it if needed */
+static kvtree* scr_fetch_remap_msgs(kvtree* hash, int rank, const char* key)
+{
+  return kvtree_setf(hash, NULL, "%d %s", rank, key);
+}
+
+/* add each complete file listed in a filemap in the cache directory
+ * to offered, keyed by the name of the file in the prefix directory,
+ * files that can't be offered are deleted, as are the filemaps of
+ * ranks that no longer exist */
+static void scr_fetch_remap_scan(const char* cache_dir, kvtree* offered)
+{
+  /* filemaps are stored in the hidden directory of the dataset */
+  spath* path = spath_from_str(cache_dir);
+  spath_append_str(path, ".scr");
+  char* dir = spath_strdup(path);
+  spath_delete(&path);
+
+  DIR* dirp = opendir(dir);
+  if (dirp == NULL) {
+    scr_free(&dir);
+    return;
+  }
+
+  struct dirent* dp;
+  while ((dp = readdir(dirp)) != NULL) {
+    /* only consider filemap_<rank>, which skips journal files */
+    int rank;
+    char extra;
+    if (sscanf(dp->d_name, "filemap_%d%c", &rank, &extra) != 1) {
+      continue;
+    }
+
+    spath* map_path = spath_from_str(dir);
+    spath_append_str(map_path, dp->d_name);
+
+    scr_filemap* map = scr_filemap_new();
+    scr_filemap_read(map_path, map);
+
+    kvtree_elem* elem;
+    for (elem = scr_filemap_first_file(map);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      const char* file = kvtree_elem_key(elem);
+
+      /* get the name of this file in the prefix directory */
+      char* name = NULL;
+      unsigned long size;
+      scr_meta* meta = scr_meta_new();
+      char* origpath;
+      char* origname;
+      if (scr_bool_have_file(map, file, NULL) &&
+          scr_filemap_get_meta(map, file, meta) == SCR_SUCCESS &&
+          scr_meta_get_origpath(meta, &origpath) == SCR_SUCCESS &&
+          scr_meta_get_origname(meta, &origname) == SCR_SUCCESS &&
+          scr_meta_get_filesize(meta, &size) == SCR_SUCCESS)
+      {
+        spath* orig = spath_from_str(origpath);
+        spath_append_str(orig, origname);
+        spath_reduce(orig);
+        name = spath_strdup(orig);
+        spath_delete(&orig);
+      }
+      scr_meta_delete(&meta);
+
+      /* we keep at most one copy of each file */
+      char* offered_file = NULL;
+      kvtree* entry = (name != NULL) ? kvtree_get(offered, name) : NULL;
+      if (entry != NULL) {
+        kvtree_util_get_str(entry, SCR_FETCH_REMAP_KEY_PATH, &offered_file);
+      }
+      if (name != NULL && entry == NULL) {
+        entry = kvtree_new();
+        kvtree_util_set_str(entry, SCR_FETCH_REMAP_KEY_PATH, file);
+        kvtree_util_set_bytecount(entry, SCR_FETCH_REMAP_KEY_SIZE, size);
+        kvtree_set(offered, name, entry);
+      } else if (offered_file == NULL || strcmp(offered_file, file) != 0) {
+        scr_file_unlink(file);
+      }
+
+      scr_free(&name);
+    }
+    scr_filemap_delete(&map);
+
+    /* processes with this rank no longer exist, so nothing will
+     * overwrite their filemap */
+    if (rank >= scr_ranks_world) {
+      char* map_file = spath_strdup(map_path);
+      scr_file_unlink(map_file);
+      scr_filemap_journal_unlink(map_path);
+      scr_free(&map_file);
+    }
+
+    spath_delete(&map_path);
+  }
+
+  closedir(dirp);
+  scr_free(&dir);
+}
+
+/* post the next message for the given transfer */
+static void scr_fetch_remap_post(scr_fetch_remap_xfer* x, MPI_Comm comm, MPI_Request* req)
+{
+  unsigned long remaining = x->size - x->done;
+  x->count = scr_mpi_buf_size;
+  if (remaining < (unsigned long) scr_mpi_buf_size) {
+    x->count = (int) remaining;
+  }
+
+  if (x->send) {
+    /* if we fail to read, keep sending so the receiver is not left
+     * waiting, it learns about the failure after the transfer */
+    if (! x->failed && scr_read_attempt(x->file, x->fd, x->buf, (size_t) x->count) != (ssize_t) x->count) {
+      scr_err("Failed to read %d bytes from %s @ %s:%d",
+        x->count, x->file, __FILE__, __LINE__
+      );
+      x->failed = 1;
+    }
+    MPI_Isend(x->buf, x->count, MPI_BYTE, x->rank, x->tag, comm, req);
+  } else {
+    MPI_Irecv(x->buf, x->count, MPI_BYTE, x->rank, x->tag, comm, req);
+  }
+}
+
+/* send and receive files in chunks, keeping one message in flight
+ * for each file until all of them are done */
+static void scr_fetch_remap_transfer(int count, scr_fetch_remap_xfer* xfers, MPI_Comm comm)
+{
+  if (count == 0) {
+    return;
+  }
+
+  MPI_Request* reqs = (MPI_Request*) SCR_MALLOC(count * sizeof(MPI_Request));
+
+  /* open all files and post the first message of each */
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int i;
+  for (i = 0; i < count; i++) {
+    scr_fetch_remap_xfer* x = &xfers[i];
+    reqs[i] = MPI_REQUEST_NULL;
+
+    if (x->send) {
+      x->fd = scr_open(x->file, O_RDONLY);
+    } else {
+      x->fd = scr_open(x->file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+    }
+    if (x->fd < 0) {
+      scr_err("Opening file %s for transfer: errno=%d %s @ %s:%d",
+        x->file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      x->failed = 1;
+    }
+
+    if (x->size > 0) {
+      x->buf = (char*) SCR_MALLOC(scr_mpi_buf_size);
+      scr_fetch_remap_post(x, comm, &reqs[i]);
+    }
+  }
+
+  /* write out each chunk we receive and post the next message */
+  int index;
+  MPI_Waitany(count, reqs, &index, MPI_STATUS_IGNORE);
+  while (index != MPI_UNDEFINED) {
+    scr_fetch_remap_xfer* x = &xfers[index];
+    if (! x->send && ! x->failed &&
+        scr_write_attempt(x->file, x->fd, x->buf, (size_t) x->count) != (ssize_t) x->count)
+    {
+      scr_err("Failed to write %d bytes to %s @ %s:%d",
+        x->count, x->file, __FILE__, __LINE__
+      );
+      x->failed = 1;
+    }
+
+    x->done += (unsigned long) x->count;
+    if (x->done < x->size) {
+      scr_fetch_remap_post(x, comm, &reqs[index]);
+    }
+
+    MPI_Waitany(count, reqs, &index, MPI_STATUS_IGNORE);
+  }
+
+  for (i = 0; i < count; i++) {
+    scr_fetch_remap_xfer* x = &xfers[i];
+    if (x->fd >= 0 && scr_close(x->file, x->fd) != SCR_SUCCESS) {
+      x->failed = 1;
+    }
+    scr_free(&x->buf);
+  }
+
+  scr_free(&reqs);
+}
+
+/* collectively move files of the given dataset that are held in the
+ * cache of some node to the processes that own them after a remap,
+ * sets have[i] to 1 for each file in dest_filelist that is in place
+ * on return, files with have[i] set to 0 must be read from the prefix
+ * directory, src_filelist names each file in the prefix directory */
+int scr_fetch_remap_cache(
+  const scr_cache_index* cindex,
+  int id,
+  const char* cache_dir,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  int* have)
+{
+  int i;
+  for (i = 0; i < num_files; i++) {
+    have[i] = 0;
+  }
+
+  /* get the rank of the leader of our store, which offers the files
+   * in the cache directory on behalf of all processes in the store */
+  int leader = -1;
+  kvtree* offered = kvtree_new();
+  const scr_storedesc* store = scr_cache_get_storedesc(cindex, id);
+  if (store != NULL && store->comm != MPI_COMM_NULL) {
+    leader = scr_my_rank_world;
+    MPI_Bcast(&leader, 1, MPI_INT, 0, store->comm);
+    if (store->rank == 0) {
+      scr_fetch_remap_scan(cache_dir, offered);
+    }
+  }
+
+  /* tell directory processes which files we have and which we want */
+  kvtree* send = kvtree_new();
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(offered);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* name = kvtree_elem_key(elem);
+    int dir_rank = scr_fetch_remap_dir_rank(name);
+    kvtree* msgs = scr_fetch_remap_msgs(send, dir_rank, SCR_FETCH_REMAP_KEY_HAVE);
+    kvtree* entry = kvtree_new();
+    kvtree_merge(entry, kvtree_elem_hash(elem));
+    kvtree_set(msgs, name, entry);
+  }
+  for (i = 0; i < num_files && i <= SCR_FETCH_REMAP_MAX_TAG; i++) {
+    const char* name = src_filelist[i];
+    int dir_rank = scr_fetch_remap_dir_rank(name);
+    kvtree* msgs = scr_fetch_remap_msgs(send, dir_rank, SCR_FETCH_REMAP_KEY_WANT);
+    kvtree* entry = kvtree_new();
+    kvtree_util_set_int(entry, SCR_FETCH_REMAP_KEY_TAG, i);
+    kvtree_util_set_str(entry, SCR_FETCH_REMAP_KEY_PATH, dest_filelist[i]);
+    kvtree_set(msgs, name, entry);
+    kvtree_util_set_int(kvtree_getf(send, "%d", dir_rank), SCR_FETCH_REMAP_KEY_LEADER, leader);
+  }
+
+  kvtree* recv = kvtree_new();
+  kvtree_exchange(send, recv, scr_comm_world);
+  kvtree_delete(&send);
+
+  /* as a directory process, index the holders of each file by name */
+  kvtree* holders = kvtree_new();
+  for (elem = kvtree_elem_first(recv);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    int holder = kvtree_elem_key_int(elem);
+    kvtree* have_hash = kvtree_get(kvtree_elem_hash(elem), SCR_FETCH_REMAP_KEY_HAVE);
+    kvtree_elem* file_elem;
+    for (file_elem = kvtree_elem_first(have_hash);
+         file_elem != NULL;
+         file_elem = kvtree_elem_next(file_elem))
+    {
+      const char* name = kvtree_elem_key(file_elem);
+      kvtree* entry = kvtree_new();
+      kvtree_merge(entry, kvtree_elem_hash(file_elem));
+      kvtree_setf(kvtree_set_kv(holders, name, "RANK"), entry, "%d", holder);
+    }
+  }
+
+  /* match each wanted file with one holder, preferring a copy that is
+   * already at its destination on the node of its owner */
+  kvtree* reply = kvtree_new();
+  for (elem = kvtree_elem_first(recv);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    int owner = kvtree_elem_key_int(elem);
+    kvtree* owner_hash = kvtree_elem_hash(elem);
+    int owner_leader = -1;
+    kvtree_util_get_int(owner_hash, SCR_FETCH_REMAP_KEY_LEADER, &owner_leader);
+
+    kvtree* want_hash = kvtree_get(owner_hash, SCR_FETCH_REMAP_KEY_WANT);
+    kvtree_elem* file_elem;
+    for (file_elem = kvtree_elem_first(want_hash);
+         file_elem != NULL;
+         file_elem = kvtree_elem_next(file_elem))
+    {
+      const char* name = kvtree_elem_key(file_elem);
+      kvtree* want = kvtree_elem_hash(file_elem);
+      int tag;
+      char* dest;
+      kvtree_util_get_int(want, SCR_FETCH_REMAP_KEY_TAG, &tag);
+      kvtree_util_get_str(want, SCR_FETCH_REMAP_KEY_PATH, &dest);
+
+      kvtree* by_rank = kvtree_get_kv(holders, name, "RANK");
+      kvtree_elem* holder_elem = kvtree_elem_first(by_rank);
+      if (holder_elem == NULL) {
+        /* nobody has this file in cache */
+        continue;
+      }
+
+      int inplace = 0;
+      kvtree_elem* e;
+      for (e = holder_elem; e != NULL; e = kvtree_elem_next(e)) {
+        char* path;
+        kvtree_util_get_str(kvtree_elem_hash(e), SCR_FETCH_REMAP_KEY_PATH, &path);
+        if (kvtree_elem_key_int(e) == owner_leader && strcmp(path, dest) == 0) {
+          holder_elem = e;
+          inplace = 1;
+          break;
+        }
+      }
+
+      int holder = kvtree_elem_key_int(holder_elem);
+      char* path;
+      unsigned long size;
+      kvtree_util_get_str(kvtree_elem_hash(holder_elem), SCR_FETCH_REMAP_KEY_PATH, &path);
+      kvtree_util_get_bytecount(kvtree_elem_hash(holder_elem), SCR_FETCH_REMAP_KEY_SIZE, &size);
+
+      /* tell the owner where the file comes from */
+      kvtree* from = kvtree_new();
+      kvtree_util_set_int(from, SCR_FETCH_REMAP_KEY_RANK, holder);
+      kvtree_util_set_bytecount(from, SCR_FETCH_REMAP_KEY_SIZE, size);
+      kvtree_util_set_int(from, SCR_FETCH_REMAP_KEY_INPLACE, inplace);
+      kvtree_setf(scr_fetch_remap_msgs(reply, owner, SCR_FETCH_REMAP_KEY_FROM), from, "%d", tag);
+
+      /* tell the holder where the file goes */
+      kvtree* to = kvtree_new();
+      kvtree_util_set_int(to, SCR_FETCH_REMAP_KEY_RANK, owner);
+      kvtree_util_set_int(to, SCR_FETCH_REMAP_KEY_TAG, tag);
+      kvtree_util_set_bytecount(to, SCR_FETCH_REMAP_KEY_SIZE, size);
+      kvtree_util_set_int(to, SCR_FETCH_REMAP_KEY_INPLACE, inplace);
+      kvtree_set(scr_fetch_remap_msgs(reply, holder, SCR_FETCH_REMAP_KEY_TO), path, to);
+
+      /* each copy goes to a single owner */
+      kvtree_unset(holders, name);
+    }
+  }
+  kvtree_delete(&holders);
+  kvtree_delete(&recv);
+
+  recv = kvtree_new();
+  kvtree_exchange(reply, recv, scr_comm_world);
+  kvtree_delete(&reply);
+
+  /* build list of files we send and receive,
+   * and record files we hold that stay in place */
+  int count = 0;
+  kvtree* keep = kvtree_new();
+  for (elem = kvtree_elem_first(recv);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    count += kvtree_size(kvtree_get(kvtree_elem_hash(elem), SCR_FETCH_REMAP_KEY_FROM));
+    count += kvtree_size(kvtree_get(kvtree_elem_hash(elem), SCR_FETCH_REMAP_KEY_TO));
+  }
+  scr_fetch_remap_xfer* xfers = NULL;
+  if (count > 0) {
+    xfers = (scr_fetch_remap_xfer*) SCR_MALLOC(count * sizeof(scr_fetch_remap_xfer));
+  }
+
+  int nxfers = 0;
+  for (elem = kvtree_elem_first(recv);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    kvtree_elem* file_elem;
+    kvtree* from_hash = kvtree_get(kvtree_elem_hash(elem), SCR_FETCH_REMAP_KEY_FROM);
+    for (file_elem = kvtree_elem_first(from_hash);
+         file_elem != NULL;
+         file_elem = kvtree_elem_next(file_elem))
+    {
+      int tag = kvtree_elem_key_int(file_elem);
+      kvtree* from = kvtree_elem_hash(file_elem);
+      int inplace = 0;
+      kvtree_util_get_int(from, SCR_FETCH_REMAP_KEY_INPLACE, &inplace);
+      if (tag < 0 || tag >= num_files) {
+        continue;
+      }
+      if (inplace) {
+        have[tag] = 1;
+        continue;
+      }
+
+      scr_fetch_remap_xfer* x = &xfers[nxfers];
+      memset(x, 0, sizeof(*x));
+      x->send = 0;
+      x->tag  = tag;
+      x->fd   = -1;
+      x->file = strdup(dest_filelist[tag]);
+      kvtree_util_get_int(from, SCR_FETCH_REMAP_KEY_RANK, &x->rank);
+      kvtree_util_get_bytecount(from, SCR_FETCH_REMAP_KEY_SIZE, &x->size);
+      nxfers++;
+    }
+
+    kvtree* to_hash = kvtree_get(kvtree_elem_hash(elem), SCR_FETCH_REMAP_KEY_TO);
+    for (file_elem = kvtree_elem_first(to_hash);
+         file_elem != NULL;
+         file_elem = kvtree_elem_next(file_elem))
+    {
+      const char* path = kvtree_elem_key(file_elem);
+      kvtree* to = kvtree_elem_hash(file_elem);
+      int inplace = 0;
+      kvtree_util_get_int(to, SCR_FETCH_REMAP_KEY_INPLACE, &inplace);
+      if (inplace) {
+        kvtree_set_kv(keep, path, "1");
+        continue;
+      }
+
+      scr_fetch_remap_xfer* x = &xfers[nxfers];
+      memset(x, 0, sizeof(*x));
+      x->send = 1;
+      x->fd   = -1;
+      x->file = strdup(path);
+      kvtree_util_get_int(to, SCR_FETCH_REMAP_KEY_RANK, &x->rank);
+      kvtree_util_get_int(to, SCR_FETCH_REMAP_KEY_TAG,  &x->tag);
+      kvtree_util_get_bytecount(to, SCR_FETCH_REMAP_KEY_SIZE, &x->size);
+      nxfers++;
+    }
+  }
+  kvtree_delete(&recv);
+
+  /* move the files on a separate communicator,
+   * since tags are only unique within this operation */
+  MPI_Comm comm;
+  MPI_Comm_dup(scr_comm_world, &comm);
+  scr_fetch_remap_transfer(nxfers, xfers, comm);
+  MPI_Comm_free(&comm);
+
+  /* tell owners about files we failed to send */
+  send = kvtree_new();
+  for (i = 0; i < nxfers; i++) {
+    scr_fetch_remap_xfer* x = &xfers[i];
+    if (x->send && x->failed) {
+      kvtree_set_kv_int(scr_fetch_remap_msgs(send, x->rank, SCR_FETCH_REMAP_KEY_FAIL), "TAG", x->tag);
+    }
+  }
+  recv = kvtree_new();
+  kvtree_exchange(send, recv, scr_comm_world);
+  kvtree_delete(&send);
+
+  /* mark files we received as in place, unless either side failed */
+  int moved = 0;
+  double bytes = 0.0;
+  for (i = 0; i < nxfers; i++) {
+    scr_fetch_remap_xfer* x = &xfers[i];
+    if (x->send) {
+      continue;
+    }
+
+    kvtree* fail_hash = kvtree_getf(recv, "%d %s", x->rank, SCR_FETCH_REMAP_KEY_FAIL);
+    if (fail_hash != NULL && kvtree_get_kv_int(fail_hash, "TAG", x->tag) != NULL) {
+      x->failed = 1;
+    }
+
+    if (x->failed) {
+      scr_file_unlink(x->file);
+    } else {
+      have[x->tag] = 1;
+      moved++;
+      bytes += (double) x->size;
+    }
+  }
+  kvtree_delete(&recv);
+
+  /* delete files we hold unless they stay in place,
+   * since they have been sent to their owner or nobody wants them */
+  for (elem = kvtree_elem_first(offered);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* path;
+    kvtree_util_get_str(kvtree_elem_hash(elem), SCR_FETCH_REMAP_KEY_PATH, &path);
+    if (kvtree_get(keep, path) == NULL) {
+      scr_file_unlink(path);
+    }
+  }
+  kvtree_delete(&keep);
+  kvtree_delete(&offered);
+
+  for (i = 0; i < nxfers; i++) {
+    scr_free(&xfers[i].file);
+  }
+  scr_free(&xfers);
+
+  /* report how many files we found in cache */
+  int found = 0;
+  for (i = 0; i < num_files; i++) {
+    if (have[i]) {
+      found++;
+    }
+  }
+  int counts[2] = {found, moved};
+  int total[2];
+  double total_bytes;
+  MPI_Reduce(counts, total, 2, MPI_INT, MPI_SUM, 0, scr_comm_world);
+  MPI_Reduce(&bytes, &total_bytes, 1, MPI_DOUBLE, MPI_SUM, 0, scr_comm_world);
+  if (scr_my_rank_world == 0) {
+    scr_dbg(1, "Found %d files in cache, moved %d files with %e bytes between processes",
+      total[0], total[1], total_bytes
+    );
+  }
+
+  return SCR_SUCCESS;
+}
@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_FETCH_REMAP_H
+#define SCR_FETCH_REMAP_H
+
+#include "kvtree.h"
+#include "scr_cache_index.h"
+
+/*
+=========================================
+This file lets a job restart from a dataset that was written by a job
+with a different number of processes.  The rank2file entries of the
+old ranks are handed out to the new ranks, and files that an earlier
+run left in cache are moved over MPI to the processes that now own
+them instead of being read again from the parallel file system.
+=========================================
+*/
+
+/* collectively read the rank2file entries for the calling rank from
+ * the dataset directory and merge them into filelist, if the dataset
+ * was written by a different number of ranks and remapping is enabled,
+ * merge the entries of all old ranks that map to the calling rank and
+ * set remapped to 1 */
+int scr_fetch_remap_filelist(const char* dir, kvtree* filelist, int* remapped);
+
+/* collectively move files of the given dataset that are held in the
+ * cache of some node to the processes that own them after a remap,
+ * sets have[i] to 1 for each file in dest_filelist that is in place
+ * on return, files with have[i] set to 0 must be read from the prefix
+ * directory, src_filelist names each file in the prefix directory */
+int scr_fetch_remap_cache(
+  const scr_cache_index* cindex,
+  int id,
+  const char* cache_dir,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  int* have
+);
+
+#endif
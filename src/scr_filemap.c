@@ -59,6 +59,9 @@ WRITE:
 #define SCR_FILEMAP_KEY_DATA    ("DSETDESC")
 #define SCR_FILEMAP_KEY_META    ("META")
 
+/* suffix appended to filemap file name to get its journal file */
+#define SCR_FILEMAP_JOURNAL_EXT ("journal")
+
 /* returns the FILE hash associated with filemap */
 static kvtree* scr_filemap_get_fh(const kvtree* hash)
 {
@@ -252,7 +255,158 @@ int scr_filemap_merge(scr_filemap* map1, scr_filemap* map2)
   return SCR_SUCCESS;
 }
 
-/* reads specified file and fills in filemap structure */
+/* The journal is an append-only file that lives next to the filemap
+ * file.  Each record is a small filemap holding a single file and its
+ * metadata.  Registering a file appends one record rather than
+ * rewriting the full map, and writing the full map later compacts the
+ * journal away.  Since the full map is always written after any
+ * journal records it subsumes, a record only adds a file if the full
+ * map does not already list it. */
+
+/* returns name of journal file for given filemap file,
+ * caller must free returned string */
+static char* scr_filemap_journal_name(const spath* path_file)
+{
+  char* file = spath_strdup(path_file);
+  size_t len = strlen(file) + strlen(SCR_FILEMAP_JOURNAL_EXT) + 2;
+  char* journal = (char*) SCR_MALLOC(len);
+  snprintf(journal, len, "%s.%s", file, SCR_FILEMAP_JOURNAL_EXT);
+  scr_free(&file);
+  return journal;
+}
+
+/* reads records from journal file and adds any file that is not
+ * already listed in map */
+static int scr_filemap_journal_replay(const char* file, scr_filemap* map)
+{
+  /* open the journal for reading */
+  int fd = scr_open(file, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening filemap journal for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* get size of journal so we know when we've read the last record */
+  off_t size = lseek(fd, 0, SEEK_END);
+  lseek(fd, 0, SEEK_SET);
+
+  /* apply records in order, later records for the same file
+   * replace earlier ones */
+  scr_filemap* journal = scr_filemap_new();
+  off_t pos = 0;
+  while (pos < size) {
+    /* read the next record */
+    scr_filemap* record = scr_filemap_new();
+    ssize_t nread = kvtree_read_fd(file, fd, record);
+    if (nread <= 0) {
+      /* the last record may be partial if we were interrupted
+       * in the middle of an append, keep what we have so far */
+      scr_dbg(2, "Stopped replay of filemap journal %s at offset %lu @ %s:%d",
+        file, (unsigned long) pos, __FILE__, __LINE__
+      );
+      scr_filemap_delete(&record);
+      break;
+    }
+    pos = lseek(fd, 0, SEEK_CUR);
+
+    /* copy each file and its meta from record into journal map */
+    kvtree_elem* elem;
+    for (elem = scr_filemap_first_file(record);
+         elem != NULL;
+         elem = kvtree_elem_next(elem))
+    {
+      char* name = kvtree_elem_key(elem);
+      scr_filemap_add_file(journal, name);
+      scr_meta* meta = kvtree_get(kvtree_elem_hash(elem), SCR_FILEMAP_KEY_META);
+      if (meta != NULL) {
+        scr_filemap_set_meta(journal, name, meta);
+      }
+    }
+
+    scr_filemap_delete(&record);
+  }
+
+  /* close the journal */
+  scr_close(file, fd);
+
+  /* add files the full map does not know about yet */
+  kvtree_elem* elem;
+  for (elem = scr_filemap_first_file(journal);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* name = kvtree_elem_key(elem);
+    if (scr_filemap_get_f(map, name) == NULL) {
+      scr_filemap_add_file(map, name);
+      scr_meta* meta = kvtree_get(kvtree_elem_hash(elem), SCR_FILEMAP_KEY_META);
+      if (meta != NULL) {
+        scr_filemap_set_meta(map, name, meta);
+      }
+    }
+  }
+
+  scr_filemap_delete(&journal);
+
+  return SCR_SUCCESS;
+}
+
+/* appends a record for given file and its metadata in map to the
+ * journal of the specified filemap file */
+int scr_filemap_journal_append(const spath* path_file, const scr_filemap* map, const char* file)
+{
+  /* check that we have a map pointer */
+  if (map == NULL) {
+    return SCR_FAILURE;
+  }
+
+  /* build a record holding just this file and its meta */
+  scr_filemap* record = scr_filemap_new();
+  scr_filemap_add_file(record, file);
+  scr_meta* meta = scr_meta_new();
+  if (scr_filemap_get_meta(map, file, meta) == SCR_SUCCESS) {
+    scr_filemap_set_meta(record, file, meta);
+  }
+  scr_meta_delete(&meta);
+
+  /* append record to end of journal */
+  int rc = SCR_SUCCESS;
+  char* journal = scr_filemap_journal_name(path_file);
+  mode_t mode_file = scr_getmode(1, 1, 0);
+  int fd = scr_open(journal, O_WRONLY | O_CREAT | O_APPEND, mode_file);
+  if (fd >= 0) {
+    if (kvtree_write_fd(journal, fd, record) < 0) {
+      scr_err("Writing filemap journal %s @ %s:%d",
+        journal, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    scr_close(journal, fd);
+  } else {
+    scr_err("Opening filemap journal for write: scr_open(%s) errno=%d %s @ %s:%d",
+      journal, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&journal);
+  scr_filemap_delete(&record);
+
+  return rc;
+}
+
+/* deletes journal of the specified filemap file */
+int scr_filemap_journal_unlink(const spath* path_file)
+{
+  char* journal = scr_filemap_journal_name(path_file);
+  int rc = scr_file_unlink(journal);
+  scr_free(&journal);
+  return rc;
+}
+
+/* reads specified file and fills in filemap structure,
+ * then applies any records from its journal */
 int scr_filemap_read(const spath* path_file, scr_filemap* map)
 {
   /* check that we have a map pointer and a hash within the map */
@@ -265,27 +419,38 @@ int scr_filemap_read(const spath* path_file, scr_filemap* map)
 
   /* get file name */
   char* file = spath_strdup(path_file);
+  char* journal = scr_filemap_journal_name(path_file);
+
+  /* the full map may not exist yet if we only have journal entries */
+  int have_file    = (scr_file_is_readable(file)    == SCR_SUCCESS);
+  int have_journal = (scr_file_is_readable(journal) == SCR_SUCCESS);
 
   /* can't read file, return error (special case so as not to print error message below) */
-  if (scr_file_is_readable(file) != SCR_SUCCESS) {
+  if (! have_file && ! have_journal) {
     goto cleanup;
   }
 
   /* ok, now try to read the file */
-  if (kvtree_read_file(file, map) != KVTREE_SUCCESS) {
+  if (have_file && kvtree_read_file(file, map) != KVTREE_SUCCESS) {
     scr_err("Reading filemap %s @ %s:%d",
       file, __FILE__, __LINE__
     );
     goto cleanup;
   }
 
+  /* add any files recorded since the full map was written */
+  if (have_journal && scr_filemap_journal_replay(journal, map) != SCR_SUCCESS) {
+    goto cleanup;
+  }
+
   /* TODO: check that file count for each rank matches expected count */
 
   /* success if we make it this far */
   rc = SCR_SUCCESS;
 
 cleanup:
-  /* free file name string */
+  /* free file name strings */
+  scr_free(&journal);
   scr_free(&file);
 
   return rc;
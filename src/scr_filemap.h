@@ -119,12 +119,20 @@ Filemap read/write/free functions
 =========================================
 */
 
-/* reads specified file and fills in filemap structure */
+/* reads specified file and fills in filemap structure,
+ * then applies any records from its journal */
 int scr_filemap_read(const spath* file, scr_filemap* map);
 
 /* writes given filemap to specified file */
 int scr_filemap_write(const spath* file, const scr_filemap* map);
 
+/* appends a record for given file and its metadata in map to the
+ * journal of the specified filemap file */
+int scr_filemap_journal_append(const spath* file, const scr_filemap* map, const char* name);
+
+/* deletes journal of the specified filemap file */
+int scr_filemap_journal_unlink(const spath* file);
+
 /* create a new filemap structure */
 scr_filemap* scr_filemap_new(void);
 
@@ -74,9 +74,16 @@ int scr_flush_list_alloc(
         spath_append_str(dest_path, origname);
         char* destfile = spath_strdup(dest_path);
 
-        /* add file to our list */
-        src_filelist[i] = strdup(file);
-        dst_filelist[i] = strdup(destfile);
+        /* add file to our list, if the file has been compressed,
+         * transfer the compressed copy instead */
+        char* compressed;
+        if (kvtree_util_get_str(hash, SCR_KEY_COMPRESS, &compressed) == KVTREE_SUCCESS) {
+          src_filelist[i] = strdup(compressed);
+          dst_filelist[i] = scr_strdupf("%s%s", destfile, SCR_COMPRESS_EXT);
+        } else {
+          src_filelist[i] = strdup(file);
+          dst_filelist[i] = strdup(destfile);
+        }
         i++;
 
         spath_delete(&dest_path);
@@ -127,78 +134,405 @@ int scr_flush_create_dirs(
   const char* basepath,       /* top-level directory, assumed to exist */
   int count,                  /* number of files */
   const char** dest_filelist, /* list of files */
+  int width,                  /* max number of procs to create directories at once */
   MPI_Comm comm)              /* communicator of participating processes */
 {
-  /* TODO: need to list dirs in order from parent to child */
-
-  /* allocate buffers to hold the directory needed for each file */
-  int* leader           = (int*)         SCR_MALLOC(sizeof(int)         * count);
-  const char** dirs     = (const char**) SCR_MALLOC(sizeof(const char*) * count);
-  uint64_t* group_id    = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-  uint64_t* group_ranks = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-  uint64_t* group_rank  = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * count);
-
-  /* lookup directory from meta data for each file */
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* build the set of directories we need, along with each of their
+   * ancestors below basepath, and record the depth of each below
+   * basepath, so that we can create parents before children */
+  kvtree* dir_hash = kvtree_new();
+  spath* base = spath_from_str(basepath);
+  spath_reduce(base);
   int i;
   for (i = 0; i < count; i++) {
     /* extract directory from filename */
-    const char* filename = dest_filelist[i];
-    spath* path = spath_from_str(filename);
-    spath_dirname(path);
-    dirs[i] = spath_strdup(path);
-    spath_delete(&path);
+    spath* dir = spath_from_str(dest_filelist[i]);
+    spath_dirname(dir);
+    spath_reduce(dir);
+
+    if (spath_is_child(base, dir)) {
+      /* add each directory from the one just below basepath
+       * down to the one that holds the file */
+      spath* rel = spath_relative(base, dir);
+      int components = spath_components(rel);
+      int depth;
+      for (depth = 1; depth <= components; depth++) {
+        spath* sub = spath_dup(rel);
+        spath_slice(sub, 0, depth);
+        spath* path = spath_dup(base);
+        spath_append(path, sub);
+        char* path_str = spath_strdup(path);
+        kvtree_util_set_int(dir_hash, path_str, depth);
+        scr_free(&path_str);
+        spath_delete(&path);
+        spath_delete(&sub);
+      }
+      spath_delete(&rel);
+    } else {
+      /* not under basepath, so we can't tell which parents exist,
+       * create it with the first level and let scr_mkdir fill in
+       * any missing parents */
+      char* dir_str = spath_strdup(dir);
+      kvtree_util_set_int(dir_hash, dir_str, 1);
+      scr_free(&dir_str);
+    }
 
-    /* we'll use DTCMP to select one leader for each directory later */
-    leader[i] = 0;
+    spath_delete(&dir);
+  }
+  spath_delete(&base);
+
+  /* allocate buffers to hold each directory and its depth */
+  int num_dirs = kvtree_size(dir_hash);
+  const char** dirs     = (const char**) SCR_MALLOC(sizeof(const char*) * num_dirs);
+  int* depths           = (int*)         SCR_MALLOC(sizeof(int)         * num_dirs);
+  int* leader           = (int*)         SCR_MALLOC(sizeof(int)         * num_dirs);
+  uint64_t* group_id    = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * num_dirs);
+  uint64_t* group_ranks = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * num_dirs);
+  uint64_t* group_rank  = (uint64_t*)    SCR_MALLOC(sizeof(uint64_t)    * num_dirs);
+
+  int max_depth = 0;
+  kvtree_elem* elem;
+  i = 0;
+  for (elem = kvtree_elem_first(dir_hash);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    dirs[i]   = kvtree_elem_key(elem);
+    depths[i] = kvtree_elem_key_int(kvtree_elem_first(kvtree_elem_hash(elem)));
+    if (depths[i] > max_depth) {
+      max_depth = depths[i];
+    }
+    i++;
   }
 
-  /* with DTCMP we identify a single process to create each directory */
-
-  /* identify the set of unique directories */
+  /* with DTCMP we identify a single process to create each directory,
+   * when many procs need the same set of directories, rotate the
+   * leader among them so that no single proc creates them all */
   uint64_t groups;
   DTCMP_Rankv_strings(
-    count, dirs, &groups, group_id, group_ranks, group_rank,
+    num_dirs, dirs, &groups, group_id, group_ranks, group_rank,
     DTCMP_FLAG_NONE, comm
   );
-
-  /* select leader for each directory */
-  for (i = 0; i < count; i++) {
-    if (group_rank[i] == 0) {
-      leader[i] = 1;
-    }
+  for (i = 0; i < num_dirs; i++) {
+    leader[i] = (group_rank[i] == group_id[i] % group_ranks[i]);
   }
 
   /* get file mode for directory permissions */
   mode_t mode_dir = scr_getmode(1, 1, 1);
 
-  /* TODO: add flow control here */
+  /* bound the number of procs creating directories at once */
+  if (width <= 0 || width > ranks) {
+    width = ranks;
+  }
 
-  /* create other directories in file list */
+  /* create directories one level at a time, since the parents of
+   * each level were created in the level before, each leader only
+   * needs a single mkdir per directory */
+  MPI_Allreduce(MPI_IN_PLACE, &max_depth, 1, MPI_INT, MPI_MAX, comm);
   int success = 1;
-  for (i = 0; i < count; i++) {
-    /* get directory name */
-    const char* dir = dirs[i];
+  int depth;
+  for (depth = 1; depth <= max_depth; depth++) {
+    /* determine whether we create any directories at this level */
+    int have_work = 0;
+    for (i = 0; i < num_dirs; i++) {
+      if (leader[i] && depths[i] == depth) {
+        have_work = 1;
+        break;
+      }
+    }
 
-    /* if we're the leader, create directory */
-    if (leader[i]) {
-      if (scr_mkdir(dir, mode_dir) != SCR_SUCCESS) {
-        success = 0;
+    /* procs with work create their directories in rounds,
+     * with width procs in each round */
+    MPI_Comm work_comm;
+    MPI_Comm_split(comm, have_work ? 0 : MPI_UNDEFINED, rank, &work_comm);
+    if (work_comm != MPI_COMM_NULL) {
+      int work_rank, work_ranks;
+      MPI_Comm_rank(work_comm, &work_rank);
+      MPI_Comm_size(work_comm, &work_ranks);
+
+      int rounds = (work_ranks + width - 1) / width;
+      int round;
+      for (round = 0; round < rounds; round++) {
+        if (work_rank / width == round) {
+          for (i = 0; i < num_dirs; i++) {
+            if (leader[i] && depths[i] == depth) {
+              if (scr_mkdir(dirs[i], mode_dir) != SCR_SUCCESS) {
+                success = 0;
+              }
+            }
+          }
+        }
+
+        /* wait for this round to finish before starting the next */
+        if (rounds > 1) {
+          MPI_Barrier(work_comm);
+        }
       }
+
+      MPI_Comm_free(&work_comm);
     }
 
-    /* free the dirname we strdup'd */
-    scr_free(&dir);
+    /* all directories at this level must exist before starting on
+     * the next, and there's no point in continuing if any failed */
+    if (! scr_alltrue(success == 1, comm)) {
+      success = 0;
+      break;
+    }
   }
 
   /* free buffers */
   scr_free(&group_id);
   scr_free(&group_ranks);
   scr_free(&group_rank);
-  scr_free(&dirs);
   scr_free(&leader);
+  scr_free(&depths);
+  scr_free(&dirs);
+  kvtree_delete(&dir_hash);
 
   /* determine whether all leaders successfully created their directories */
-  if (! scr_alltrue(success == 1, comm)) {
+  if (! success) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* given the dataset metadata directory and a container index,
+ * return newly allocated path to container file, caller must free */
+char* scr_flush_container_path(const char* dir, int ctr)
+{
+  spath* path = spath_from_str(dir);
+  spath_append_strf(path, "ctr.%d.scr", ctr);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+  return file;
+}
+
+/* assign each file in list a region within a set of container files,
+ * each container holds at most scr_container_size bytes, and each file
+ * starts at a multiple of scr_container_align bytes, files are packed
+ * in rank order, fills in layout with entries of the form:
+ *   FILE/<i>/SIZE
+ *   FILE/<i>/SEG/<j>/CTR,OFFSET,LENGTH
+ * for the j-th segment of the i-th file and returns number of
+ * containers in num_containers */
+int scr_flush_container_layout(
+  int num_files,
+  const char** src_filelist,
+  kvtree* layout,
+  int* num_containers,
+  MPI_Comm comm)
+{
+  /* get alignment and container size, round container size up to
+   * a multiple of the alignment so that no file starts on a boundary
+   * that is not aligned */
+  unsigned long align = scr_container_align;
+  if (align == 0) {
+    align = 1;
+  }
+  unsigned long ctr_size = ((scr_container_size + align - 1) / align) * align;
+  if (ctr_size == 0) {
+    ctr_size = align;
+  }
+
+  /* get size of each of our files, and total bytes we need
+   * once each file is padded out to the alignment */
+  int i;
+  unsigned long my_bytes = 0;
+  unsigned long* sizes = (unsigned long*) SCR_MALLOC(num_files * sizeof(unsigned long));
+  for (i = 0; i < num_files; i++) {
+    sizes[i] = scr_file_size(src_filelist[i]);
+    my_bytes += ((sizes[i] + align - 1) / align) * align;
+  }
+
+  /* compute offset to our first file in the logical concatenation
+   * of all containers, and the total number of bytes */
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  unsigned long offset = 0;
+  MPI_Exscan(&my_bytes, &offset, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+  if (rank == 0) {
+    offset = 0;
+  }
+  unsigned long total_bytes;
+  MPI_Allreduce(&my_bytes, &total_bytes, 1, MPI_UNSIGNED_LONG, MPI_SUM, comm);
+
+  /* split each file into segments at container boundaries */
+  for (i = 0; i < num_files; i++) {
+    kvtree* file_hash = kvtree_set_kv_int(layout, SCR_KEY_FILE, i);
+    kvtree_util_set_bytecount(file_hash, SCR_KEY_SIZE, sizes[i]);
+
+    int seg = 0;
+    unsigned long pos = offset;
+    unsigned long remaining = sizes[i];
+    while (remaining > 0) {
+      /* determine container and offset within it */
+      int ctr = (int) (pos / ctr_size);
+      unsigned long ctr_offset = pos % ctr_size;
+
+      /* write as much as we can until the end of this container */
+      unsigned long length = ctr_size - ctr_offset;
+      if (length > remaining) {
+        length = remaining;
+      }
+
+      /* record segment */
+      kvtree* seg_hash = kvtree_set_kv_int(file_hash, SCR_KEY_SEGMENT, seg);
+      kvtree_util_set_int(seg_hash, SCR_KEY_CONTAINER, ctr);
+      kvtree_util_set_bytecount(seg_hash, SCR_KEY_OFFSET, ctr_offset);
+      kvtree_util_set_bytecount(seg_hash, SCR_KEY_LENGTH, length);
+
+      pos       += length;
+      remaining -= length;
+      seg++;
+    }
+
+    /* advance to start of next file */
+    offset += ((sizes[i] + align - 1) / align) * align;
+  }
+
+  scr_free(&sizes);
+
+  *num_containers = (int) ((total_bytes + ctr_size - 1) / ctr_size);
+
+  return SCR_SUCCESS;
+}
+
+/* copy each file in list into its segments of the container files
+ * in dir as assigned in layout, limits the number of procs writing
+ * at once to width, returns SCR_SUCCESS on all procs if all succeeded */
+int scr_flush_container_write(
+  const char* dir,
+  int num_files,
+  const char** src_filelist,
+  const kvtree* layout,
+  int num_containers,
+  int width,
+  MPI_Comm comm)
+{
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* rank 0 creates the container files */
+  int success = 1;
+  if (rank == 0) {
+    mode_t mode_file = scr_getmode(1, 1, 0);
+    int ctr;
+    for (ctr = 0; ctr < num_containers; ctr++) {
+      char* ctr_file = scr_flush_container_path(dir, ctr);
+      int fd = scr_open(ctr_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+      if (fd < 0) {
+        scr_err("Failed to create container file %s @ %s:%d",
+          ctr_file, __FILE__, __LINE__
+        );
+        success = 0;
+      } else {
+        scr_close(ctr_file, fd);
+      }
+      scr_free(&ctr_file);
+    }
+  }
+  MPI_Bcast(&success, 1, MPI_INT, 0, comm);
+  if (! success) {
+    return SCR_FAILURE;
+  }
+
+  /* allocate buffer to copy data */
+  size_t bufsize = scr_file_buf_size;
+  char* buf = (char*) SCR_MALLOC(bufsize);
+
+  /* write in rounds, with width procs writing in each round */
+  if (width <= 0 || width > ranks) {
+    width = ranks;
+  }
+  int rounds = (ranks + width - 1) / width;
+  int round;
+  for (round = 0; round < rounds; round++) {
+    if (rank / width == round) {
+      int i;
+      for (i = 0; i < num_files && success; i++) {
+        const char* src_file = src_filelist[i];
+        kvtree* file_hash = kvtree_get_kv_int(layout, SCR_KEY_FILE, i);
+
+        /* open the source file */
+        int fd_src = scr_open(src_file, O_RDONLY);
+        if (fd_src < 0) {
+          scr_err("Opening file for reading: %s @ %s:%d",
+            src_file, __FILE__, __LINE__
+          );
+          success = 0;
+          break;
+        }
+
+        /* copy each segment in order into its container */
+        int seg = 0;
+        kvtree* seg_hash;
+        while (success && (seg_hash = kvtree_get_kv_int(file_hash, SCR_KEY_SEGMENT, seg)) != NULL) {
+          int ctr;
+          unsigned long offset, length;
+          kvtree_util_get_int(seg_hash, SCR_KEY_CONTAINER, &ctr);
+          kvtree_util_get_bytecount(seg_hash, SCR_KEY_OFFSET, &offset);
+          kvtree_util_get_bytecount(seg_hash, SCR_KEY_LENGTH, &length);
+
+          char* ctr_file = scr_flush_container_path(dir, ctr);
+          int fd_ctr = scr_open(ctr_file, O_WRONLY);
+          if (fd_ctr < 0 || scr_lseek(ctr_file, fd_ctr, (off_t) offset, SEEK_SET) != SCR_SUCCESS) {
+            scr_err("Failed to open container file %s at offset %lu @ %s:%d",
+              ctr_file, offset, __FILE__, __LINE__
+            );
+            success = 0;
+          }
+
+          /* copy bytes from file to container */
+          while (success && length > 0) {
+            size_t count = bufsize;
+            if (count > length) {
+              count = (size_t) length;
+            }
+            ssize_t nread = scr_read(src_file, fd_src, buf, count);
+            if (nread != (ssize_t) count) {
+              scr_err("Failed to read %lu bytes from %s @ %s:%d",
+                (unsigned long) count, src_file, __FILE__, __LINE__
+              );
+              success = 0;
+              break;
+            }
+            ssize_t nwrite = scr_write(ctr_file, fd_ctr, buf, count);
+            if (nwrite != (ssize_t) count) {
+              scr_err("Failed to write %lu bytes to %s @ %s:%d",
+                (unsigned long) count, ctr_file, __FILE__, __LINE__
+              );
+              success = 0;
+              break;
+            }
+            length -= count;
+          }
+
+          if (fd_ctr >= 0) {
+            if (scr_close(ctr_file, fd_ctr) != SCR_SUCCESS) {
+              success = 0;
+            }
+          }
+          scr_free(&ctr_file);
+          seg++;
+        }
+
+        scr_close(src_file, fd_src);
+      }
+    }
+
+    /* wait for this round to finish before starting the next */
+    MPI_Barrier(comm);
+  }
+
+  scr_free(&buf);
+
+  /* determine whether everyone wrote their files */
+  if (! scr_alltrue(success, comm)) {
     return SCR_FAILURE;
   }
   return SCR_SUCCESS;
@@ -225,6 +559,125 @@ char* scr_flush_dataset_metadir(const scr_dataset* dataset)
   return dir;
 }
 
+/* when SCR_FLUSH_COMPRESS names a codec, compress each file in the
+ * list into a staging file next to it in cache and record the path of
+ * the staging file under COMPRESS in the entry for the file, so that the
+ * compressed copy is transferred in place of the original */
+static int scr_flush_compress(const scr_cache_index* cindex, int id, kvtree* file_list)
+{
+  /* nothing to do unless compression is enabled */
+  if (scr_flush_compress_codec == NULL) {
+    return SCR_SUCCESS;
+  }
+
+  /* files of a bypass dataset are already in the prefix directory and
+   * are not transferred, and output datasets must appear there under
+   * their own names, so only compress checkpoints held in cache */
+  int bypass = 0;
+  scr_cache_index_get_bypass(cindex, id, &bypass);
+  scr_dataset* dataset = kvtree_get(file_list, SCR_KEY_DATASET);
+  if (bypass || scr_dataset_is_output(dataset)) {
+    return SCR_SUCCESS;
+  }
+
+  /* lookup the codec, all procs have the same setting */
+  const scr_codec* codec = scr_codec_lookup(scr_flush_compress_codec);
+  if (codec == NULL) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Unknown compression codec `%s' in SCR_FLUSH_COMPRESS @ %s:%d",
+        scr_flush_compress_codec, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
+  /* start timer */
+  time_t timestamp_start = scr_log_seconds();
+  double time_start = MPI_Wtime();
+
+  /* compress each file */
+  int rc = SCR_SUCCESS;
+  double counts[3] = {0.0, 0.0, 0.0};
+  kvtree* files = kvtree_get(file_list, SCR_KEY_FILE);
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(files);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    const char* file = kvtree_elem_key(elem);
+    kvtree* hash = kvtree_elem_hash(elem);
+
+    char* compressed = scr_strdupf("%s%s", file, SCR_COMPRESS_EXT);
+    unsigned long bytes;
+    if (scr_compress_file(file, compressed, codec, scr_compress_chunk, scr_compress_threads, &bytes) == SCR_SUCCESS) {
+      kvtree_util_set_str(hash, SCR_KEY_COMPRESS, compressed);
+      counts[0] += (double) scr_file_size(file);
+      counts[1] += (double) bytes;
+      counts[2] += 1.0;
+    } else {
+      scr_err("Failed to compress %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+    scr_free(&compressed);
+  }
+
+  /* mark the list so that we record that these files are compressed */
+  kvtree_util_set_str(file_list, SCR_KEY_COMPRESS, codec->name);
+
+  /* report compression ratio and throughput for the dataset */
+  double time_diff = MPI_Wtime() - time_start;
+  double total[3];
+  double max_time;
+  MPI_Reduce(counts, total, 3, MPI_DOUBLE, MPI_SUM, 0, scr_comm_world);
+  MPI_Reduce(&time_diff, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, scr_comm_world);
+  if (scr_my_rank_world == 0) {
+    double ratio = (total[1] > 0.0) ? total[0] / total[1] : 0.0;
+    double bw = (max_time > 0.0) ? total[0] / (1024.0 * 1024.0 * max_time) : 0.0;
+    scr_dbg(1, "scr_flush_compress: %f secs, %e bytes to %e bytes, ratio %f, %f MB/s with %s",
+      max_time, total[0], total[1], ratio, bw, codec->name
+    );
+
+    if (scr_log_enable) {
+      char* dir = NULL;
+      scr_cache_index_get_dir(cindex, id, &dir);
+
+      char* dset_name = NULL;
+      scr_dataset_get_name(dataset, &dset_name);
+
+      int total_files = (int) total[2];
+      scr_log_transfer("COMPRESS", dir, dir, &id, dset_name,
+        &timestamp_start, &max_time, &total[1], &total_files
+      );
+    }
+  }
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, scr_comm_world)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* delete any staging files created when compressing files in file_list */
+int scr_flush_compress_cleanup(kvtree* file_list)
+{
+  kvtree* files = kvtree_get(file_list, SCR_KEY_FILE);
+  kvtree_elem* elem;
+  for (elem = kvtree_elem_first(files);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    kvtree* hash = kvtree_elem_hash(elem);
+    char* compressed;
+    if (kvtree_util_get_str(hash, SCR_KEY_COMPRESS, &compressed) == KVTREE_SUCCESS) {
+      scr_file_unlink(compressed);
+      kvtree_unset(hash, SCR_KEY_COMPRESS);
+    }
+  }
+  return SCR_SUCCESS;
+}
+
 /* given a filemap and a dataset id, prepare and return a list of
  * files to be flushed */
 int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list)
@@ -300,6 +753,17 @@ int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list)
     rc = SCR_FAILURE;
   }
 
+  /* compress files if requested */
+  if (rc == SCR_SUCCESS && scr_flush_compress(cindex, id, file_list) != SCR_SUCCESS) {
+    if (scr_my_rank_world == 0) {
+      scr_err("Failed to compress files for dataset %d @ %s:%d",
+        id, __FILE__, __LINE__
+      );
+    }
+    scr_flush_compress_cleanup(file_list);
+    rc = SCR_FAILURE;
+  }
+
   return rc;
 }
 
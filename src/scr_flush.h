@@ -32,14 +32,45 @@ int scr_flush_list_free(
   char*** ptr_dst_filelist
 );
 
-/* create directories from basepath down to each file as needed */
+/* create directories from basepath down to each file as needed,
+ * each directory is created by a single process, parents before
+ * children, with at most width processes creating directories at once */
 int scr_flush_create_dirs(
   const char* basepath,       /* top-level directory, assumed to exist */
   int count,                  /* number of files */
   const char** dest_filelist, /* list of files */
+  int width,                  /* max number of procs to create directories at once */
   MPI_Comm comm               /* communicator of participating processes */
 );
 
+/* given the dataset metadata directory and a container index,
+ * return newly allocated path to container file, caller must free */
+char* scr_flush_container_path(const char* dir, int ctr);
+
+/* assign each file in list a region within a set of container files,
+ * fills in layout with FILE/<i>/SIZE and FILE/<i>/SEG/<j>/CTR,OFFSET,LENGTH
+ * for each file and returns number of containers in num_containers */
+int scr_flush_container_layout(
+  int num_files,
+  const char** src_filelist,
+  kvtree* layout,
+  int* num_containers,
+  MPI_Comm comm
+);
+
+/* copy each file in list into its segments of the container files
+ * in dir as assigned in layout, limits the number of procs writing
+ * at once to width, returns SCR_SUCCESS on all procs if all succeeded */
+int scr_flush_container_write(
+  const char* dir,
+  int num_files,
+  const char** src_filelist,
+  const kvtree* layout,
+  int num_containers,
+  int width,
+  MPI_Comm comm
+);
+
 /* given a dataset, return a newly allocated string specifying the
  * metadata directory for that dataset, must be freed by caller */
 char* scr_flush_dataset_metadir(const scr_dataset* dataset);
@@ -49,7 +80,12 @@ char* scr_flush_dataset_metadir(const scr_dataset* dataset);
  * it as incomplete */
 int scr_flush_init_index(scr_dataset* dataset);
 
-/* given a cache index and a dataset id, prepare and return a list of files to be flushed */
+/* delete any staging files created when compressing files in file_list */
+int scr_flush_compress_cleanup(kvtree* file_list);
+
+/* given a cache index and a dataset id, prepare and return a list of files to be flushed,
+ * if compression is enabled, this compresses each file into a staging file in cache,
+ * which the caller must delete with scr_flush_compress_cleanup when done */
 int scr_flush_prepare(const scr_cache_index* cindex, int id, kvtree* file_list);
 
 /* given a dataset id that has been flushed and the list provided by scr_flush_prepare,
@@ -16,27 +16,56 @@
 #include "kvtree_util.h"
 #include "axl_mpi.h"
 
-#define ASYNC_KEY_OUT_NAME "NAME"
-#define ASYNC_KEY_OUT_AXL  "AXL"
-
-/* records the time the async flush started */
-static time_t scr_flush_async_timestamp_start;
-
-/* records the time the async flush started from MPI_Wtime */
-static double scr_flush_async_time_start;
-
-/* tracks list of files written with flush */
-static kvtree* scr_flush_async_file_list = NULL;
+#define ASYNC_KEY_OUT_NAME       "NAME"
+#define ASYNC_KEY_OUT_AXL        "AXL"
+#define ASYNC_KEY_OUT_WIDTH      "WIDTH"
+#define ASYNC_KEY_OUT_NEXT       "NEXT"
+#define ASYNC_KEY_OUT_FINISHED   "FINISHED"
+#define ASYNC_KEY_OUT_DISPATCHED "DISPATCHED"
+#define ASYNC_KEY_OUT_DONE       "DONE"
+#define ASYNC_KEY_OUT_FAILED     "FAILED"
+#define ASYNC_KEY_OUT_BYTES      "BYTES"
+#define ASYNC_KEY_OUT_FILES      "FILES"
 
 /* tracks AXL id for outstanding transfer */
 static kvtree* scr_flush_async_axl_list = NULL;
 
-/* path to rankfile for ongoing flush */
-static char* scr_flush_async_rankfile = NULL;
-
-/* flag indicating whether we have detected failure
- * at any point in process of async flush */
-static int scr_flush_async_flushed = SCR_FAILURE;
+/* state for each asynchronous flush we have in flight */
+typedef struct {
+  int     id;              /* dataset id being flushed */
+  time_t  timestamp_start; /* records the time the async flush started */
+  double  time_start;      /* records the time the async flush started from MPI_Wtime */
+  kvtree* file_list;       /* tracks list of files written with flush */
+  char*   rankfile;        /* path to dataset directory holding rank2file map for ongoing flush */
+
+  /* flag indicating whether we have detected failure
+   * at any point in process of async flush */
+  int flushed;
+
+  /* tracks stats for the current flow control window on rank 0 */
+  int    window;
+  int    window_count;
+  int    window_files;
+  double window_bytes;
+  time_t window_timestamp;
+  double window_start;
+
+  /* tracks pacing of the flush on rank 0 to honor SCR_FLUSH_ASYNC_BW
+   * and SCR_FLUSH_ASYNC_PERCENT */
+  double* rank_bytes;       /* number of bytes each rank will transfer */
+  int*    rank_files;       /* number of files each rank will transfer */
+  int     busy_started;     /* number of ranks with files we let dispatch */
+  int     busy_finished;    /* number of ranks with files that finished */
+  double  dispatched_bytes; /* number of bytes dispatched so far */
+  double  finished_bytes;   /* number of bytes finished so far */
+  double  active_secs;      /* time during which some transfer was active */
+  double  last_test;        /* time of last throttle update */
+} scr_flush_async_state;
+
+/* queue of in flight flushes, oldest first, which we complete in order
+ * so that the current marker in the index always moves forward,
+ * scr_flush_async_in_progress records the number of entries */
+static scr_flush_async_state* scr_flush_async_queue = NULL;
 
 /*
 =========================================
@@ -44,16 +73,110 @@ Asynchronous flush functions
 =========================================
 */
 
+/* dispatch transfer on this process, records that we dispatched it,
+ * and whether the dispatch failed so scr_axl_test counts it as finished */
+static int scr_axl_dispatch(kvtree* name_hash, int id)
+{
+  int rc = SCR_SUCCESS;
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_DISPATCHED, 1);
+  if (AXL_Dispatch(id) != AXL_SUCCESS) {
+    scr_err("Failed to dispatch AXL transfer handle %d @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_FAILED, 1);
+    rc = SCR_FAILURE;
+  }
+  return rc;
+}
+
+/* called on rank 0 to compute the rank that follows the last rank we
+ * let dispatch, ranks with no files to transfer (e.g., all but the
+ * leaders when aggregating) don't take a slot in the window and are
+ * let through as we come to them, refills the window but only so far as
+ * to keep the aggregate rate at or below SCR_FLUSH_ASYNC_BW and the
+ * fraction of time with active transfers at or below
+ * SCR_FLUSH_ASYNC_PERCENT, since we only get to adjust things when
+ * the application calls us, the byte budget is extended by the time
+ * since the last update as an estimate of the time to the next one,
+ * if blocking is set, the application is waiting on the flush, so we
+ * only hold to the window and start everything else right away */
+static int scr_flush_async_throttle(scr_flush_async_state* st, int next, int width, int ranks, int blocking)
+{
+  /* get time since start and since our last update */
+  double now      = MPI_Wtime();
+  double elapsed  = now - st->time_start;
+  double interval = now - st->last_test;
+  st->last_test = now;
+
+  /* account for time with active transfers since last update */
+  int active = st->busy_started - st->busy_finished;
+  if (active > 0) {
+    st->active_secs += interval;
+  }
+
+  /* hold off on starting anything new if we're over our time limit,
+   * but always let the first process start */
+  if (! blocking && scr_flush_async_percent > 0.0 && st->busy_started > 0 &&
+      st->active_secs > elapsed * scr_flush_async_percent / 100.0)
+  {
+    return next;
+  }
+
+  /* compute number of bytes we may have started by the next update,
+   * the bandwidth limit is split evenly among flushes in flight */
+  double bw = scr_flush_async_bw / (double) scr_flush_async_in_progress;
+  if (blocking) {
+    bw = 0.0;
+  }
+  double budget = bw * (elapsed + interval);
+
+  /* start processes in order while we have room in the window and budget */
+  while (next < ranks) {
+    if (st->rank_files[next] == 0) {
+      next++;
+      continue;
+    }
+    double bytes = st->rank_bytes[next];
+    if (active >= width ||
+        (bw > 0.0 && st->busy_started > 0 &&
+         st->dispatched_bytes + bytes > budget))
+    {
+      break;
+    }
+    st->dispatched_bytes += bytes;
+    st->busy_started++;
+    active++;
+    next++;
+  }
+
+  return next;
+}
+
+/* creates an AXL transfer for the given files, only the first processes
+ * in comm allowed by the flow control window and throttle dispatch their
+ * transfer, remaining processes are started by scr_axl_test */
 static int scr_axl_start(
+  scr_flush_async_state* st,
   const char* name,
   int num_files,
   const char** src_filelist,
   const char** dst_filelist,
   axl_xfer_t xfer_type,
+  int width,
   MPI_Comm comm)
 {
   int rc = SCR_SUCCESS;
 
+  /* get our rank and number of ranks in comm */
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* no flow control if everyone fits in the window */
+  if (width <= 0 || width > ranks) {
+    width = ranks;
+  }
+
   /* define a transfer handle */
   int id = AXL_Create_comm(xfer_type, name, NULL, comm);
   if (id < 0) {
@@ -63,9 +186,19 @@ static int scr_axl_start(
     return SCR_FAILURE;
   }
 
-  /* create record for this transfer in outstanding list, and record AXL id */
+  /* create record for this transfer in outstanding list, and record AXL id,
+   * along with our progress through the flow control window */
   kvtree* name_hash = kvtree_set_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
   kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_AXL, id);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_WIDTH, width);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_NEXT, 0);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_FINISHED, 0);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_DISPATCHED, 0);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_DONE, 0);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_FAILED, 0);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_FILES, num_files);
+  double bytes = scr_axl_bytes(num_files, src_filelist);
+  kvtree_util_set_bytecount(name_hash, ASYNC_KEY_OUT_BYTES, (unsigned long) bytes);
 
   /* add files to transfer list */
   int i;
@@ -96,39 +229,165 @@ static int scr_axl_start(
     return SCR_FAILURE;
   }
 
-  /* kick off the transfer */
-  if (AXL_Dispatch_comm(id, comm) != AXL_SUCCESS) {
-    scr_err("Failed to dispatch AXL transfer handle %d @ %s:%d",
-      id, __FILE__, __LINE__
-    );
-    rc = SCR_FAILURE;
+  /* gather number of bytes and files each process will transfer
+   * to rank 0 for pacing */
+  if (rank == 0) {
+    st->rank_bytes = (double*) SCR_MALLOC(ranks * sizeof(double));
+    st->rank_files = (int*) SCR_MALLOC(ranks * sizeof(int));
+  }
+  MPI_Gather(&bytes, 1, MPI_DOUBLE, st->rank_bytes, 1, MPI_DOUBLE, 0, comm);
+  MPI_Gather(&num_files, 1, MPI_INT, st->rank_files, 1, MPI_INT, 0, comm);
+
+  /* start the first window of transfers */
+  int next = 0;
+  if (rank == 0) {
+    st->window           = 0;
+    st->window_count     = 0;
+    st->window_files     = 0;
+    st->window_bytes     = 0.0;
+    st->window_timestamp = scr_log_seconds();
+    st->window_start     = MPI_Wtime();
+
+    st->dispatched_bytes = 0.0;
+    st->finished_bytes   = 0.0;
+    st->active_secs      = 0.0;
+    st->last_test        = st->time_start;
+    st->busy_started     = 0;
+    st->busy_finished    = 0;
+
+    next = scr_flush_async_throttle(st, 0, width, ranks, 0);
+  }
+  MPI_Bcast(&next, 1, MPI_INT, 0, comm);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_NEXT, next);
+  if (rank < next) {
+    rc = scr_axl_dispatch(name_hash, id);
   }
 
   /* TODO: it would be nice to delete the AXL id from the list if the dispatch
    * fails, but dispatch does not currently clean up properly if some procs failed
    * to dispatch and others succeeded */
 
+  /* return same value on all ranks */
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    rc = SCR_FAILURE;
+  }
+
   return rc;
 }
 
-static int scr_axl_test(const char* name, MPI_Comm comm)
+/* tests whether all processes have finished their transfer, starts
+ * waiting processes to refill the flow control window as others
+ * finish, and logs window stats on rank 0, set blocking if the caller
+ * waits for the transfer to lift the throttle, returns SCR_SUCCESS
+ * if all transfers are done */
+static int scr_axl_test(scr_flush_async_state* st, const char* name, int blocking, MPI_Comm comm)
 {
-  int rc = SCR_FAILURE;
-
   /* lookup AXL id in outstanding list */
   int id;
   kvtree* name_hash = kvtree_get_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
-  if (kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_AXL, &id) == KVTREE_SUCCESS) {
-    /* test whether transfer is still active */
-    if (AXL_Test_comm(id, comm) == AXL_SUCCESS) {
-      rc = SCR_SUCCESS;
+  if (kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_AXL, &id) != KVTREE_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* get our rank and number of ranks in comm */
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* get our state and progress through the window */
+  int width, next, finished, dispatched, done, failed, files;
+  unsigned long bytes;
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_WIDTH, &width);
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_NEXT, &next);
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_FINISHED, &finished);
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_DISPATCHED, &dispatched);
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_DONE, &done);
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_FAILED, &failed);
+  kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_FILES, &files);
+  kvtree_util_get_bytecount(name_hash, ASYNC_KEY_OUT_BYTES, &bytes);
+
+  /* count processes that finished since we last checked,
+   * along with their bytes and files, and how many of them
+   * had files and so held a slot in the window */
+  double counts[4] = {0.0, 0.0, 0.0, 0.0};
+  if (dispatched && !done) {
+    if (failed || AXL_Test(id) == AXL_SUCCESS) {
+      counts[0] = 1.0;
+      counts[1] = (double) bytes;
+      counts[2] = (double) files;
+      counts[3] = (files > 0) ? 1.0 : 0.0;
+      kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_DONE, 1);
+    }
+  }
+  double totals[4];
+  MPI_Allreduce(counts, totals, 4, MPI_DOUBLE, MPI_SUM, comm);
+  int newly_finished = (int) totals[0];
+  finished += newly_finished;
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_FINISHED, finished);
+
+  /* track and log stats on current window */
+  if (rank == 0) {
+    st->busy_finished += (int) totals[3];
+    st->window_count  += (int) totals[3];
+    st->window_bytes += totals[1];
+    st->window_files += (int) totals[2];
+    if (st->window_count >= width ||
+        (finished == ranks && st->window_count > 0))
+    {
+      double window_end = MPI_Wtime();
+      double secs = window_end - st->window_start;
+      double bw = 0.0;
+      if (secs > 0.0) {
+        bw = st->window_bytes / (1024.0 * 1024.0 * secs);
+      }
+      scr_dbg(2, "FLUSH_ASYNC_WINDOW: window %d: %f secs, %e bytes, %f MB/s",
+        st->window, secs, st->window_bytes, bw
+      );
+      if (scr_log_enable) {
+        scr_log_transfer("FLUSH_ASYNC_WINDOW", NULL, scr_prefix, &st->id, name,
+          &st->window_timestamp, &secs, &st->window_bytes, &st->window_files
+        );
+      }
+
+      /* reset counters for the next window */
+      st->window++;
+      st->window_count     = 0;
+      st->window_files     = 0;
+      st->window_bytes     = 0.0;
+      st->window_timestamp = scr_log_seconds();
+      st->window_start     = window_end;
     }
   }
 
-  return rc;
+  /* refill the window with waiting processes as our throttle allows */
+  int start = next;
+  if (rank == 0) {
+    /* report rate we've achieved so far */
+    st->finished_bytes += totals[1];
+    double secs = MPI_Wtime() - st->time_start;
+    if (secs > 0.0) {
+      scr_dbg(2, "FLUSH_ASYNC: %d of %d procs finished, %f MB/s so far, limit %f MB/s",
+        finished, ranks, st->finished_bytes / (1024.0 * 1024.0 * secs),
+        scr_flush_async_bw / (1024.0 * 1024.0)
+      );
+    }
+
+    next = scr_flush_async_throttle(st, next, width, ranks, blocking);
+  }
+  MPI_Bcast(&next, 1, MPI_INT, 0, comm);
+  kvtree_util_set_int(name_hash, ASYNC_KEY_OUT_NEXT, next);
+  if (start <= rank && rank < next) {
+    scr_axl_dispatch(name_hash, id);
+  }
+
+  /* we're done once every process has finished */
+  if (finished == ranks) {
+    return SCR_SUCCESS;
+  }
+  return SCR_FAILURE;
 }
 
-static int scr_axl_wait(const char* name, MPI_Comm comm)
+static int scr_axl_wait(scr_flush_async_state* st, const char* name, MPI_Comm comm)
 {
   int rc = SCR_SUCCESS;
 
@@ -136,6 +395,13 @@ static int scr_axl_wait(const char* name, MPI_Comm comm)
   int id;
   kvtree* name_hash = kvtree_get_kv(scr_flush_async_axl_list, ASYNC_KEY_OUT_NAME, name);
   if (kvtree_util_get_int(name_hash, ASYNC_KEY_OUT_AXL, &id) == KVTREE_SUCCESS) {
+    /* some processes may still be waiting for their turn in the flow
+     * control window, keep refilling the window until all have finished,
+     * we no longer throttle since the application is blocked on us */
+    while (scr_axl_test(st, name, 1, comm) != SCR_SUCCESS) {
+      usleep(100*1000);
+    }
+
     /* test whether transfer is still active */
     if (AXL_Wait_comm(id, comm) != AXL_SUCCESS) {
       scr_err("Failed to wait on AXL transfer handle %d @ %s:%d",
@@ -162,6 +428,50 @@ static int scr_axl_wait(const char* name, MPI_Comm comm)
   return rc;
 }
 
+/* returns pointer to state for flush of given dataset id,
+ * or NULL if that dataset is not being flushed */
+static scr_flush_async_state* scr_flush_async_find(int id)
+{
+  int i;
+  for (i = 0; i < scr_flush_async_in_progress; i++) {
+    if (scr_flush_async_queue[i].id == id) {
+      return &scr_flush_async_queue[i];
+    }
+  }
+  return NULL;
+}
+
+/* free resources associated with a flush state */
+static void scr_flush_async_state_free(scr_flush_async_state* st)
+{
+  if (st->file_list != NULL) {
+    scr_flush_compress_cleanup(st->file_list);
+  }
+  kvtree_delete(&st->file_list);
+  scr_free(&st->rankfile);
+  scr_free(&st->rank_bytes);
+  scr_free(&st->rank_files);
+}
+
+/* remove the oldest flush from the queue */
+static void scr_flush_async_pop(void)
+{
+  scr_flush_async_state_free(&scr_flush_async_queue[0]);
+
+  /* shift remaining entries forward */
+  int i;
+  for (i = 1; i < scr_flush_async_in_progress; i++) {
+    scr_flush_async_queue[i - 1] = scr_flush_async_queue[i];
+  }
+  scr_flush_async_in_progress--;
+
+  /* track the id of the oldest flush still in the queue */
+  scr_flush_async_dataset_id = -1;
+  if (scr_flush_async_in_progress > 0) {
+    scr_flush_async_dataset_id = scr_flush_async_queue[0].id;
+  }
+}
+
 /* stop all ongoing asynchronous flush operations */
 int scr_flush_async_stop()
 {
@@ -181,14 +491,15 @@ int scr_flush_async_stop()
   }
 
   /* remove FLUSHING state from flush file */
-  scr_flush_async_in_progress = 0;
   /*
   scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
   */
 
   /* clear internal flush_async variables to indicate there is no flush */
-  kvtree_delete(&scr_flush_async_file_list);
-  scr_free(&scr_flush_async_rankfile);
+  while (scr_flush_async_in_progress > 0) {
+    scr_flush_async_pop();
+  }
+  kvtree_unset_all(scr_flush_async_axl_list);
 
   /* make sure all processes have made it this far before we leave */
   MPI_Barrier(scr_comm_world);
@@ -204,11 +515,24 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
     return SCR_FAILURE;
   }
 
+  /* if we're already flushing this dataset, there's nothing to do */
+  if (scr_flush_async_find(id) != NULL) {
+    return SCR_SUCCESS;
+  }
+
   /* if we don't need a flush, return right away with success */
   if (! scr_flush_file_need_flush(id)) {
     return SCR_SUCCESS;
   }
 
+  /* caller must complete an older flush before starting a new one if the queue is full */
+  if (scr_flush_async_in_progress >= scr_flush_async_depth) {
+    scr_err("scr_flush_async_start: Already have %d flushes in progress @ %s:%d",
+      scr_flush_async_in_progress, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
   /* get the dataset corresponding to this id */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(cindex, id, dataset);
@@ -225,43 +549,50 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
   /* make sure all processes make it this far before progressing */
   MPI_Barrier(scr_comm_world);
 
+  /* add an entry for this flush to the end of the queue */
+  scr_flush_async_state* st = &scr_flush_async_queue[scr_flush_async_in_progress];
+  memset(st, 0, sizeof(scr_flush_async_state));
+  st->id = id;
+
   /* start timer */
   if (scr_my_rank_world == 0) {
-    scr_flush_async_timestamp_start = scr_log_seconds();
-    scr_flush_async_time_start = MPI_Wtime();
+    st->timestamp_start = scr_log_seconds();
+    st->time_start = MPI_Wtime();
 
     /* log the start of the flush */
     if (scr_log_enable) {
       scr_log_event("ASYNC_FLUSH_START", NULL, &id, dset_name,
-                    &scr_flush_async_timestamp_start, NULL);
+                    &st->timestamp_start, NULL);
     }
   }
 
   /* mark that we've started a flush */
-  scr_flush_async_in_progress = 1;
-  scr_flush_async_dataset_id = id;
+  if (scr_flush_async_in_progress == 0) {
+    scr_flush_async_dataset_id = id;
+  }
+  scr_flush_async_in_progress++;
   scr_flush_file_location_set(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
 
   /* this flag will remember whether any stage fails */
-  scr_flush_async_flushed = SCR_SUCCESS;
+  st->flushed = SCR_SUCCESS;
 
   /* get list of files to flush */
-  scr_flush_async_file_list = kvtree_new();
-  if (scr_flush_prepare(cindex, id, scr_flush_async_file_list) != SCR_SUCCESS) {
+  st->file_list = kvtree_new();
+  if (scr_flush_prepare(cindex, id, st->file_list) != SCR_SUCCESS) {
     if (scr_my_rank_world == 0) {
       scr_err("scr_flush_async_start: Failed to prepare flush @ %s:%d",
         __FILE__, __LINE__
       );
       if (scr_log_enable) {
         double time_end = MPI_Wtime();
-        double time_diff = time_end - scr_flush_async_time_start;
+        double time_diff = time_end - st->time_start;
         scr_log_event("ASYNC_FLUSH_FAIL", "Failed to prepare flush",
                       &id, dset_name, NULL, &time_diff);
       }
     }
     scr_dataset_delete(&dataset);
-    kvtree_delete(&scr_flush_async_file_list);
-    scr_flush_async_flushed = SCR_FAILURE;
+    kvtree_delete(&st->file_list);
+    st->flushed = SCR_FAILURE;
     return SCR_FAILURE;
   }
 
@@ -269,7 +600,7 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
   int numfiles;
   char** src_filelist;
   char** dst_filelist;
-  scr_flush_list_alloc(scr_flush_async_file_list, &numfiles, &src_filelist, &dst_filelist);
+  scr_flush_list_alloc(st->file_list, &numfiles, &src_filelist, &dst_filelist);
 
   /* create entry in index file to indicate that dataset may exist,
    * but is not yet complete */
@@ -294,14 +625,15 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
   }
   MPI_Barrier(scr_comm_world);
 
-  /* define path for rank2file map */
-  spath_append_str(dataset_path, "rank2file");
-  scr_flush_async_rankfile = spath_strdup(dataset_path);
+  /* remember dataset directory to hold rank2file map */
+  st->rankfile = spath_strdup(dataset_path);
   spath_delete(&dataset_path);
 
   /* build a list of files for this rank */
   int i;
+  int compressed = (kvtree_get(st->file_list, SCR_KEY_COMPRESS) != NULL);
   kvtree* filelist = kvtree_new();
+  kvtree_elem* file_elem = kvtree_elem_first(kvtree_get(st->file_list, SCR_KEY_FILE));
   for (i = 0; i < numfiles; i++) {
     /* get path to destination file */
     const char* filename = dst_filelist[i];
@@ -312,7 +644,21 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
     spath* rel = spath_relative(base, dest);
     char* relfile = spath_strdup(rel);
 
-    kvtree_set_kv(filelist, "FILE", relfile);
+    kvtree* file_hash = kvtree_set_kv(filelist, "FILE", relfile);
+
+    /* record that this file was compressed */
+    if (compressed) {
+      kvtree_util_set_int(file_hash, SCR_KEY_COMPRESS, 1);
+    }
+
+    /* record the order in which the application routed this file,
+     * file list entries are in the same order as dst_filelist */
+    scr_meta* meta = kvtree_get(kvtree_elem_hash(file_elem), SCR_KEY_META);
+    int order;
+    if (scr_meta_get_order(meta, &order) == SCR_SUCCESS) {
+      kvtree_util_set_int(file_hash, SCR_KEY_ORDER, order);
+    }
+    file_elem = kvtree_elem_next(file_elem);
 
     scr_free(&relfile);
     spath_delete(&rel);
@@ -321,28 +667,46 @@ int scr_flush_async_start(scr_cache_index* cindex, int id)
   }
 
   /* save our file list to disk */
-  kvtree_write_gather(scr_flush_async_rankfile, filelist, scr_comm_world);
+  if (scr_rank2file_write(st->rankfile, filelist, scr_rank2file_stripes, scr_comm_world) != SCR_SUCCESS) {
+    st->flushed = SCR_FAILURE;
+  }
   kvtree_delete(&filelist);
 
   /* create directories */
-  scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_comm_world);
+  scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_flush_width, scr_comm_world);
 
   /* get AXL transfer type to use */
   const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
   axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
 
-  /* TODO: gather list of files to leader of store descriptor,
-   * use communicator of leaders for AXL, then bcast result back */
+  /* when aggregating, the leader of the store descriptor transfers the files
+   * for all procs that share its cache, and all other procs transfer nothing,
+   * since test and wait reduce results over all procs, everyone still learns
+   * whether the flush succeeded, and procs with no files don't count against
+   * the flush width, so the window only spans the leaders */
+  int xfer_numfiles = numfiles;
+  char** xfer_src_filelist = src_filelist;
+  char** xfer_dst_filelist = dst_filelist;
+  if (scr_flush_aggregate) {
+    scr_filelist_gather(numfiles, (const char**) src_filelist, (const char**) dst_filelist,
+      &xfer_numfiles, &xfer_src_filelist, &xfer_dst_filelist, storedesc->comm
+    );
+  }
 
   /* start writing files via AXL */
   int rc = SCR_SUCCESS;
-  if (scr_axl_start(dset_name, numfiles, (const char**) src_filelist, (const char**) dst_filelist,
-    xfer_type, scr_comm_world) != SCR_SUCCESS)
+  if (scr_axl_start(st, dset_name, xfer_numfiles, (const char**) xfer_src_filelist, (const char**) xfer_dst_filelist,
+    xfer_type, scr_flush_width, scr_comm_world) != SCR_SUCCESS)
   {
     /* failed to initiate AXL transfer */
     /* TODO: auto delete files? */
     rc = SCR_FAILURE;
-    scr_flush_async_flushed = SCR_FAILURE;
+    st->flushed = SCR_FAILURE;
+  }
+
+  /* free the aggregated file list */
+  if (scr_flush_aggregate) {
+    scr_filelist_free(xfer_numfiles, &xfer_src_filelist, &xfer_dst_filelist);
   }
 
   /* free our file list */
@@ -364,8 +728,17 @@ int scr_flush_async_test(scr_cache_index* cindex, int id)
     return SCR_FAILURE;
   }
 
+  /* lookup the state of this flush */
+  scr_flush_async_state* st = scr_flush_async_find(id);
+  if (st == NULL) {
+    scr_err("scr_flush_async_test: Dataset %d is not being flushed @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
   /* if the transfer failed, indicate that transfer has completed */
-  if (scr_flush_async_flushed != SCR_SUCCESS) {
+  if (st->flushed != SCR_SUCCESS) {
     return SCR_SUCCESS;
   }
 
@@ -379,7 +752,7 @@ int scr_flush_async_test(scr_cache_index* cindex, int id)
 
   /* test whether transfer is done */
   int rc = SCR_SUCCESS;
-  if (scr_axl_test(dset_name, scr_comm_world) != SCR_SUCCESS) {
+  if (scr_axl_test(st, dset_name, 0, scr_comm_world) != SCR_SUCCESS) {
     rc = SCR_FAILURE;
   }
 
@@ -397,6 +770,15 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
     return SCR_FAILURE;
   }
 
+  /* flushes must be completed in the order they were started */
+  if (scr_flush_async_in_progress == 0 || scr_flush_async_queue[0].id != id) {
+    scr_err("scr_flush_async_complete: Dataset %d is not the oldest flush in progress @ %s:%d",
+      id, __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+  scr_flush_async_state* st = &scr_flush_async_queue[0];
+
   /* get the dataset corresponding to this id */
   scr_dataset* dataset = scr_dataset_new();
   scr_cache_index_get_dataset(cindex, id, dataset);
@@ -411,24 +793,27 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
 
   /* TODO: wait on Filo if we failed to start? */
   /* wait for transfer to complete */
-  if (scr_axl_wait(dset_name, scr_comm_world) != SCR_SUCCESS) {
-    scr_flush_async_flushed = SCR_FAILURE;
+  if (scr_axl_wait(st, dset_name, scr_comm_world) != SCR_SUCCESS) {
+    st->flushed = SCR_FAILURE;
   }
 
   /* write summary file */
-  if (scr_flush_async_flushed == SCR_SUCCESS &&
-      scr_flush_complete(cindex, id, scr_flush_async_file_list) != SCR_SUCCESS)
+  if (st->flushed == SCR_SUCCESS &&
+      scr_flush_complete(cindex, id, st->file_list) != SCR_SUCCESS)
   {
-    scr_flush_async_flushed = SCR_FAILURE;
+    st->flushed = SCR_FAILURE;
   }
 
   /* mark that we've stopped the flush */
-  scr_flush_async_in_progress = 0;
   scr_flush_file_location_unset(id, SCR_FLUSH_KEY_LOCATION_FLUSHING);
 
-  /* free the file list for this checkpoint */
-  kvtree_delete(&scr_flush_async_file_list);
-  scr_free(&scr_flush_async_rankfile);
+  /* record values we need for logging before we drop this entry from the queue */
+  int flushed = st->flushed;
+  time_t timestamp_start = st->timestamp_start;
+  double time_start = st->time_start;
+
+  /* remove this flush from the queue, which frees its file list */
+  scr_flush_async_pop();
 
   /* stop timer, compute bandwidth, and report performance */
   if (scr_my_rank_world == 0) {
@@ -444,7 +829,7 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
     }
 
     /* get the number of files in the dataset */
-    int total_files = 0.0;
+    int total_files = 0;
     scr_dataset_get_files(dataset, &total_files);
 
     /* delete the dataset object */
@@ -452,17 +837,17 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
 
     /* stop timer and compute bandwidth */
     double time_end = MPI_Wtime();
-    double time_diff = time_end - scr_flush_async_time_start;
+    double time_diff = time_end - time_start;
     double bw = 0.0;
     if (time_diff > 0.0) {
-      bw = scr_flush_async_bytes / (1024.0 * 1024.0 * time_diff);
+      bw = total_bytes / (1024.0 * 1024.0 * time_diff);
     }
     scr_dbg(1, "scr_flush_async_complete: %f secs, %e bytes, %f MB/s, %f MB/s per proc",
-      time_diff, scr_flush_async_bytes, bw, bw/scr_ranks_world
+      time_diff, total_bytes, bw, bw/scr_ranks_world
     );
 
     /* log messages about flush */
-    if (scr_flush_async_flushed == SCR_SUCCESS) {
+    if (flushed == SCR_SUCCESS) {
       /* the flush worked, print a debug message */
       scr_dbg(1, "scr_flush_async_complete: Flush of dataset succeeded %d `%s'", id, dset_name);
 
@@ -485,7 +870,7 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
       char* dir = NULL;
       scr_cache_index_get_dir(cindex, id, &dir);
       scr_log_transfer("FLUSH_ASYNC", dir, scr_prefix, &id, dset_name,
-        &scr_flush_async_timestamp_start, &time_diff, &total_bytes, &total_files
+        &timestamp_start, &time_diff, &total_bytes, &total_files
       );
     }
   }
@@ -493,18 +878,19 @@ int scr_flush_async_complete(scr_cache_index* cindex, int id)
   /* free the dataset */
   scr_dataset_delete(&dataset);
 
-  return scr_flush_async_flushed;
+  return flushed;
 }
 
-/* wait until the checkpoint currently being flushed completes */
-int scr_flush_async_wait(scr_cache_index* cindex)
+/* wait until the oldest dataset being flushed completes */
+int scr_flush_async_wait_oldest(scr_cache_index* cindex)
 {
   if (scr_flush_async_in_progress) {
-    while (scr_flush_file_is_flushing(scr_flush_async_dataset_id)) {
+    int id = scr_flush_async_queue[0].id;
+    while (scr_flush_file_is_flushing(id)) {
       /* test whether the flush has completed, and if so complete the flush */
-      if (scr_flush_async_test(cindex, scr_flush_async_dataset_id) == SCR_SUCCESS) {
+      if (scr_flush_async_test(cindex, id) == SCR_SUCCESS) {
         /* complete the flush */
-        scr_flush_async_complete(cindex, scr_flush_async_dataset_id);
+        scr_flush_async_complete(cindex, id);
       } else {
         /* otherwise, sleep to get out of the way */
         usleep(10*1000*1000);
@@ -514,6 +900,15 @@ int scr_flush_async_wait(scr_cache_index* cindex)
   return SCR_SUCCESS;
 }
 
+/* wait until all datasets currently being flushed complete */
+int scr_flush_async_wait(scr_cache_index* cindex)
+{
+  while (scr_flush_async_in_progress) {
+    scr_flush_async_wait_oldest(cindex);
+  }
+  return SCR_SUCCESS;
+}
+
 /* start any processes for later asynchronous flush operations */
 int scr_flush_async_init()
 {
@@ -524,6 +919,16 @@ int scr_flush_async_init()
 
   scr_flush_async_axl_list = kvtree_new();
 
+  /* allocate space to track each flush we allow to be in flight */
+  if (scr_flush_async_depth < 1) {
+    scr_flush_async_depth = 1;
+  }
+  scr_flush_async_queue = (scr_flush_async_state*) SCR_MALLOC(
+    scr_flush_async_depth * sizeof(scr_flush_async_state)
+  );
+  scr_flush_async_in_progress = 0;
+  scr_flush_async_dataset_id  = -1;
+
   return SCR_SUCCESS;
 }
 
@@ -535,6 +940,12 @@ int scr_flush_async_finalize()
     return SCR_FAILURE;
   }
 
+  /* release any entries left in the queue */
+  while (scr_flush_async_in_progress > 0) {
+    scr_flush_async_pop();
+  }
+  scr_free(&scr_flush_async_queue);
+
   kvtree_delete(&scr_flush_async_axl_list);
 
   return SCR_SUCCESS;
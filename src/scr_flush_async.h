@@ -26,7 +26,10 @@ int scr_flush_async_test(scr_cache_index* cindex, int id);
 /* complete the flush from cache to parallel file system */
 int scr_flush_async_complete(scr_cache_index* cindex, int id);
 
-/* wait until the checkpoint currently being flushed completes */
+/* wait until the oldest dataset being flushed completes */
+int scr_flush_async_wait_oldest(scr_cache_index* cindex);
+
+/* wait until all datasets currently being flushed complete */
 int scr_flush_async_wait(scr_cache_index* cindex);
 
 /* initialize the async transfer processes */
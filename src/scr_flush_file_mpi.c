@@ -20,16 +20,101 @@ Flush file functions
 =========================================
 */
 
+/* Rank 0 keeps the contents of the flush file in memory and updates the
+ * file whenever a dataset enters or leaves the cache, reaches the
+ * parallel file system, or starts to be flushed.  Removing the marker of
+ * an asynchronous flush is written behind with the next update, since a
+ * stale marker is cleared when the cache is rebuilt on restart.  The
+ * marker of a synchronous flush is always written right away, since the
+ * watchdog reads it to pick its timeout. */
+
+/* in-memory copy of the flush file, NULL until first accessed */
+static kvtree* scr_flush_file_hash = NULL;
+
+/* whether the in-memory copy has changes not yet written to the file */
+static int scr_flush_file_dirty = 0;
+
+/* returns the in-memory copy of the flush file, reading it on first use,
+ * only called on rank 0 */
+kvtree* scr_flush_file_get_table(void)
+{
+  if (scr_flush_file_hash == NULL) {
+    scr_flush_file_hash = kvtree_new();
+    kvtree_read_path(scr_flush_file, scr_flush_file_hash);
+    scr_flush_file_dirty = 0;
+  }
+  return scr_flush_file_hash;
+}
+
+/* write in-memory copy of the flush file to a temporary file and
+ * rename it over the flush file, so that a reader never sees a
+ * partially written file, only called on rank 0 */
+int scr_flush_file_write(void)
+{
+  kvtree* hash = scr_flush_file_get_table();
+
+  char* file = spath_strdup(scr_flush_file);
+  char tmpfile[SCR_MAX_FILENAME];
+  snprintf(tmpfile, sizeof(tmpfile), "%s.tmp", file);
+
+  int rc = SCR_SUCCESS;
+  if (kvtree_write_file(tmpfile, hash) != KVTREE_SUCCESS) {
+    scr_err("Writing flush file %s @ %s:%d",
+      tmpfile, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  } else if (rename(tmpfile, file) != 0) {
+    scr_err("Renaming %s to %s: errno=%d %s @ %s:%d",
+      tmpfile, file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    unlink(tmpfile);
+    rc = SCR_FAILURE;
+  }
+
+  if (rc == SCR_SUCCESS) {
+    scr_flush_file_dirty = 0;
+  }
+
+  scr_free(&file);
+  return rc;
+}
+
+/* write any pending changes to the flush file */
+int scr_flush_file_persist(void)
+{
+  int rc = SCR_SUCCESS;
+  if (scr_my_rank_world == 0 && scr_flush_file_dirty) {
+    rc = scr_flush_file_write();
+  }
+  return rc;
+}
+
+/* write any pending changes and free the in-memory copy */
+int scr_flush_file_free(void)
+{
+  int rc = scr_flush_file_persist();
+  kvtree_delete(&scr_flush_file_hash);
+  scr_flush_file_dirty = 0;
+  return rc;
+}
+
+/* returns 1 if the given location only marks an asynchronous flush
+ * in progress, this marker is cleared on restart, so removing it need
+ * not be written to the file right away, the watchdog checks for
+ * SYNC_FLUSHING, so that one must always be written through */
+static int scr_flush_file_location_transient(const char* location)
+{
+  return (strcmp(location, SCR_FLUSH_KEY_LOCATION_FLUSHING) == 0);
+}
+
 /* returns true if the given dataset id needs to be flushed */
 int scr_flush_file_need_flush(int id)
 {
   int need_flush = 0;
 
-  /* just have rank 0 read the file */
+  /* just have rank 0 check the table */
   if (scr_my_rank_world == 0) {
-    /* read the flush file */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
     /* if we have the dataset in cache, but not on the parallel file system,
      * then it needs to be flushed */
@@ -39,9 +124,6 @@ int scr_flush_file_need_flush(int id)
     if (in_cache != NULL && in_pfs == NULL) {
       need_flush = 1;
     }
-
-    /* free the hash object */
-    kvtree_delete(&hash);
   }
 
   /* broadcast decision from rank 0 */
@@ -56,11 +138,9 @@ int scr_flush_file_is_flushing(int id)
   /* assume we are not flushing this checkpoint */
   int is_flushing = 0;
 
-  /* only rank 0 tests the file */
+  /* only rank 0 tests the table */
   if (scr_my_rank_world == 0) {
-    /* read flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
     /* attempt to look up the FLUSHING state for this checkpoint */
     kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
@@ -68,9 +148,6 @@ int scr_flush_file_is_flushing(int id)
     if (flushing_hash != NULL) {
       is_flushing = 1;
     }
-
-    /* delete the hash */
-    kvtree_delete(&hash);
   }
 
   /* broadcast decision from rank 0 */
@@ -84,18 +161,13 @@ int scr_flush_file_dataset_remove(int id)
 {
   /* only rank 0 needs to write the file */
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
     /* delete this dataset id from the flush file */
-    kvtree_unset_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    if (kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id) != NULL) {
+      kvtree_unset_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
+      scr_flush_file_write();
+    }
   }
   return SCR_SUCCESS;
 }
@@ -105,19 +177,15 @@ int scr_flush_file_location_set(int id, const char* location)
 {
   /* only rank 0 updates the file */
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
-    /* set the location for this dataset */
+    /* set the location for this dataset, only write the file if
+     * this is a new location */
     kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree_set_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    if (kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location) == NULL) {
+      kvtree_set_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
+      scr_flush_file_write();
+    }
   }
   return SCR_SUCCESS;
 }
@@ -128,9 +196,7 @@ int scr_flush_file_location_test(int id, const char* location)
   /* only rank 0 checks the status, bcasts the results to everyone else */
   int at_location = 0;
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
     /* check the location for this dataset */
     kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
@@ -138,9 +204,6 @@ int scr_flush_file_location_test(int id, const char* location)
     if (value != NULL) {
       at_location = 1;
     }
-
-    /* delete the hash */
-    kvtree_delete(&hash);
   }
   MPI_Bcast(&at_location, 1, MPI_INT, 0, scr_comm_world);
 
@@ -155,19 +218,20 @@ int scr_flush_file_location_unset(int id, const char* location)
 {
   /* only rank 0 updates the file */
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
     /* unset the location for this dataset */
     kvtree* dset_hash = kvtree_get_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
-    kvtree_unset_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
-
-    /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    if (kvtree_get_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location) != NULL) {
+      kvtree_unset_kv(dset_hash, SCR_FLUSH_KEY_LOCATION, location);
+
+      /* write behind if we only removed an async flushing marker */
+      if (scr_flush_file_location_transient(location)) {
+        scr_flush_file_dirty = 1;
+      } else {
+        scr_flush_file_write();
+      }
+    }
   }
   return SCR_SUCCESS;
 }
@@ -178,9 +242,7 @@ int scr_flush_file_new_entry(int id, const char* name, const scr_dataset* datase
 {
   /* only rank 0 updates the file */
   if (scr_my_rank_world == 0) {
-    /* read the flush file into hash */
-    kvtree* hash = kvtree_new();
-    kvtree_read_path(scr_flush_file, hash);
+    kvtree* hash = scr_flush_file_get_table();
 
     /* set the name, location, and flags for this dataset */
     kvtree* dset_hash = kvtree_set_kv_int(hash, SCR_FLUSH_KEY_DATASET, id);
@@ -200,11 +262,7 @@ int scr_flush_file_new_entry(int id, const char* name, const scr_dataset* datase
     kvtree_set(dset_hash, SCR_FLUSH_KEY_DSETDESC, dataset_copy);
 
     /* write the hash back to the flush file */
-    kvtree_write_path(scr_flush_file, hash);
-
-    /* delete the hash */
-    kvtree_delete(&hash);
+    scr_flush_file_write();
   }
   return SCR_SUCCESS;
 }
-
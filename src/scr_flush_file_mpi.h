@@ -12,6 +12,19 @@
 #ifndef SCR_FLUSH_FILE_MPI_H
 #define SCR_FLUSH_FILE_MPI_H
 
+/* returns the in-memory copy of the flush file, reading it on first use,
+ * only called on rank 0 */
+kvtree* scr_flush_file_get_table(void);
+
+/* write in-memory copy of the flush file, only called on rank 0 */
+int scr_flush_file_write(void);
+
+/* write any pending changes to the flush file */
+int scr_flush_file_persist(void);
+
+/* write any pending changes and free the in-memory copy */
+int scr_flush_file_free(void);
+
 /* returns true if the given dataset id needs to be flushed */
 int scr_flush_file_need_flush(int id);
 
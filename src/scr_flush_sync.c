@@ -59,32 +59,64 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
   }
   MPI_Barrier(scr_comm_world);
 
-  /* define path for rank2file map */
-  spath_append_str(dataset_path, "rank2file");
-  const char* rank2file = spath_strdup(dataset_path);
+  /* remember dataset directory to hold rank2file map and container files */
+  char* dataset_dir = spath_strdup(dataset_path);
 
   /* we can skip transfer if all paths match */
+  int i;
   int skip_transfer = 1;
+  for (i = 0; i < numfiles; i++) {
+    /* found a source and destination path that are different */
+    if (strcmp(src_filelist[i], dst_filelist[i]) != 0) {
+      skip_transfer = 0;
+    }
+  }
+  skip_transfer = scr_alltrue(skip_transfer, scr_comm_world);
+
+  /* if packing files into containers, assign each file its location,
+   * output datasets are written under their own names so that users
+   * can read them from the prefix directory */
+  int use_containers = (scr_use_containers && ! skip_transfer && ! scr_dataset_is_output(dataset));
+  int num_containers = 0;
+  kvtree* layout = kvtree_new();
+  if (use_containers) {
+    scr_flush_container_layout(numfiles, (const char**) src_filelist, layout, &num_containers, scr_comm_world);
+  }
 
   /* build a list of files for this rank */
-  int i;
+  int compressed = (kvtree_get(file_list, SCR_KEY_COMPRESS) != NULL);
   kvtree* filelist = kvtree_new();
+  kvtree_elem* file_elem = kvtree_elem_first(kvtree_get(file_list, SCR_KEY_FILE));
   for (i = 0; i < numfiles; i++) {
     /* get path to destination file */
     const char* filename = dst_filelist[i];
 
-    /* found a source and destination path that are different */
-    if (strcmp(src_filelist[i], filename) != 0) {
-      skip_transfer = 0;
-    }
-
     /* compute path relative to prefix directory */
     spath* base = spath_from_str(scr_prefix);
     spath* dest = spath_from_str(filename);
     spath* rel = spath_relative(base, dest);
     char* relfile = spath_strdup(rel);
 
-    kvtree_set_kv(filelist, "FILE", relfile);
+    kvtree* file_hash = kvtree_set_kv(filelist, "FILE", relfile);
+
+    /* record that this file was compressed */
+    if (compressed) {
+      kvtree_util_set_int(file_hash, SCR_KEY_COMPRESS, 1);
+    }
+
+    /* record the order in which the application routed this file,
+     * file list entries are in the same order as dst_filelist */
+    scr_meta* meta = kvtree_get(kvtree_elem_hash(file_elem), SCR_KEY_META);
+    int order;
+    if (scr_meta_get_order(meta, &order) == SCR_SUCCESS) {
+      kvtree_util_set_int(file_hash, SCR_KEY_ORDER, order);
+    }
+    file_elem = kvtree_elem_next(file_elem);
+
+    /* record where this file is stored within the containers */
+    if (use_containers) {
+      kvtree_merge(file_hash, kvtree_get_kv_int(layout, SCR_KEY_FILE, i));
+    }
 
     scr_free(&relfile);
     spath_delete(&rel);
@@ -93,14 +125,24 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
   }
 
   /* save our file list to disk */
-  kvtree_write_gather(rank2file, filelist, scr_comm_world);
+  int success = 1;
+  if (scr_rank2file_write(dataset_dir, filelist, scr_rank2file_stripes, scr_comm_world) != SCR_SUCCESS) {
+    success = 0;
+  }
   kvtree_delete(&filelist);
 
   /* after writing out file above, see if we can skip the transfer */
-  int success = 1;
-  if (! scr_alltrue(skip_transfer, scr_comm_world)) {
+  if (use_containers) {
+    /* pack files into container files in the dataset directory,
+     * limiting the number of writers to the flush width */
+    if (scr_flush_container_write(dataset_dir, numfiles, (const char**) src_filelist,
+      layout, num_containers, scr_flush_width, scr_comm_world) != SCR_SUCCESS)
+    {
+      success = 0;
+    }
+  } else if (! skip_transfer) {
     /* create directories */
-    scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_comm_world);
+    scr_flush_create_dirs(scr_prefix, numfiles, (const char**) dst_filelist, scr_flush_width, scr_comm_world);
 
     /* get name of dataset */
     char* dset_name = NULL;
@@ -110,12 +152,26 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
     const scr_storedesc* storedesc = scr_cache_get_storedesc(cindex, id);
     axl_xfer_t xfer_type = scr_xfer_str_to_axl_type(storedesc->xfer);
 
-    /* TODO: gather list of files to leader of store descriptor,
-     * use communicator of leaders for AXL, then bcast result back */
-
-    /* write files (via AXL) */
-    if (scr_axl(dset_name, numfiles, (const char**) src_filelist, (const char **) dst_filelist, xfer_type, scr_comm_world) != SCR_SUCCESS) {
-      success = 0;
+    /* get cache directory for logging */
+    char* dir = NULL;
+    scr_cache_index_get_dir(cindex, id, &dir);
+
+    if (scr_flush_aggregate) {
+      /* have the leader of the store descriptor write files for all procs
+       * that share its cache, limiting the number of leaders to the flush width */
+      if (scr_axl_aggregate(dset_name, numfiles, (const char**) src_filelist, (const char**) dst_filelist,
+        xfer_type, scr_flush_width, "FLUSH_SYNC_WINDOW", dir, scr_prefix, &id,
+        storedesc->comm, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
+    } else {
+      /* write files (via AXL), limiting the number of writers to the flush width */
+      if (scr_axl_window(dset_name, numfiles, (const char**) src_filelist, (const char **) dst_filelist,
+        xfer_type, scr_flush_width, "FLUSH_SYNC_WINDOW", dir, scr_prefix, &id, scr_comm_world) != SCR_SUCCESS)
+      {
+        success = 0;
+      }
     }
   } else {
     /* just stat the file to check that it exists */
@@ -129,7 +185,8 @@ static int scr_flush_sync_data(scr_cache_index* cindex, int id, kvtree* file_lis
   }
 
   /* free path and file name */
-  scr_free(&rank2file);
+  kvtree_delete(&layout);
+  scr_free(&dataset_dir);
   spath_delete(&dataset_path);
 
   /* free our file list */
@@ -232,6 +289,7 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
   }
 
   /* free data structures */
+  scr_flush_compress_cleanup(file_list);
   kvtree_delete(&file_list);
 
   /* remove sync flushing marker from flush file */
@@ -266,6 +324,11 @@ int scr_flush_sync(scr_cache_index* cindex, int id)
       /* the flush worked, print a debug message */
       scr_dbg(1, "scr_flush_sync: Flush of dataset succeeded %d `%s'", id, dset_name);
 
+      /* the time to flush a checkpoint counts toward its cost */
+      if (scr_dataset_is_ckpt(dataset)) {
+        scr_ckpt_model_flush(time_diff);
+      }
+
       /* log details of flush */
       if (scr_log_enable) {
         scr_log_event("FLUSH_SUCCESS", NULL, &id, dset_name, NULL, &time_diff);
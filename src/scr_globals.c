@@ -118,13 +118,22 @@ int scr_halt_exit        = SCR_HALT_EXIT;    /* whether SCR will call exit if ha
 
 int   scr_purge            = 0;                    /* whether to delete all datasets from cache during SCR_Init */
 int   scr_distribute       = SCR_DISTRIBUTE;       /* whether to call scr_distribute_files during SCR_Init */
+int   scr_distribute_restore = SCR_DISTRIBUTE_RESTORE; /* whether to fetch only lost files of datasets that fail to rebuild */
 int   scr_fetch            = SCR_FETCH;            /* whether to call scr_fetch_files during SCR_Init */
 int   scr_fetch_width      = SCR_FETCH_WIDTH;      /* specify number of processes to read files simultaneously */
+int   scr_fetch_aggregate  = SCR_FETCH_AGGREGATE;  /* whether storage group leaders read files on behalf of their group */
 int   scr_fetch_bypass     = SCR_FETCH_BYPASS;     /* whether to use implied bypass mode on fetch */
+int   scr_fetch_stream     = SCR_FETCH_STREAM;     /* whether to fetch files in the background during restart */
+int   scr_fetch_partial    = SCR_FETCH_PARTIAL;    /* whether processes with valid files in cache skip them during fetch */
+int   scr_fetch_prefetch   = SCR_FETCH_PREFETCH;   /* whether to read metadata of the fallback checkpoint during a fetch */
+int   scr_fetch_remap      = SCR_FETCH_REMAP;      /* whether to redistribute files when restarting on a different number of processes */
+SCR_Remap_fn scr_remap_fn  = NULL;                 /* function to map old ranks to new ranks, set by SCR_Set_remap */
+void* scr_remap_arg        = NULL;                 /* argument passed to scr_remap_fn */
 char* scr_fetch_current    = NULL;                 /* name of checkpoint to start with during fetch */
 int   scr_flush            = SCR_FLUSH;            /* how many checkpoints between flushes */
 char* scr_flush_type       = NULL;                 /* AXL type to use when flushing data */
 int   scr_flush_width      = SCR_FLUSH_WIDTH;      /* specify number of processes to write files simultaneously */
+int   scr_flush_aggregate  = SCR_FLUSH_AGGREGATE;  /* whether storage group leaders write files on behalf of their group */
 int   scr_flush_on_restart = SCR_FLUSH_ON_RESTART; /* specify whether to flush cache on restart */
 int   scr_global_restart   = SCR_GLOBAL_RESTART;   /* set if code must be restarted from parallel file system */
 int   scr_drop_after_current = 0;                  /* whether to drop datasets from index that come after dataset named in SCR_Current */
@@ -132,9 +141,19 @@ int   scr_drop_after_current = 0;                  /* whether to drop datasets f
 int    scr_flush_async             = SCR_FLUSH_ASYNC;         /* whether to use asynchronous flush */
 double scr_flush_async_bw          = SCR_FLUSH_ASYNC_BW;      /* bandwidth limit imposed during async flush */
 double scr_flush_async_percent     = SCR_FLUSH_ASYNC_PERCENT; /* runtime limit imposed during async flush */
-int    scr_flush_async_in_progress = 0;                       /* tracks whether an async flush is currently underway */
-int    scr_flush_async_dataset_id  = -1;                      /* tracks the id of the checkpoint being flushed */
-double scr_flush_async_bytes       = 0.0;                     /* records the total number of bytes to be flushed */
+int    scr_flush_async_depth       = SCR_FLUSH_ASYNC_DEPTH;   /* max number of async flushes that may be underway at once */
+int    scr_flush_async_in_progress = 0;                       /* tracks the number of async flushes currently underway */
+int    scr_flush_async_dataset_id  = -1;                      /* tracks the id of the oldest checkpoint being flushed */
+
+char*         scr_flush_compress_codec = NULL;                 /* name of codec to compress files with during flush, NULL disables */
+unsigned long scr_compress_chunk       = SCR_COMPRESS_CHUNK;   /* number of bytes in each chunk when compressing files */
+int           scr_compress_threads     = SCR_COMPRESS_THREADS; /* number of threads to compress and decompress files */
+
+int           scr_use_containers  = SCR_USE_CONTAINERS;  /* whether to pack files into container files during a flush */
+unsigned long scr_container_size  = SCR_CONTAINER_SIZE;  /* max number of bytes to write to a container file */
+unsigned long scr_container_align = SCR_CONTAINER_ALIGN; /* alignment of each file within a container file */
+
+int scr_rank2file_stripes = SCR_RANK2FILE_STRIPES; /* number of files to split rank2file map across */
 
 int scr_prefix_size  = SCR_PREFIX_SIZE; /* max number of checkpoints to keep in prefix directory */
 int scr_prefix_purge = 0;               /* whether to delete all datasets listed in index file during SCR_Init */
@@ -142,10 +161,15 @@ int scr_prefix_purge = 0;               /* whether to delete all datasets listed
 int scr_crc_on_copy   = SCR_CRC_ON_COPY;   /* whether to enable crc32 checks during scr_swap_files() */
 int scr_crc_on_flush  = SCR_CRC_ON_FLUSH;  /* whether to enable crc32 checks during flush and fetch */
 int scr_crc_on_delete = SCR_CRC_ON_DELETE; /* whether to enable crc32 checks when deleting checkpoints */
+int scr_crc_threads   = SCR_CRC_THREADS;   /* number of threads to compute checksums, 0 for automatic */
+
+int scr_encode_async = SCR_ENCODE_ASYNC; /* whether to compute redundancy data in the background */
 
 int    scr_checkpoint_interval = SCR_CHECKPOINT_INTERVAL; /* times to call Need_checkpoint between checkpoints */
 int    scr_checkpoint_seconds  = SCR_CHECKPOINT_SECONDS;  /* min number of seconds between checkpoints */
 double scr_checkpoint_overhead = SCR_CHECKPOINT_OVERHEAD; /* max allowed overhead for checkpointing */
+int    scr_checkpoint_model    = SCR_CHECKPOINT_MODEL;    /* model to compute optimal time between checkpoints */
+int    scr_need_checkpoint_nonblocking = SCR_NEED_CHECKPOINT_NONBLOCKING; /* whether Need_checkpoint avoids global sync */
 int    scr_need_checkpoint_count = 0;   /* tracks the number of times Need_checkpoint has been called */
 double scr_time_checkpoint_total = 0.0; /* keeps a running total of the time spent to checkpoint */
 int    scr_time_checkpoint_count = 0;   /* keeps a running count of the number of checkpoints taken */
@@ -95,13 +95,17 @@
 #include "scr_reddesc.h"
 #include "scr_summary.h"
 #include "scr_flush_file_mpi.h"
+#include "scr_rank2file_mpi.h"
 #include "scr_cache.h"
 #include "scr_cache_rebuild.h"
 #include "scr_prefix.h"
 #include "scr_fetch.h"
+#include "scr_fetch_remap.h"
 #include "scr_flush.h"
 #include "scr_flush_sync.h"
 #include "scr_flush_async.h"
+#include "scr_compress.h"
+#include "scr_ckpt_model.h"
 
 #ifdef HAVE_LIBPMIX
 #include "pmix.h"
@@ -176,13 +180,22 @@ extern int scr_halt_exit;    /* whether SCR will call exit if halt condition is
 
 extern int   scr_purge;            /* delete all datasets from cache on restart for debugging */
 extern int   scr_distribute;       /* whether to call scr_distribute_files during SCR_Init */
+extern int   scr_distribute_restore; /* whether to fetch only lost files of datasets that fail to rebuild */
 extern int   scr_fetch;            /* whether to call scr_fetch_files during SCR_Init */
 extern int   scr_fetch_width;      /* specify number of processes to read files simultaneously */
+extern int   scr_fetch_aggregate;  /* whether storage group leaders read files on behalf of their group */
 extern int   scr_fetch_bypass;     /* whether to use implied bypass on fetch operations */
+extern int   scr_fetch_stream;     /* whether to fetch files in the background during restart */
+extern int   scr_fetch_partial;    /* whether processes with valid files in cache skip them during fetch */
+extern int   scr_fetch_prefetch;   /* whether to read metadata of the fallback checkpoint during a fetch */
+extern int   scr_fetch_remap;      /* whether to redistribute files when restarting on a different number of processes */
+extern SCR_Remap_fn scr_remap_fn;  /* function to map old ranks to new ranks, set by SCR_Set_remap */
+extern void* scr_remap_arg;        /* argument passed to scr_remap_fn */
 extern char* scr_fetch_current;    /* specify name of checkpoint to start with in fetch_latest */
 extern int   scr_flush;            /* how many checkpoints between flushes */
 extern char* scr_flush_type;       /* AXL type to use when flushing datasets */
 extern int   scr_flush_width;      /* specify number of processes to write files simultaneously */
+extern int   scr_flush_aggregate;  /* whether storage group leaders write files on behalf of their group */
 extern int   scr_flush_on_restart; /* specify whether to flush cache on restart */
 extern int   scr_global_restart;   /* set if code must be restarted from parallel file system */
 extern int   scr_drop_after_current; /* auto-drop datasets from index that come after named checkpoint when calling SCR_Current */
@@ -193,17 +206,32 @@ extern int scr_prefix_purge; /* whether to delete all datasets listed in index f
 extern int scr_flush_async;             /* whether to use asynchronous flush */
 extern double scr_flush_async_bw;       /* bandwidth limit imposed during async flush */
 extern double scr_flush_async_percent;  /* runtime limit imposed during async flush */
-extern int scr_flush_async_in_progress; /* tracks whether an async flush is currently underway */
-extern int scr_flush_async_dataset_id;  /* tracks the id of the checkpoint being flushed */
-extern double scr_flush_async_bytes;    /* records the total number of bytes to be flushed */
+extern int scr_flush_async_depth;       /* max number of async flushes that may be underway at once */
+extern int scr_flush_async_in_progress; /* tracks the number of async flushes currently underway */
+extern int scr_flush_async_dataset_id;  /* tracks the id of the oldest checkpoint being flushed */
+
+extern char* scr_flush_compress_codec;   /* name of codec to compress files with during flush, NULL disables */
+extern unsigned long scr_compress_chunk; /* number of bytes in each chunk when compressing files */
+extern int scr_compress_threads;         /* number of threads to compress and decompress files */
+
+extern int scr_use_containers;            /* whether to pack files into container files during a flush */
+extern unsigned long scr_container_size;  /* max number of bytes to write to a container file */
+extern unsigned long scr_container_align; /* alignment of each file within a container file */
+
+extern int scr_rank2file_stripes; /* number of files to split rank2file map across */
 
 extern int scr_crc_on_copy;   /* whether to enable crc32 checks during scr_swap_files() */
 extern int scr_crc_on_flush;  /* whether to enable crc32 checks during flush and fetch */
 extern int scr_crc_on_delete; /* whether to enable crc32 checks when deleting checkpoints */
+extern int scr_crc_threads;   /* number of threads to compute checksums, 0 for automatic */
+
+extern int scr_encode_async; /* whether to compute redundancy data in the background */
 
 extern int    scr_checkpoint_interval;   /* times to call Need_checkpoint between checkpoints */
 extern int    scr_checkpoint_seconds;    /* min number of seconds between checkpoints */
 extern double scr_checkpoint_overhead;   /* max allowed overhead for checkpointing */
+extern int    scr_checkpoint_model;      /* model to compute optimal time between checkpoints */
+extern int    scr_need_checkpoint_nonblocking; /* whether Need_checkpoint avoids global sync */
 extern int    scr_need_checkpoint_count; /* tracks the number of times Need_checkpoint has been called */
 extern double scr_time_checkpoint_total; /* keeps a running total of the time spent to checkpoint */
 extern int    scr_time_checkpoint_count; /* keeps a running count of the number of checkpoints taken */
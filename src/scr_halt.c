@@ -29,6 +29,88 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <time.h>
+
+/* set once this process has written its settings to the halt file */
+static int    scr_halt_synced = 0;
+
+/* attributes of the halt file the last time this process read or wrote
+ * it, used to skip reading the file again if it has not changed,
+ * scr_halt_cached is 0 while the attributes are too recent to trust */
+static int    scr_halt_cached = 0;
+static int    scr_halt_cached_exists;
+static ino_t  scr_halt_cached_ino;
+static off_t  scr_halt_cached_size;
+static time_t scr_halt_cached_mtime;
+static time_t scr_halt_cached_ctime;
+
+/* record current attributes of the halt file */
+static void scr_halt_cache_update(const char* file)
+{
+  struct stat st;
+  if (stat(file, &st) == 0) {
+    scr_halt_cached_exists = 1;
+    scr_halt_cached_ino    = st.st_ino;
+    scr_halt_cached_size   = st.st_size;
+    scr_halt_cached_mtime  = st.st_mtime;
+    scr_halt_cached_ctime  = st.st_ctime;
+
+    /* timestamps may only have a resolution of a second, so a change
+     * made within the same second as our read could go unnoticed,
+     * don't trust the attributes until they are old enough */
+    time_t now = time(NULL);
+    scr_halt_cached = (now - st.st_mtime > 1 && now - st.st_ctime > 1);
+  } else {
+    scr_halt_cached_exists = 0;
+    scr_halt_cached = 1;
+  }
+}
+
+/* returns 1 if the halt file may have changed since we last read it */
+static int scr_halt_changed(const char* file)
+{
+  if (! scr_halt_cached) {
+    return 1;
+  }
+
+  struct stat st;
+  if (stat(file, &st) != 0) {
+    /* the file has been removed if it existed before */
+    return scr_halt_cached_exists;
+  }
+
+  return (! scr_halt_cached_exists ||
+          st.st_ino   != scr_halt_cached_ino   ||
+          st.st_size  != scr_halt_cached_size  ||
+          st.st_mtime != scr_halt_cached_mtime ||
+          st.st_ctime != scr_halt_cached_ctime);
+}
+
+/* given the hash currently held in memory, override its values with
+ * those read from the halt file */
+static void scr_halt_merge(kvtree* hash, const kvtree* file_hash)
+{
+  /* for the exit reason, only override our current value if the file has a setting but we don't,
+   * otherwise the running program could never set this value */
+  /* if we have an exit reason set, but the file doesn't, make a copy before we unset out hash */
+  char* save_reason = NULL;
+  char* reason      = kvtree_elem_get_first_val(hash,      SCR_HALT_KEY_EXIT_REASON);
+  char* file_reason = kvtree_elem_get_first_val(file_hash, SCR_HALT_KEY_EXIT_REASON);
+  if (reason != NULL && file_reason == NULL) {
+    save_reason = strdup(reason);
+  }
+
+  /* set our hash to match the file */
+  kvtree_unset_all(hash);
+  kvtree_merge(hash, (kvtree*) file_hash);
+
+  /* restore our exit reason */
+  if (save_reason != NULL) {
+    kvtree_unset(hash, SCR_HALT_KEY_EXIT_REASON);
+    kvtree_set_kv(hash, SCR_HALT_KEY_EXIT_REASON, save_reason);
+    scr_free(&save_reason);
+  }
+}
 
 /* given the name of a halt file, read it and fill in hash */
 int scr_halt_read(const spath* path_file, kvtree* hash)
@@ -122,27 +204,7 @@ int scr_halt_sync_and_decrement(const spath* file_path, kvtree* hash, int dec_co
 
   /* if the file already existed before we opened it, override our current settings with its values */
   if (exists) {
-    /* for the exit reason, only override our current value if the file has a setting but we don't,
-     * otherwise the running program could never set this value */
-    /* if we have an exit reason set, but the file doesn't, make a copy before we unset out hash */
-    char* save_reason = NULL;
-    char* reason      = kvtree_elem_get_first_val(hash,      SCR_HALT_KEY_EXIT_REASON);
-    char* file_reason = kvtree_elem_get_first_val(file_hash, SCR_HALT_KEY_EXIT_REASON);
-    if (reason != NULL && file_reason == NULL) {
-      save_reason = strdup(reason);
-    }
-
-    /* set our hash to match the file */
-    kvtree_unset_all(hash);
-    kvtree_merge(hash, file_hash);
-
-    /* restore our exit reason */
-    if (save_reason != NULL) {
-      kvtree_unset(hash, SCR_HALT_KEY_EXIT_REASON);
-      kvtree_set_kv(hash, SCR_HALT_KEY_EXIT_REASON, save_reason);
-      scr_free(&save_reason);
-      save_reason = NULL;
-    }
+    scr_halt_merge(hash, file_hash);
   }
 
   /* free the file_hash */
@@ -182,6 +244,10 @@ int scr_halt_sync_and_decrement(const spath* file_path, kvtree* hash, int dec_co
   /* close file */
   scr_close(file, fd);
 
+  /* remember the state of the file we just wrote */
+  scr_halt_cache_update(file);
+  scr_halt_synced = 1;
+
   /* success if we make it this far */
   rc = SCR_SUCCESS;
 
@@ -192,3 +258,50 @@ cleanup:
   /* write current values to halt file */
   return rc;
 }
+
+/* like scr_halt_sync_and_decrement, but only reads the halt file if it
+ * has changed since we last read or wrote it, and only locks and writes
+ * the file if the checkpoints_left field must be decremented */
+int scr_halt_refresh_and_decrement(const spath* file_path, kvtree* hash, int dec_count)
+{
+  /* the first time through, write our settings out to the file */
+  if (! scr_halt_synced) {
+    return scr_halt_sync_and_decrement(file_path, hash, dec_count);
+  }
+
+  /* get file name */
+  char* file = spath_strdup(file_path);
+
+  /* pick up any changes made by scr_halt_cntl, the file lives on a
+   * shared file system and is typically updated from another node,
+   * which file change notifications do not report, so check its
+   * attributes instead, if they are too recent to trust, we read
+   * the file again but don't rewrite it */
+  int rc = SCR_SUCCESS;
+  if (scr_halt_changed(file)) {
+    kvtree* file_hash = kvtree_new();
+    if (scr_file_exists(file) == SCR_SUCCESS) {
+      /* read the file under a shared lock */
+      rc = scr_halt_read(file_path, file_hash);
+      if (rc == SCR_SUCCESS) {
+        scr_halt_merge(hash, file_hash);
+      }
+    }
+    kvtree_delete(&file_hash);
+
+    /* the file may have been removed, in which case our next write
+     * creates it again with our current values */
+    if (rc == SCR_SUCCESS) {
+      scr_halt_cache_update(file);
+    }
+  }
+
+  scr_free(&file);
+
+  /* only rewrite the file when we have a counter to decrement */
+  if (dec_count != 0 && kvtree_get(hash, SCR_HALT_KEY_CHECKPOINTS) != NULL) {
+    rc = scr_halt_sync_and_decrement(file_path, hash, dec_count);
+  }
+
+  return rc;
+}
@@ -36,4 +36,9 @@ int scr_halt_read(const spath* file, kvtree* hash);
  * optionally decrement the checkpoints_left field, and write out halt file all while locked */
 int scr_halt_sync_and_decrement(const spath* file, kvtree* hash, int dec_count);
 
+/* like scr_halt_sync_and_decrement, but only reads the halt file if it
+ * has changed since we last read or wrote it, and only locks and writes
+ * the file if the checkpoints_left field must be decremented */
+int scr_halt_refresh_and_decrement(const spath* file, kvtree* hash, int dec_count);
+
 #endif
@@ -2256,6 +2256,20 @@ int index_add(const spath* prefix, const char* name)
   return rc;
 }
 
+/* fold journal of index file into the index file */
+int index_compact(const spath* prefix)
+{
+  int rc = scr_index_compact_dir(prefix);
+  if (rc != SCR_SUCCESS) {
+    char* prefix_str = spath_strdup(prefix);
+    scr_err("Failed to compact index file in %s @ %s:%d",
+      prefix_str, __FILE__, __LINE__
+    );
+    scr_free(&prefix_str);
+  }
+  return rc;
+}
+
 int print_usage()
 {
   printf("\n");
@@ -2268,6 +2282,7 @@ int print_usage()
   printf("        --drop=<name>       Drop dataset <name> from index (does not delete files)\n");
   printf("        --drop-after=<name> Drop all datasets after <name> from index (does not delete files)\n");
   printf("    -c, --current=<name>    Set <name> as current restart dataset\n");
+  printf("        --compact           Fold index journal into index file\n");
   printf("    -p, --prefix=<dir>      Specify prefix directory (defaults to current working directory)\n");
   printf("    -h, --help              Print usage\n");
   printf("\n");
@@ -2284,6 +2299,7 @@ struct arglist {
   int drop;
   int drop_after;
   int current;
+  int compact;
 };
 
 /* free any memory allocation during get_args */
@@ -2306,6 +2322,7 @@ int get_args(int argc, char **argv, struct arglist* args)
   args->drop       = 0;
   args->drop_after = 0;
   args->current    = 0;
+  args->compact    = 0;
 
   static const char *opt_string = "lb:a:d:p:h";
   static struct option long_options[] = {
@@ -2315,6 +2332,7 @@ int get_args(int argc, char **argv, struct arglist* args)
     {"drop",       required_argument, NULL, 'd'},
     {"drop-after", required_argument, NULL, 'z'},
     {"current",    required_argument, NULL, 'c'},
+    {"compact",    no_argument,       NULL, 'k'},
     {"prefix",     required_argument, NULL, 'p'},
     {"help",       no_argument,       NULL, 'h'},
     {NULL,         no_argument,       NULL,   0}
@@ -2352,6 +2370,10 @@ int get_args(int argc, char **argv, struct arglist* args)
         args->current = 1;
         args->list    = 0;
         break;
+      case 'k':
+        args->compact = 1;
+        args->list    = 0;
+        break;
       case 'p':
         args->prefix = spath_from_str(optarg);
         break;
@@ -2401,7 +2423,7 @@ int main(int argc, char *argv[])
   int id = args.id;
 
   /* these options all require a prefix directory */
-  if (args.build == 1 || args.add == 1 || args.drop == 1 || args.drop_after == 1 || args.current == 1 || args.list == 1) {
+  if (args.build == 1 || args.add == 1 || args.drop == 1 || args.drop_after == 1 || args.current == 1 || args.compact == 1 || args.list == 1) {
     if (spath_is_null(prefix)) {
       print_usage();
       return 1;
@@ -2439,6 +2461,9 @@ int main(int argc, char *argv[])
   } else if (args.current == 1) {
     /* set named dataset as current restart */
     rc = index_current(prefix, name);
+  } else if (args.compact == 1) {
+    /* rewrite index file to include its journal */
+    rc = index_compact(prefix);
   } else if (args.list == 1) {
     /* list datasets recorded in index file */
     rc = index_list(prefix);
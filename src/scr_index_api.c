@@ -31,6 +31,10 @@
 #include <string.h>
 #include <errno.h>
 #include <unistd.h>
+#include <stdint.h>
+
+/* crc32 */
+#include <zlib.h>
 
 /* strdup */
 #include <string.h>
@@ -129,55 +133,556 @@
  *          1
  */
 
-/* read the index file from given directory and merge its contents into the given hash */
-int scr_index_read(const spath* dir, kvtree* index)
+/* To avoid rewriting a large index file on every update, changes are
+ * appended as records to a journal file next to the index file:
+ *
+ *   index.scr          snapshot of the index
+ *   index.scr.journal  records to apply to the snapshot, in order
+ *
+ * Each record replaces or removes a single second-level entry of the
+ * index, e.g., DSET/6 or CURRENT/ckpt.6, so applying a record twice has
+ * no effect.  Readers load the snapshot and apply the journal.  Once the
+ * journal grows larger than the snapshot, the full index is written to a
+ * new snapshot, which is renamed over the old one, and the journal is
+ * removed.  A journal without a snapshot is ignored.
+ *
+ * Each snapshot records a generation number under GENERATION, which is
+ * bumped each time a new snapshot is written, and the journal starts with
+ * a header holding the generation of the snapshot it applies to.  If we
+ * die after renaming a new snapshot but before removing the journal, the
+ * leftover journal has an older generation and is ignored, since its
+ * records may undo changes that are already in the new snapshot.  The
+ * header is a 4-byte magic value, 4 bytes of zero, and the 8-byte
+ * generation.
+ *
+ * A record is stored as a 4-byte magic value, a 4-byte crc32 of the
+ * data, an 8-byte length, and then the data, which is a packed kvtree
+ * with the following keys:
+ *
+ *   OP     SET or UNSET
+ *   KEY    first-level key, e.g., DSET
+ *   SUBKEY second-level key, e.g., 6 (unset if the record applies to KEY)
+ *   VALUE  hash to store under KEY/SUBKEY for a SET */
+
+#define SCR_INDEX_JOURNAL_SUFFIX ".journal"
+#define SCR_INDEX_JOURNAL_MAGIC  (0x5343524aUL) /* "SCRJ" */
+#define SCR_INDEX_JOURNAL_HEADER (16)
+#define SCR_INDEX_JOURNAL_GEN_MAGIC (0x53435247UL) /* "SCRG" */
+
+/* key in snapshot that records its generation number */
+#define SCR_INDEX_KEY_GENERATION ("GENERATION")
+
+/* don't bother compacting until the journal is at least this large */
+#define SCR_INDEX_JOURNAL_MIN_COMPACT (64 * 1024)
+
+#define SCR_INDEX_JOURNAL_KEY_OP     ("OP")
+#define SCR_INDEX_JOURNAL_KEY_KEY    ("KEY")
+#define SCR_INDEX_JOURNAL_KEY_SUBKEY ("SUBKEY")
+#define SCR_INDEX_JOURNAL_KEY_VALUE  ("VALUE")
+#define SCR_INDEX_JOURNAL_OP_SET     ("SET")
+#define SCR_INDEX_JOURNAL_OP_UNSET   ("UNSET")
+
+/* contents of the index on disk as last read or written by this process,
+ * used to determine what changed in scr_index_write without reading the
+ * files again, along with attributes to detect changes by other processes */
+static char*   scr_index_cache_file = NULL;
+static kvtree* scr_index_cache      = NULL;
+static int     scr_index_cache_torn = 0;  /* whether journal ends with a partial record */
+static unsigned long scr_index_cache_gen = 0; /* generation of snapshot */
+static ino_t   scr_index_cache_snap_ino;
+static off_t   scr_index_cache_snap_size;
+static off_t   scr_index_cache_journal_size;
+
+/* build the header that starts a journal for a snapshot of given generation */
+static void scr_index_journal_header(unsigned char* header, unsigned long gen)
 {
-  int rc = SCR_FAILURE;
+  scr_pack_be(header,     SCR_INDEX_JOURNAL_GEN_MAGIC, 4);
+  scr_pack_be(header + 4, 0, 4);
+  scr_pack_be(header + 8, (uint64_t) gen, 8);
+}
+
+/* read the header from the start of an open journal, sets empty if the
+ * journal has no header yet, returns SCR_FAILURE if the header is bad */
+static int scr_index_journal_read_header(const char* journal, int fd, unsigned long* gen, int* empty)
+{
+  *gen   = 0;
+  *empty = 0;
+
+  unsigned char header[SCR_INDEX_JOURNAL_HEADER];
+  ssize_t nread = scr_read(journal, fd, header, sizeof(header));
+  if (nread == 0) {
+    *empty = 1;
+    return SCR_SUCCESS;
+  }
+  if (nread != sizeof(header) ||
+      scr_unpack_be(header, 4) != SCR_INDEX_JOURNAL_GEN_MAGIC)
+  {
+    return SCR_FAILURE;
+  }
 
-  /* build the file name for the index file */
+  *gen = (unsigned long) scr_unpack_be(header + 8, 8);
+  return SCR_SUCCESS;
+}
+
+/* build paths to snapshot and journal files for given prefix directory */
+static void scr_index_files(const spath* dir, char** snapshot, char** journal)
+{
   spath* path_index = spath_dup(dir);
   spath_append_str(path_index, ".scr");
   spath_append_str(path_index, SCR_INDEX_FILENAME);
-  char* index_file = spath_strdup(path_index);
+  *snapshot = spath_strdup(path_index);
+  spath_delete(&path_index);
 
-  /* if we can access it, read the index file */
-  if (scr_file_exists(index_file) == SCR_SUCCESS) {
-    kvtree* tmp = kvtree_new();
-    int kvtree_rc = kvtree_read_file(index_file, tmp);
-    rc = (kvtree_rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+  size_t len = strlen(*snapshot) + strlen(SCR_INDEX_JOURNAL_SUFFIX) + 1;
+  *journal = (char*) SCR_MALLOC(len);
+  snprintf(*journal, len, "%s%s", *snapshot, SCR_INDEX_JOURNAL_SUFFIX);
+}
 
-    /* version check on file */
-    if (rc == SCR_SUCCESS) {
-      /* read version value from file */
-      int version;
-      if (kvtree_util_get_int(tmp, SCR_INDEX_KEY_VERSION, &version) == KVTREE_SUCCESS) {
-        /* got a version number, check that it's what we expect */
-        if (version == SCR_INDEX_FILE_VERSION_2) {
-          /* got the correct version, copy file contents into caller's kvtree */
-          kvtree_merge(index, tmp);
-        } else {
-          /* failed to find the version number in the file */
-          scr_err("Found file format version %d but expected %d in index file: %s @ %s:%d",
-            version, SCR_INDEX_FILE_VERSION_2, index_file, __FILE__, __LINE__
-          );
-          rc = SCR_FAILURE;
-        }
+/* get inode and size of file, returns size -1 if the file does not exist */
+static void scr_index_file_stat(const char* file, ino_t* ino, off_t* size)
+{
+  struct stat st;
+  if (stat(file, &st) == 0) {
+    *ino  = st.st_ino;
+    *size = st.st_size;
+  } else {
+    *ino  = 0;
+    *size = -1;
+  }
+}
+
+/* remember that the index files currently on disk hold the given index */
+static void scr_index_cache_set(const char* snapshot, const char* journal, const kvtree* index, int torn, unsigned long gen)
+{
+  if (scr_index_cache_file == NULL || strcmp(scr_index_cache_file, snapshot) != 0) {
+    scr_free(&scr_index_cache_file);
+    scr_index_cache_file = strdup(snapshot);
+  }
+
+  kvtree_delete(&scr_index_cache);
+  scr_index_cache = kvtree_new();
+  kvtree_merge(scr_index_cache, (kvtree*) index);
+  scr_index_cache_torn = torn;
+  scr_index_cache_gen  = gen;
+
+  ino_t ino;
+  scr_index_file_stat(snapshot, &scr_index_cache_snap_ino, &scr_index_cache_snap_size);
+  scr_index_file_stat(journal,  &ino, &scr_index_cache_journal_size);
+}
+
+/* returns the cached contents of the index files if they have not been
+ * changed by another process since, NULL otherwise */
+static const kvtree* scr_index_cache_get(const char* snapshot, const char* journal)
+{
+  if (scr_index_cache == NULL || strcmp(scr_index_cache_file, snapshot) != 0) {
+    return NULL;
+  }
+
+  /* the snapshot is replaced with a rename, and the journal is only
+   * appended to, so a change shows up as a new inode or size */
+  ino_t snap_ino, journal_ino;
+  off_t snap_size, journal_size;
+  scr_index_file_stat(snapshot, &snap_ino, &snap_size);
+  scr_index_file_stat(journal, &journal_ino, &journal_size);
+  if (snap_ino     != scr_index_cache_snap_ino  ||
+      snap_size    != scr_index_cache_snap_size ||
+      journal_size != scr_index_cache_journal_size)
+  {
+    return NULL;
+  }
+
+  return scr_index_cache;
+}
+
+/* apply a journal record to the index */
+static void scr_index_journal_apply(kvtree* index, const kvtree* rec)
+{
+  char* op     = kvtree_elem_get_first_val(rec, SCR_INDEX_JOURNAL_KEY_OP);
+  char* key    = kvtree_elem_get_first_val(rec, SCR_INDEX_JOURNAL_KEY_KEY);
+  char* subkey = kvtree_elem_get_first_val(rec, SCR_INDEX_JOURNAL_KEY_SUBKEY);
+  kvtree* value = kvtree_get(rec, SCR_INDEX_JOURNAL_KEY_VALUE);
+  if (op == NULL || key == NULL) {
+    return;
+  }
+
+  /* remove the current entry */
+  if (subkey != NULL) {
+    kvtree_unset_kv(index, key, subkey);
+  } else {
+    kvtree_unset(index, key);
+  }
+
+  /* and replace it with the new one */
+  if (strcmp(op, SCR_INDEX_JOURNAL_OP_SET) == 0) {
+    kvtree* entry;
+    if (subkey != NULL) {
+      entry = kvtree_set_kv(index, key, subkey);
+    } else {
+      entry = kvtree_set(index, key, kvtree_new());
+    }
+    if (value != NULL) {
+      kvtree_merge(entry, value);
+    }
+  }
+}
+
+/* apply all complete records in the journal to the index if the journal
+ * belongs to the snapshot of the given generation, sets torn if the
+ * journal ends with a partial record or belongs to another snapshot */
+static int scr_index_journal_replay(const char* journal, unsigned long gen, kvtree* index, int* torn)
+{
+  *torn = 0;
+
+  /* nothing to do if there is no journal */
+  if (scr_file_exists(journal) != SCR_SUCCESS) {
+    return SCR_SUCCESS;
+  }
+
+  int fd = scr_open(journal, O_RDONLY);
+  if (fd < 0) {
+    scr_err("Opening index journal for read: scr_open(%s) errno=%d %s @ %s:%d",
+      journal, errno, strerror(errno), __FILE__, __LINE__
+    );
+    return SCR_FAILURE;
+  }
+
+  /* skip the whole journal if it was written against an older snapshot */
+  unsigned long journal_gen;
+  int empty;
+  if (scr_index_journal_read_header(journal, fd, &journal_gen, &empty) != SCR_SUCCESS ||
+      (! empty && journal_gen != gen))
+  {
+    scr_close(journal, fd);
+    scr_dbg(1, "Ignoring index journal %s that does not match generation %lu of snapshot",
+      journal, gen
+    );
+    *torn = 1;
+    return SCR_SUCCESS;
+  }
+
+  /* read records until we hit the end of the file or a partial record,
+   * which is left behind if a writer dies in the middle of an append */
+  while (! empty) {
+    unsigned char header[SCR_INDEX_JOURNAL_HEADER];
+    ssize_t nread = scr_read(journal, fd, header, sizeof(header));
+    if (nread == 0) {
+      break;
+    }
+    if (nread != sizeof(header) ||
+        scr_unpack_be(header, 4) != SCR_INDEX_JOURNAL_MAGIC)
+    {
+      *torn = 1;
+      break;
+    }
+
+    uLong crc    = (uLong) scr_unpack_be(header + 4, 4);
+    uint64_t len = scr_unpack_be(header + 8, 8);
+
+    char* buf = (char*) malloc((size_t) len);
+    if (buf == NULL) {
+      *torn = 1;
+      break;
+    }
+    nread = scr_read(journal, fd, buf, (size_t) len);
+    if (nread != (ssize_t) len ||
+        crc32(crc32(0L, Z_NULL, 0), (const Bytef*) buf, (uInt) len) != crc)
+    {
+      scr_free(&buf);
+      *torn = 1;
+      break;
+    }
+
+    kvtree* rec = kvtree_new();
+    kvtree_unpack(buf, rec);
+    scr_index_journal_apply(index, rec);
+    kvtree_delete(&rec);
+    scr_free(&buf);
+  }
+
+  scr_close(journal, fd);
+
+  if (*torn) {
+    scr_dbg(1, "Ignoring partial record at end of index journal %s", journal);
+  }
+
+  return SCR_SUCCESS;
+}
+
+/* add a record to buffer of records to append to journal */
+static void scr_index_journal_add(
+  char** buf, size_t* size, size_t* used,
+  const char* op, const char* key, const char* subkey, const kvtree* value)
+{
+  /* build the record */
+  kvtree* rec = kvtree_new();
+  kvtree_util_set_str(rec, SCR_INDEX_JOURNAL_KEY_OP, op);
+  kvtree_util_set_str(rec, SCR_INDEX_JOURNAL_KEY_KEY, key);
+  if (subkey != NULL) {
+    kvtree_util_set_str(rec, SCR_INDEX_JOURNAL_KEY_SUBKEY, subkey);
+  }
+  if (value != NULL) {
+    kvtree* copy = kvtree_new();
+    kvtree_merge(copy, (kvtree*) value);
+    kvtree_set(rec, SCR_INDEX_JOURNAL_KEY_VALUE, copy);
+  }
+
+  /* grow the buffer if needed */
+  size_t len = kvtree_pack_size(rec);
+  size_t need = *used + SCR_INDEX_JOURNAL_HEADER + len;
+  if (need > *size) {
+    size_t newsize = (*size > 0) ? *size : 4096;
+    while (newsize < need) {
+      newsize *= 2;
+    }
+    char* newbuf = (char*) SCR_MALLOC(newsize);
+    if (*used > 0) {
+      memcpy(newbuf, *buf, *used);
+    }
+    scr_free(buf);
+    *buf  = newbuf;
+    *size = newsize;
+  }
+
+  /* pack the record behind its header */
+  unsigned char* header = (unsigned char*) (*buf + *used);
+  char* data = *buf + *used + SCR_INDEX_JOURNAL_HEADER;
+  kvtree_pack(data, rec);
+  uLong crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*) data, (uInt) len);
+  scr_pack_be(header,     SCR_INDEX_JOURNAL_MAGIC, 4);
+  scr_pack_be(header + 4, (uint64_t) crc, 4);
+  scr_pack_be(header + 8, (uint64_t) len, 8);
+  *used = need;
+
+  kvtree_delete(&rec);
+}
+
+/* returns 1 if the two hashes have the same contents */
+static int scr_index_hash_equal(const kvtree* a, const kvtree* b)
+{
+  size_t len_a = kvtree_pack_size(a);
+  size_t len_b = kvtree_pack_size(b);
+  if (len_a != len_b) {
+    return 0;
+  }
+
+  char* buf_a = (char*) SCR_MALLOC(len_a);
+  char* buf_b = (char*) SCR_MALLOC(len_b);
+  kvtree_pack(buf_a, a);
+  kvtree_pack(buf_b, b);
+  int equal = (memcmp(buf_a, buf_b, len_a) == 0);
+  scr_free(&buf_b);
+  scr_free(&buf_a);
+
+  return equal;
+}
+
+/* build records for each second-level entry that differs between
+ * the old and new index */
+static void scr_index_journal_diff(
+  const kvtree* old_index, const kvtree* new_index,
+  char** buf, size_t* size, size_t* used)
+{
+  kvtree_elem* elem;
+  kvtree_elem* sub;
+
+  /* drop entries that are no longer in the index */
+  for (elem = kvtree_elem_first(old_index);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* key = kvtree_elem_key(elem);
+    kvtree* new_hash = kvtree_get(new_index, key);
+    if (new_hash == NULL) {
+      scr_index_journal_add(buf, size, used, SCR_INDEX_JOURNAL_OP_UNSET, key, NULL, NULL);
+      continue;
+    }
+
+    for (sub = kvtree_elem_first(kvtree_elem_hash(elem));
+         sub != NULL;
+         sub = kvtree_elem_next(sub))
+    {
+      char* subkey = kvtree_elem_key(sub);
+      if (kvtree_get(new_hash, subkey) == NULL) {
+        scr_index_journal_add(buf, size, used, SCR_INDEX_JOURNAL_OP_UNSET, key, subkey, NULL);
+      }
+    }
+  }
+
+  /* record entries that are new or have changed */
+  for (elem = kvtree_elem_first(new_index);
+       elem != NULL;
+       elem = kvtree_elem_next(elem))
+  {
+    char* key = kvtree_elem_key(elem);
+    kvtree* new_hash = kvtree_elem_hash(elem);
+    kvtree* old_hash = kvtree_get(old_index, key);
+
+    /* create an empty first-level entry if needed */
+    if (old_hash == NULL && kvtree_size(new_hash) == 0) {
+      scr_index_journal_add(buf, size, used, SCR_INDEX_JOURNAL_OP_SET, key, NULL, NULL);
+      continue;
+    }
+
+    for (sub = kvtree_elem_first(new_hash);
+         sub != NULL;
+         sub = kvtree_elem_next(sub))
+    {
+      char* subkey = kvtree_elem_key(sub);
+      kvtree* new_value = kvtree_elem_hash(sub);
+      kvtree* old_value = (old_hash != NULL) ? kvtree_get(old_hash, subkey) : NULL;
+      if (old_value == NULL || ! scr_index_hash_equal(old_value, new_value)) {
+        scr_index_journal_add(buf, size, used, SCR_INDEX_JOURNAL_OP_SET, key, subkey, new_value);
+      }
+    }
+  }
+}
+
+/* read snapshot file and check its version, strips the generation
+ * from the index and returns it in gen */
+static int scr_index_read_snapshot(const char* index_file, kvtree* index, unsigned long* gen)
+{
+  *gen = 0;
+
+  kvtree* tmp = kvtree_new();
+  int kvtree_rc = kvtree_read_file(index_file, tmp);
+  int rc = (kvtree_rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+
+  /* version check on file */
+  if (rc == SCR_SUCCESS) {
+    /* read version value from file */
+    int version;
+    if (kvtree_util_get_int(tmp, SCR_INDEX_KEY_VERSION, &version) == KVTREE_SUCCESS) {
+      /* got a version number, check that it's what we expect */
+      if (version == SCR_INDEX_FILE_VERSION_2) {
+        /* got the correct version, pull out the generation, which is
+         * absent in snapshots written before we had one */
+        kvtree_util_get_unsigned_long(tmp, SCR_INDEX_KEY_GENERATION, gen);
+        kvtree_unset(tmp, SCR_INDEX_KEY_GENERATION);
+
+        /* copy file contents into caller's kvtree */
+        kvtree_merge(index, tmp);
       } else {
-        /* failed to find any version number in the file */
-        scr_err("Failed to find file format version in index file: %s @ %s:%d",
-          index_file, __FILE__, __LINE__
+        /* failed to find the version number in the file */
+        scr_err("Found file format version %d but expected %d in index file: %s @ %s:%d",
+          version, SCR_INDEX_FILE_VERSION_2, index_file, __FILE__, __LINE__
         );
         rc = SCR_FAILURE;
       }
+    } else {
+      /* failed to find any version number in the file */
+      scr_err("Failed to find file format version in index file: %s @ %s:%d",
+        index_file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
+  }
 
-      /* free our temporary tree */
-      kvtree_delete(&tmp);
+  /* free our temporary tree */
+  kvtree_delete(&tmp);
+
+  return rc;
+}
+
+/* read snapshot and apply journal, returns generation of snapshot in gen */
+static int scr_index_read_files(const char* snapshot, const char* journal, kvtree* index, int* torn, unsigned long* gen)
+{
+  *torn = 0;
+
+  int rc = scr_index_read_snapshot(snapshot, index, gen);
+  if (rc == SCR_SUCCESS) {
+    rc = scr_index_journal_replay(journal, *gen, index, torn);
+  }
+
+  return rc;
+}
+
+/* write full index to a new snapshot and remove the journal, the new
+ * snapshot gets a generation newer than both the current snapshot of
+ * generation gen and any journal on disk, returned in new_gen */
+static int scr_index_compact(const char* snapshot, const char* journal, const kvtree* index, unsigned long gen, unsigned long* new_gen)
+{
+  size_t len = strlen(snapshot) + 5;
+  char* tmpfile = (char*) SCR_MALLOC(len);
+  snprintf(tmpfile, len, "%s.tmp", snapshot);
+
+  /* pick a generation that no journal left on disk can match */
+  unsigned long next_gen = gen;
+  if (scr_file_exists(journal) == SCR_SUCCESS) {
+    int fd = scr_open(journal, O_RDONLY);
+    if (fd >= 0) {
+      unsigned long journal_gen;
+      int empty;
+      if (scr_index_journal_read_header(journal, fd, &journal_gen, &empty) == SCR_SUCCESS &&
+          journal_gen > next_gen)
+      {
+        next_gen = journal_gen;
+      }
+      scr_close(journal, fd);
     }
   }
+  next_gen++;
 
-  /* free path and string */
-  scr_free(&index_file);
-  spath_delete(&path_index);
+  /* stamp the snapshot with its generation */
+  kvtree* stamped = kvtree_new();
+  kvtree_merge(stamped, (kvtree*) index);
+  kvtree_util_set_unsigned_long(stamped, SCR_INDEX_KEY_GENERATION, next_gen);
+
+  /* write to a temporary file and rename it, so that readers always
+   * find a complete snapshot */
+  int rc = SCR_SUCCESS;
+  if (kvtree_write_file(tmpfile, stamped) != KVTREE_SUCCESS) {
+    scr_err("Writing index file %s @ %s:%d",
+      tmpfile, __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  } else if (rename(tmpfile, snapshot) != 0) {
+    scr_err("Renaming %s to %s: errno=%d %s @ %s:%d",
+      tmpfile, snapshot, errno, strerror(errno), __FILE__, __LINE__
+    );
+    unlink(tmpfile);
+    rc = SCR_FAILURE;
+  }
+
+  /* the snapshot now includes all records, so drop the journal,
+   * if we die before this, readers ignore the journal since its
+   * generation no longer matches the snapshot */
+  if (rc == SCR_SUCCESS) {
+    scr_file_unlink(journal);
+    *new_gen = next_gen;
+  }
+
+  kvtree_delete(&stamped);
+  scr_free(&tmpfile);
+
+  return rc;
+}
+
+/* read the index file from given directory and merge its contents into the given hash */
+int scr_index_read(const spath* dir, kvtree* index)
+{
+  int rc = SCR_FAILURE;
+
+  /* build the file names for the index files */
+  char* snapshot;
+  char* journal;
+  scr_index_files(dir, &snapshot, &journal);
+
+  /* if we can access it, read the index file and apply its journal */
+  if (scr_file_exists(snapshot) == SCR_SUCCESS) {
+    kvtree* tmp = kvtree_new();
+    int torn;
+    unsigned long gen;
+    rc = scr_index_read_files(snapshot, journal, tmp, &torn, &gen);
+    if (rc == SCR_SUCCESS) {
+      kvtree_merge(index, tmp);
+      scr_index_cache_set(snapshot, journal, tmp, torn, gen);
+    }
+    kvtree_delete(&tmp);
+  }
+
+  /* free strings */
+  scr_free(&journal);
+  scr_free(&snapshot);
 
   return rc;
 }
@@ -185,10 +690,10 @@ int scr_index_read(const spath* dir, kvtree* index)
 /* overwrite the contents of the index file in given directory with given hash */
 int scr_index_write(const spath* dir, kvtree* index)
 {
-  /* build the file name for the index file */
-  spath* path_index = spath_dup(dir);
-  spath_append_str(path_index, ".scr");
-  spath_append_str(path_index, SCR_INDEX_FILENAME);
+  /* build the file names for the index files */
+  char* snapshot;
+  char* journal;
+  scr_index_files(dir, &snapshot, &journal);
 
   /* set the index file version key if it's not set already */
   kvtree* version = kvtree_get(index, SCR_INDEX_KEY_VERSION);
@@ -196,13 +701,123 @@ int scr_index_write(const spath* dir, kvtree* index)
     kvtree_util_set_int(index, SCR_INDEX_KEY_VERSION, SCR_INDEX_FILE_VERSION_2);
   }
 
-  /* write out the file */
-  int kvtree_rc = kvtree_write_path(path_index, index);
-  int rc = (kvtree_rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+  int rc = SCR_SUCCESS;
+  int compact = 0;
+  char* buf   = NULL;
+  size_t size = 0;
+  size_t used = 0;
+
+  /* get current contents of the index files, read them if another
+   * process has changed them since we last looked */
+  kvtree* ondisk = NULL;
+  const kvtree* old_index = NULL;
+  int torn = 0;
+  unsigned long gen = 0;
+  if (scr_file_exists(snapshot) != SCR_SUCCESS) {
+    /* no snapshot yet, any journal left behind is stale */
+    compact = 1;
+  } else {
+    old_index = scr_index_cache_get(snapshot, journal);
+    torn = scr_index_cache_torn;
+    gen  = scr_index_cache_gen;
+    if (old_index == NULL) {
+      ondisk = kvtree_new();
+      if (scr_index_read_files(snapshot, journal, ondisk, &torn, &gen) == SCR_SUCCESS) {
+        old_index = ondisk;
+      } else {
+        compact = 1;
+      }
+    }
 
-  /* free path */
-  spath_delete(&path_index);
+    /* don't append after a partial record */
+    if (torn) {
+      compact = 1;
+    }
+  }
 
+  /* build records for what changed */
+  if (! compact) {
+    scr_index_journal_diff(old_index, index, &buf, &size, &used);
+
+    /* rewrite the snapshot once the journal grows larger than it */
+    ino_t ino;
+    off_t snap_size, journal_size;
+    scr_index_file_stat(snapshot, &ino, &snap_size);
+    scr_index_file_stat(journal, &ino, &journal_size);
+    if (journal_size < 0) {
+      journal_size = 0;
+    }
+    off_t limit = (snap_size > SCR_INDEX_JOURNAL_MIN_COMPACT) ? snap_size : SCR_INDEX_JOURNAL_MIN_COMPACT;
+    if (journal_size + (off_t) used > limit) {
+      compact = 1;
+    }
+  }
+
+  if (compact) {
+    rc = scr_index_compact(snapshot, journal, index, gen, &gen);
+  } else if (used > 0) {
+    /* append all records with a single write */
+    mode_t mode_file = scr_getmode(1, 1, 0);
+    int fd = scr_open(journal, O_WRONLY | O_APPEND | O_CREAT, mode_file);
+    if (fd < 0) {
+      scr_err("Opening index journal for write: scr_open(%s) errno=%d %s @ %s:%d",
+        journal, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      /* tie a new journal to the generation of the snapshot */
+      ino_t ino;
+      off_t journal_size;
+      scr_index_file_stat(journal, &ino, &journal_size);
+      if (journal_size <= 0) {
+        unsigned char header[SCR_INDEX_JOURNAL_HEADER];
+        scr_index_journal_header(header, gen);
+        if (scr_write(journal, fd, header, sizeof(header)) != (ssize_t) sizeof(header)) {
+          rc = SCR_FAILURE;
+        }
+      }
+      if (rc == SCR_SUCCESS &&
+          scr_write(journal, fd, buf, used) != (ssize_t) used)
+      {
+        rc = SCR_FAILURE;
+      }
+      scr_close(journal, fd);
+    }
+  }
+
+  /* remember what's on disk now */
+  if (rc == SCR_SUCCESS) {
+    scr_index_cache_set(snapshot, journal, index, 0, gen);
+  }
+
+  /* free buffers and strings */
+  scr_free(&buf);
+  kvtree_delete(&ondisk);
+  scr_free(&journal);
+  scr_free(&snapshot);
+
+  return rc;
+}
+
+/* write the full index from the given directory to a new snapshot
+ * and remove its journal */
+int scr_index_compact_dir(const spath* dir)
+{
+  kvtree* index = kvtree_new();
+  int rc = scr_index_read(dir, index);
+  if (rc == SCR_SUCCESS) {
+    char* snapshot;
+    char* journal;
+    scr_index_files(dir, &snapshot, &journal);
+    unsigned long gen = scr_index_cache_gen;
+    rc = scr_index_compact(snapshot, journal, index, gen, &gen);
+    if (rc == SCR_SUCCESS) {
+      scr_index_cache_set(snapshot, journal, index, 0, gen);
+    }
+    scr_free(&journal);
+    scr_free(&snapshot);
+  }
+  kvtree_delete(&index);
   return rc;
 }
 
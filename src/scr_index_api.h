@@ -22,9 +22,13 @@
 /* read the index file from given directory and merge its contents into the given hash */
 int scr_index_read(const spath* dir, kvtree* index);
 
-/* overwrite the contents of the index file in given directory with given hash */
+/* overwrite the contents of the index file in given directory with given hash,
+ * changes since the index was last read are appended to a journal */
 int scr_index_write(const spath* dir, kvtree* index);
 
+/* fold the journal of the index file in given directory into the index file */
+int scr_index_compact_dir(const spath* dir);
+
 /* read index file and return max dataset and checkpoint ids,
  * returns SCR_SUCCESS if file read successfully */
 int scr_index_get_max_ids(const spath* dir, int* dset_id, int* ckpt_id, int* ckpt_dset_id);
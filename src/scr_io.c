@@ -36,6 +36,9 @@
 /* Please note todos in the cppr section; an optimization of using CPPR apis is
  * planned for upcoming work */
 
+/* for O_DIRECT */
+#define _GNU_SOURCE
+
 #include "scr_conf.h"
 #include "scr.h"
 #include "scr_err.h"
@@ -51,6 +54,16 @@
 #include <string.h>
 #include <strings.h>
 #include <stdint.h>
+#include <pthread.h>
+
+/* copy file data within the kernel */
+#include <sys/ioctl.h>
+#ifdef HAVE_SENDFILE
+#include <sys/sendfile.h>
+#endif
+#ifdef HAVE_LINUX_FS_H
+#include <linux/fs.h>
+#endif
 
 /* variable length args */
 #include <stdarg.h>
@@ -77,7 +90,7 @@ cppr_return_t _scr_cppr_file_copy(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
-  uLong* crc
+  scr_checksum* ck
 );
 #endif
 
@@ -908,14 +921,237 @@ File Copy Functions
 =========================================
 */
 
-/* TODO: could perhaps use O_DIRECT here as an optimization */
-/* TODO: could apply compression/decompression here */
-/* copy src_file (full path) to dest_path and return new full path in dest_file */
-int scr_file_copy(
+/* state shared between the reader and writer of a pipelined copy,
+ * buffers are handed from the reader to the writer in ring order */
+typedef struct {
+  pthread_mutex_t lock;
+  pthread_cond_t  cond;
+  int num_bufs;        /* number of buffers in ring */
+  size_t buf_size;     /* size of each buffer in bytes */
+  char** bufs;         /* aligned buffers */
+  size_t* counts;      /* number of valid bytes in each buffer */
+  int* full;           /* whether buffer holds data waiting to be written */
+  int error;           /* set if either side hits an error */
+  const char* dst_file;
+  int dst_fd;
+  int dst_direct;      /* whether dst_fd is currently opened with O_DIRECT */
+} scr_file_copy_ring;
+
+/* opens file with O_DIRECT if requested and supported,
+ * falls back to a normal open otherwise, sets direct to 1
+ * if the file was opened with O_DIRECT */
+static int scr_file_copy_open(const char* file, int flags, mode_t mode, int want_direct, int* direct)
+{
+  *direct = 0;
+
+#ifdef O_DIRECT
+  if (want_direct) {
+    /* not all file systems support O_DIRECT (e.g., tmpfs),
+     * so call open directly to avoid the retries in scr_open */
+    int fd = open(file, flags | O_DIRECT, mode);
+    if (fd >= 0) {
+      *direct = 1;
+      return fd;
+    }
+    scr_dbg(2, "Opening file with O_DIRECT failed, falling back: open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+  }
+#endif
+
+  if (flags & O_CREAT) {
+    return scr_open(file, flags, mode);
+  }
+  return scr_open(file, flags);
+}
+
+/* read up to size bytes into buf, retrying on interrupts and short
+ * reads, returns number of bytes read, which is less than size only
+ * at the end of the file, or -1 on error */
+static ssize_t scr_file_copy_read(const char* file, int fd, int direct, char* buf, size_t size)
+{
+  size_t n = 0;
+  while (n < size) {
+    ssize_t rc = read(fd, buf + n, size - n);
+    if (rc > 0) {
+      n += (size_t) rc;
+
+      /* a short read on a file opened with O_DIRECT leaves the file
+       * pointer unaligned, which only happens at the end of the file */
+      if (direct && n < size) {
+        break;
+      }
+    } else if (rc == 0) {
+      /* hit end of file */
+      break;
+    } else if (errno == EINTR || errno == EAGAIN) {
+      /* interrupted, try again */
+      continue;
+    } else {
+      scr_err("Error reading %s: read(%d, %p, %ld) errno=%d %s @ %s:%d",
+        file, fd, buf + n, (long) (size - n), errno, strerror(errno), __FILE__, __LINE__
+      );
+      return -1;
+    }
+  }
+  return (ssize_t) n;
+}
+
+/* write count bytes from buf to the destination file, O_DIRECT
+ * requires the length to be a multiple of the alignment, so clear
+ * O_DIRECT on the file to write an unaligned tail */
+static int scr_file_copy_write(scr_file_copy_ring* ring, const char* buf, size_t count)
+{
+#ifdef O_DIRECT
+  if (ring->dst_direct && (count % SCR_FILE_COPY_ALIGN) != 0) {
+    int flags = fcntl(ring->dst_fd, F_GETFL);
+    if (flags < 0 || fcntl(ring->dst_fd, F_SETFL, flags & ~O_DIRECT) < 0) {
+      scr_err("Failed to clear O_DIRECT on %s errno=%d %s @ %s:%d",
+        ring->dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      return SCR_FAILURE;
+    }
+    ring->dst_direct = 0;
+  }
+#endif
+
+  ssize_t nwrite = scr_write_attempt(ring->dst_file, ring->dst_fd, buf, count);
+  if (nwrite < 0 || (size_t) nwrite != count) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* writer thread, drains buffers from the ring in order until it
+ * finds a short buffer, which marks the end of the file */
+static void* scr_file_copy_writer(void* arg)
+{
+  scr_file_copy_ring* ring = (scr_file_copy_ring*) arg;
+
+  int slot = 0;
+  int writing = 1;
+  while (writing) {
+    /* wait for the reader to fill the next buffer */
+    pthread_mutex_lock(&ring->lock);
+    while (! ring->full[slot] && ! ring->error) {
+      pthread_cond_wait(&ring->cond, &ring->lock);
+    }
+    int error = ring->error;
+    pthread_mutex_unlock(&ring->lock);
+
+    /* stop if the reader failed */
+    if (error) {
+      break;
+    }
+
+    /* write out the data in this buffer */
+    size_t count = ring->counts[slot];
+    int rc = SCR_SUCCESS;
+    if (count > 0) {
+      rc = scr_file_copy_write(ring, ring->bufs[slot], count);
+    }
+
+    /* a short buffer is the last one */
+    if (count < ring->buf_size) {
+      writing = 0;
+    }
+
+    /* hand the buffer back to the reader */
+    pthread_mutex_lock(&ring->lock);
+    ring->full[slot] = 0;
+    if (rc != SCR_SUCCESS) {
+      ring->error = 1;
+      writing = 0;
+    }
+    pthread_cond_broadcast(&ring->cond);
+    pthread_mutex_unlock(&ring->lock);
+
+    slot = (slot + 1) % ring->num_bufs;
+  }
+
+  return NULL;
+}
+
+/* attempt to copy the remainder of src_fd to dst_fd without moving
+ * data through user space, a reflink shares blocks rather than
+ * copying them so it is tried first, followed by copy_file_range
+ * and then sendfile, all of which advance the file offsets of both
+ * descriptors, so the caller can finish any remaining bytes with a
+ * normal copy, returns SCR_SUCCESS if the whole file was copied and
+ * sets copied to the number of bytes moved by the kernel */
+static int scr_file_copy_kernel(
+  const char* src_file, int src_fd,
+  const char* dst_file, int dst_fd,
+  unsigned long long* copied)
+{
+  *copied = 0;
+
+#if defined(HAVE_LINUX_FS_H) && defined(FICLONE)
+  /* clone the full file, only works on file systems like btrfs and xfs
+   * that support reflinks and when both files are on the same one */
+  struct stat st;
+  if (ioctl(dst_fd, FICLONE, src_fd) == 0 && fstat(src_fd, &st) == 0) {
+    scr_dbg(2, "Cloned %s to %s @ %s:%d",
+      src_file, dst_file, __FILE__, __LINE__
+    );
+    *copied = (unsigned long long) st.st_size;
+    return SCR_SUCCESS;
+  }
+#endif
+
+#ifdef HAVE_COPY_FILE_RANGE
+  while (1) {
+    ssize_t rc = copy_file_range(src_fd, NULL, dst_fd, NULL, SCR_FILE_COPY_KERNEL_CHUNK, 0);
+    if (rc > 0) {
+      *copied += (unsigned long long) rc;
+    } else if (rc == 0) {
+      /* hit end of file */
+      return SCR_SUCCESS;
+    } else if (errno != EINTR) {
+      /* not supported for these files, e.g., EXDEV or EINVAL */
+      scr_dbg(2, "copy_file_range(%s, %s) errno=%d %s @ %s:%d",
+        src_file, dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      break;
+    }
+  }
+#endif
+
+#ifdef HAVE_SENDFILE
+  while (1) {
+    ssize_t rc = sendfile(dst_fd, src_fd, NULL, SCR_FILE_COPY_KERNEL_CHUNK);
+    if (rc > 0) {
+      *copied += (unsigned long long) rc;
+    } else if (rc == 0) {
+      /* hit end of file */
+      return SCR_SUCCESS;
+    } else if (errno != EINTR) {
+      scr_dbg(2, "sendfile(%s, %s) errno=%d %s @ %s:%d",
+        src_file, dst_file, errno, strerror(errno), __FILE__, __LINE__
+      );
+      break;
+    }
+  }
+#endif
+
+  return SCR_FAILURE;
+}
+
+/* copy src_file to dst_file, the calling thread reads the source
+ * while a second thread writes the destination, the two overlap
+ * through a ring of num_bufs aligned buffers of buf_size bytes,
+ * direct is a bitmask of SCR_FILE_COPY_DIRECT_SRC/DST to open the
+ * source and/or destination with O_DIRECT if the file system allows,
+ * if neither file uses O_DIRECT, the kernel copies the file directly
+ * when possible, optionally computes the checksum of the file in ck,
+ * which the caller initializes with the algorithm to use */
+int scr_file_copy_pipeline(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
-  uLong* crc)
+  int num_bufs,
+  int direct,
+  scr_checksum* ck)
 {
   /* check that we got something for a source file */
   if (src_file == NULL || strcmp(src_file, "") == 0) {
@@ -937,7 +1173,7 @@ int scr_file_copy(
 
 #ifdef HAVE_LIBCPPR
   cppr_return_t cppr_retval = _scr_cppr_file_copy(
-    src_file, dst_file, buf_size, crc
+    src_file, dst_file, buf_size, ck
   );
 
   if (cppr_retval == CPPR_SUCCESS) {
@@ -952,8 +1188,22 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
   }
 #endif /* HAVE_LIBCPPR */
 
+  /* need at least two buffers to overlap reads and writes */
+  if (num_bufs < 2) {
+    num_bufs = 2;
+  }
+
+  /* O_DIRECT requires transfer sizes to be a multiple of the alignment */
+  if (buf_size < SCR_FILE_COPY_ALIGN) {
+    buf_size = SCR_FILE_COPY_ALIGN;
+  }
+  buf_size = (buf_size + SCR_FILE_COPY_ALIGN - 1) / SCR_FILE_COPY_ALIGN * SCR_FILE_COPY_ALIGN;
+
   /* open src_file for reading */
-  int src_fd = scr_open(src_file, O_RDONLY);
+  int src_direct;
+  int src_fd = scr_file_copy_open(src_file, O_RDONLY, 0,
+    (direct & SCR_FILE_COPY_DIRECT_SRC), &src_direct
+  );
   if (src_fd < 0) {
     scr_err("Opening file to copy: scr_open(%s) errno=%d %s @ %s:%d",
       src_file, errno, strerror(errno), __FILE__, __LINE__
@@ -962,8 +1212,11 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
   }
 
   /* open dest_file for writing */
+  int dst_direct;
   mode_t mode_file = scr_getmode(1, 1, 0);
-  int dst_fd = scr_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file);
+  int dst_fd = scr_file_copy_open(dst_file, O_WRONLY | O_CREAT | O_TRUNC, mode_file,
+    (direct & SCR_FILE_COPY_DIRECT_DST), &dst_direct
+  );
   if (dst_fd < 0) {
     scr_err("Opening file for writing: scr_open(%s) errno=%d %s @ %s:%d",
       dst_file, errno, strerror(errno), __FILE__, __LINE__
@@ -972,71 +1225,156 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
     return SCR_FAILURE;
   }
 
+  /* try to have the kernel copy the file, which avoids moving the data
+   * through user space, though we then need a separate pass to compute
+   * the checksum */
+  unsigned long long kernel_bytes = 0;
+  if (SCR_FILE_COPY_KERNEL && ! src_direct && ! dst_direct) {
+    if (scr_file_copy_kernel(src_file, src_fd, dst_file, dst_fd, &kernel_bytes) == SCR_SUCCESS) {
+      if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
+        rc = SCR_FAILURE;
+      }
+      scr_close(src_file, src_fd);
+
+      /* compute the checksum in a separate pass if the caller wants it */
+      if (rc == SCR_SUCCESS && ck != NULL) {
+        rc = scr_checksum_file_update(src_file, ck);
+      }
+
+      if (rc != SCR_SUCCESS) {
+        unlink(dst_file);
+      }
+      return rc;
+    }
+  }
+
+  /* if the kernel copied part of the file before failing, we copy the
+   * rest below and compute the checksum over the full file afterwards */
+  scr_checksum* ring_ck = ck;
+  if (kernel_bytes > 0) {
+    ring_ck = NULL;
+  }
+
 #if !defined(__APPLE__)
-  /* TODO:
-  posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL)
-  that tells the kernel that you don't ever need the pages
-  from the file again, and it won't bother keeping them in the page cache.
-  */
-  posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
-  posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  /* tell the kernel that we don't ever need the pages from the file
+   * again, so it won't bother keeping them in the page cache,
+   * this is moot for a file opened with O_DIRECT */
+  if (! src_direct) {
+    posix_fadvise(src_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  }
+  if (! dst_direct) {
+    posix_fadvise(dst_fd, 0, 0, POSIX_FADV_DONTNEED | POSIX_FADV_SEQUENTIAL);
+  }
 #endif
 
-  /* allocate buffer to read in file chunks */
-  char* buf = (char*) malloc(buf_size);
-  if (buf == NULL) {
-    scr_err("Allocating memory: malloc(%llu) errno=%d %s @ %s:%d",
-      buf_size, errno, strerror(errno), __FILE__, __LINE__
-    );
-    scr_close(dst_file, dst_fd);
-    scr_close(src_file, src_fd);
-    return SCR_FAILURE;
+  /* set up ring of buffers shared with the writer thread */
+  scr_file_copy_ring ring;
+  pthread_mutex_init(&ring.lock, NULL);
+  pthread_cond_init(&ring.cond, NULL);
+  ring.num_bufs   = num_bufs;
+  ring.buf_size   = (size_t) buf_size;
+  ring.bufs       = (char**)  SCR_MALLOC(num_bufs * sizeof(char*));
+  ring.counts     = (size_t*) SCR_MALLOC(num_bufs * sizeof(size_t));
+  ring.full       = (int*)    SCR_MALLOC(num_bufs * sizeof(int));
+  ring.error      = 0;
+  ring.dst_file   = dst_file;
+  ring.dst_fd     = dst_fd;
+  ring.dst_direct = dst_direct;
+
+  /* allocate aligned buffers to read in file chunks */
+  int i;
+  for (i = 0; i < num_bufs; i++) {
+    ring.counts[i] = 0;
+    ring.full[i]   = 0;
+    ring.bufs[i]   = (char*) scr_align_malloc(buf_size, SCR_FILE_COPY_ALIGN);
+    if (ring.bufs[i] == NULL) {
+      scr_err("Allocating memory: scr_align_malloc(%lu) errno=%d %s @ %s:%d",
+        buf_size, errno, strerror(errno), __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
   }
 
-  /* initialize crc values */
-  if (crc != NULL) {
-    *crc = crc32(0L, Z_NULL, 0);
+  /* start the writer */
+  pthread_t writer;
+  int writer_started = 0;
+  if (rc == SCR_SUCCESS) {
+    if (pthread_create(&writer, NULL, scr_file_copy_writer, &ring) == 0) {
+      writer_started = 1;
+    } else {
+      scr_err("Failed to start writer thread to copy %s @ %s:%d",
+        src_file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    }
   }
 
-  /* write chunks */
-  int copying = 1;
-  while (copying) {
-    /* attempt to read buf_size bytes from file */
-    int nread = scr_read_attempt(src_file, src_fd, buf, buf_size);
+  /* read chunks into the ring until we hit the end of the file */
+  int slot = 0;
+  int reading = writer_started;
+  while (reading) {
+    /* wait for the writer to drain the next buffer */
+    pthread_mutex_lock(&ring.lock);
+    while (ring.full[slot] && ! ring.error) {
+      pthread_cond_wait(&ring.cond, &ring.lock);
+    }
+    int error = ring.error;
+    pthread_mutex_unlock(&ring.lock);
 
-    /* if we read some bytes, write them out */
-    if (nread > 0) {
-      /* optionally compute crc value as we go */
-      if (crc != NULL) {
-        *crc = crc32(*crc, (const Bytef*) buf, (uInt) nread);
-      }
+    /* stop if the writer failed */
+    if (error) {
+      break;
+    }
 
-      /* write our nread bytes out */
-      int nwrite = scr_write_attempt(dst_file, dst_fd, buf, nread);
+    /* attempt to read buf_size bytes from file */
+    ssize_t nread = scr_file_copy_read(src_file, src_fd, src_direct, ring.bufs[slot], buf_size);
+    if (nread < 0) {
+      /* read had a problem, tell the writer to stop */
+      pthread_mutex_lock(&ring.lock);
+      ring.error = 1;
+      pthread_cond_broadcast(&ring.cond);
+      pthread_mutex_unlock(&ring.lock);
+      break;
+    }
 
-      /* check for a write error or a short write */
-      if (nwrite != nread) {
-        /* write had a problem, stop copying and return an error */
-        copying = 0;
-        rc = SCR_FAILURE;
-      }
+    /* optionally compute checksum as we go, this overlaps
+     * with the writer working on the previous buffer */
+    if (ring_ck != NULL && nread > 0) {
+      scr_checksum_update(ring_ck, ring.bufs[slot], (size_t) nread);
     }
 
-    /* assume a short read means we hit the end of the file */
-    if (nread < buf_size) {
-      copying = 0;
+    /* hand the buffer to the writer */
+    pthread_mutex_lock(&ring.lock);
+    ring.counts[slot] = (size_t) nread;
+    ring.full[slot] = 1;
+    pthread_cond_broadcast(&ring.cond);
+    pthread_mutex_unlock(&ring.lock);
+
+    /* a short read means we hit the end of the file */
+    if ((size_t) nread < buf_size) {
+      reading = 0;
     }
 
-    /* check for a read error, stop copying and return an error */
-    if (nread < 0) {
-      /* read had a problem, stop copying and return an error */
-      copying = 0;
+    slot = (slot + 1) % num_bufs;
+  }
+
+  /* wait for the writer to finish */
+  if (writer_started) {
+    pthread_join(writer, NULL);
+    if (ring.error) {
       rc = SCR_FAILURE;
     }
   }
 
-  /* free buffer */
-  scr_free(&buf);
+  /* free buffers */
+  for (i = 0; i < num_bufs; i++) {
+    scr_align_free(&ring.bufs[i]);
+  }
+  scr_free(&ring.bufs);
+  scr_free(&ring.counts);
+  scr_free(&ring.full);
+  pthread_cond_destroy(&ring.cond);
+  pthread_mutex_destroy(&ring.lock);
 
   /* close source and destination files */
   if (scr_close(dst_file, dst_fd) != SCR_SUCCESS) {
@@ -1046,6 +1384,11 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
     rc = SCR_FAILURE;
   }
 
+  /* compute the checksum in a separate pass if the kernel copied part of the file */
+  if (rc == SCR_SUCCESS && ck != NULL && ring_ck == NULL) {
+    rc = scr_checksum_file_update(src_file, ck);
+  }
+
   /* unlink the file if the copy failed */
   if (rc != SCR_SUCCESS) {
     unlink(dst_file);
@@ -1061,12 +1404,25 @@ cppr cppr_err=%d @ %s:%d", cppr_retval, __FILE__, __LINE__
   return rc;
 }
 
+/* copy src_file (full path) to dst_file (full path) using the default
+ * number of buffers and O_DIRECT settings */
+int scr_file_copy(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  scr_checksum* ck)
+{
+  return scr_file_copy_pipeline(src_file, dst_file, buf_size,
+    SCR_FILE_COPY_BUFS, SCR_FILE_COPY_DIRECT, ck
+  );
+}
+
 #ifdef HAVE_LIBCPPR
 cppr_return_t _scr_cppr_file_copy(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
-  uLong* crc)
+  scr_checksum* ck)
 {
   int src_len = 0;
   int dst_len = 0;
@@ -1186,8 +1542,8 @@ src_file '%s'",
 
   /* TODO: CPPR we need to figure out if CPPR can support this */
   /* perform crc check if necessary */
-  if (crc != NULL) {
-    int crc_retval = scr_crc32(dst_file, crc);
+  if (ck != NULL) {
+    int crc_retval = scr_checksum_file_update(dst_file, ck);
     if (crc_retval != SCR_SUCCESS) {
       scr_err("error computing crc value: %d @ %s:%d",
         crc_retval, __FILE__, __LINE__
@@ -19,6 +19,8 @@
 /* compute crc32 */
 #include <zlib.h>
 
+#include "scr_checksum.h"
+
 #ifndef SCR_MAX_LINE
 #define SCR_MAX_LINE (1024)
 #endif
@@ -132,11 +134,29 @@ File Copy Functions
 =========================================
 */
 
+/* bits for the direct argument of scr_file_copy_pipeline */
+#define SCR_FILE_COPY_DIRECT_SRC (0x1)
+#define SCR_FILE_COPY_DIRECT_DST (0x2)
+
+/* copy src_file to dst_file by overlapping reads and writes through
+ * a ring of num_bufs aligned buffers, direct is a bitmask selecting
+ * whether to open the source and/or destination with O_DIRECT,
+ * adds the file contents to checksum ck if ck is not NULL */
+int scr_file_copy_pipeline(
+  const char* src_file,
+  const char* dst_file,
+  unsigned long buf_size,
+  int num_bufs,
+  int direct,
+  scr_checksum* ck
+);
+
+/* copy src_file to dst_file with default settings */
 int scr_file_copy(
   const char* src_file,
   const char* dst_file,
   unsigned long buf_size,
-  uLong* crc
+  scr_checksum* ck
 );
 
 #endif
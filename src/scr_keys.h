@@ -53,6 +53,8 @@ Define common hash key strings
 #define SCR_KEY_RANKS     ("RANKS")
 #define SCR_KEY_DIRECTORY ("DIR")
 #define SCR_KEY_FILE      ("FILE")
+#define SCR_KEY_COMPRESS  ("COMPRESS")
+#define SCR_KEY_ORDER     ("ORDER")
 #define SCR_KEY_FILES     ("FILES")
 #define SCR_KEY_META      ("META")
 #define SCR_KEY_COMPLETE  ("COMPLETE")
@@ -182,7 +184,11 @@ Define common hash key strings
 #define SCR_META_KEY_NAME     ("NAME")
 #define SCR_META_KEY_SIZE     ("SIZE")
 #define SCR_META_KEY_CRC      ("CRC")
+#define SCR_META_KEY_CKSUM     ("CKSUM")
+#define SCR_META_KEY_READABLE  ("READABLE")
+#define SCR_META_KEY_CKSUM_ALG ("CKSUM_ALG")
 #define SCR_META_KEY_COMPLETE ("COMPLETE")
+#define SCR_META_KEY_ORDER    ("ORDER")
 #define SCR_META_KEY_MODE     ("MODE")
 #define SCR_META_KEY_UID      ("UID")
 #define SCR_META_KEY_GID      ("GID")
@@ -150,6 +150,13 @@ int scr_meta_set_complete(scr_meta* meta, int complete)
   return SCR_SUCCESS;
 }
 
+/* sets route order in meta data, overwrites any existing value with new value */
+int scr_meta_set_order(scr_meta* meta, int order)
+{
+  int rc = kvtree_util_set_int(meta, SCR_META_KEY_ORDER, order);
+  return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+}
+
 /* sets crc value in meta data, overwrites any existing value with new value */
 int scr_meta_set_crc32(scr_meta* meta, uLong crc)
 {
@@ -157,6 +164,16 @@ int scr_meta_set_crc32(scr_meta* meta, uLong crc)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* sets checksum value in meta data, overwrites any existing value with new value */
+int scr_meta_set_checksum(scr_meta* meta, const char* name, uint64_t value)
+{
+  char str[32];
+  snprintf(str, sizeof(str), "0x%llx", (unsigned long long) value);
+  kvtree_util_set_str(meta, SCR_META_KEY_CKSUM_ALG, name);
+  kvtree_util_set_str(meta, SCR_META_KEY_CKSUM, str);
+  return SCR_SUCCESS;
+}
+
 static void scr_stat_get_atimes(const struct stat* sb, uint64_t* secs, uint64_t* nsecs)
 {
     *secs = (uint64_t) sb->st_atime;
@@ -299,6 +316,13 @@ int scr_meta_get_complete(const scr_meta* meta, int* complete)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* get the route order field in meta data, returns SCR_SUCCESS if successful */
+int scr_meta_get_order(const scr_meta* meta, int* order)
+{
+  int rc = kvtree_util_get_int(meta, SCR_META_KEY_ORDER, order);
+  return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
+}
+
 /* get the crc32 field in meta data, returns SCR_SUCCESS if a field is set */
 int scr_meta_get_crc32(const scr_meta* meta, uLong* crc)
 {
@@ -306,6 +330,30 @@ int scr_meta_get_crc32(const scr_meta* meta, uLong* crc)
   return (rc == KVTREE_SUCCESS) ? SCR_SUCCESS : SCR_FAILURE;
 }
 
+/* get the checksum field in meta data, returns SCR_SUCCESS if a field is set */
+int scr_meta_get_checksum(const scr_meta* meta, char** name, uint64_t* value)
+{
+  char* alg;
+  char* str;
+  if (kvtree_util_get_str(meta, SCR_META_KEY_CKSUM_ALG, &alg) == KVTREE_SUCCESS &&
+      kvtree_util_get_str(meta, SCR_META_KEY_CKSUM, &str) == KVTREE_SUCCESS)
+  {
+    *name  = alg;
+    *value = (uint64_t) strtoull(str, NULL, 0);
+    return SCR_SUCCESS;
+  }
+
+  /* older datasets only recorded a crc32 */
+  uLong crc;
+  if (scr_meta_get_crc32(meta, &crc) == SCR_SUCCESS) {
+    *name  = (char*) SCR_CHECKSUM_CRC32;
+    *value = (uint64_t) crc;
+    return SCR_SUCCESS;
+  }
+
+  return SCR_FAILURE;
+}
+
 /*
 =========================================
 Check field values
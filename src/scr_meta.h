@@ -44,6 +44,8 @@
 /* compute crc32, needed for uLong */
 #include <zlib.h>
 
+#include <stdint.h>
+
 typedef kvtree scr_meta;
 
 /*
@@ -91,12 +93,19 @@ int scr_meta_set_filesize(scr_meta* meta, unsigned long filesize);
 /* set the completeness field on meta */
 int scr_meta_set_complete(scr_meta* meta, int complete);
 
+/* set the position of the file in the order the application routed
+ * the files of its dataset */
+int scr_meta_set_order(scr_meta* meta, int order);
+
 /* capture stat metadata (uid, gid, mode, atime, ctime, mtime) */
 int scr_meta_set_stat(scr_meta* meta, struct stat* statbuf);
 
 /* set the crc32 field on meta */
 int scr_meta_set_crc32(scr_meta* meta, uLong crc);
 
+/* set the checksum and the name of the algorithm used to compute it */
+int scr_meta_set_checksum(scr_meta* meta, const char* name, uint64_t value);
+
 /*
 =========================================
 Get field values
@@ -127,9 +136,17 @@ int scr_meta_get_filesize(const scr_meta* meta, unsigned long* filesize);
 /* get the completeness field in meta data, returns SCR_SUCCESS if successful */
 int scr_meta_get_complete(const scr_meta* meta, int* complete);
 
+/* get the route order field in meta data, returns SCR_SUCCESS if successful */
+int scr_meta_get_order(const scr_meta* meta, int* order);
+
 /* get the crc32 field in meta data, returns SCR_SUCCESS if a field is set */
 int scr_meta_get_crc32(const scr_meta* meta, uLong* crc);
 
+/* get the checksum and name of its algorithm, falls back to the crc32
+ * field for files recorded before checksums were introduced,
+ * returns SCR_SUCCESS if either is set */
+int scr_meta_get_checksum(const scr_meta* meta, char** name, uint64_t* value);
+
 /*
 =========================================
 Check field values
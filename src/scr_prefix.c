@@ -97,25 +97,20 @@ static int scr_prefix_delete_data(int id)
   spath* dataset_path = spath_from_str(scr_prefix_scr);
   spath_append_strf(dataset_path, "scr.dataset.%d", id);
 
-  /* TODO: this is stepping on Filo internals */
-  /* build path to rank2file */
-  spath* rank2file_path = spath_dup(dataset_path);
-  spath_append_str(rank2file_path, "rank2file");
-  const char* rank2file = spath_strdup(rank2file_path);
-  spath_delete(&rank2file_path);
+  char* dataset_dir = spath_strdup(dataset_path);
   spath_delete(&dataset_path);
 
   /* get the list of files to read */
   kvtree* filelist = kvtree_new();
-  if (kvtree_read_scatter(rank2file, filelist, scr_comm_world) != KVTREE_SUCCESS) {
+  if (scr_rank2file_read(dataset_dir, filelist, scr_comm_world) != SCR_SUCCESS) {
     /* failed to read list of files in this dataset */
-    scr_free(&rank2file);  
+    scr_free(&dataset_dir);
     kvtree_delete(&filelist);
     return SCR_FAILURE;
   }
 
-  /* done with rank2file */
-  scr_free(&rank2file);  
+  /* done with dataset directory */
+  scr_free(&dataset_dir);
 
   /* allocate list of file names */
   kvtree* files = kvtree_get(filelist, "FILE");
@@ -0,0 +1,553 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#include "scr_globals.h"
+#include "scr_rank2file_mpi.h"
+
+#include "kvtree.h"
+#include "kvtree_util.h"
+
+#include <stdint.h>
+#include <limits.h>
+
+/*
+=========================================
+Rank2file map functions
+=========================================
+*/
+
+/* The ranks of the job are divided into consecutive blocks, and the
+ * entries for each block are stored in a stripe file named
+ * rank2file.bin.<stripe> in the dataset directory.  Each stripe file
+ * holds a header, a table with the offset and length of the entry of
+ * each rank in the block, and then the entries themselves, each a
+ * packed kvtree.  All integers are stored in big-endian order.
+ *
+ * The header consists of:
+ *   8 bytes magic value
+ *   4 bytes version
+ *   4 bytes stripe id of this file
+ *   4 bytes number of stripe files
+ *   4 bytes number of ranks in each stripe
+ *   8 bytes number of ranks in the job
+ *   8 bytes first rank in this stripe
+ *   8 bytes number of ranks in this stripe */
+
+#define SCR_RANK2FILE_MAGIC   ("SCRR2FBN")
+#define SCR_RANK2FILE_VERSION (1)
+#define SCR_RANK2FILE_HEADER  (48)
+#define SCR_RANK2FILE_ENTRY   (16)
+
+/* name of the kvtree rank2file map written by earlier versions */
+#define SCR_RANK2FILE_KVTREE ("rank2file")
+
+/* returns path to given stripe file in dataset directory,
+ * caller must free the string */
+static char* scr_rank2file_name(const char* dir, int stripe)
+{
+  spath* path = spath_from_str(dir);
+  spath_append_strf(path, "rank2file.bin.%d", stripe);
+  char* file = spath_strdup(path);
+  spath_delete(&path);
+  return file;
+}
+
+/* collectively write the list of files for the calling rank to the
+ * rank2file map in the given dataset directory, the map is split into
+ * the given number of stripe files */
+int scr_rank2file_write(const char* dir, const kvtree* filelist, int stripes, MPI_Comm comm)
+{
+  int rc = SCR_SUCCESS;
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* assign consecutive blocks of ranks to each stripe,
+   * dropping any stripes that would be left empty */
+  if (stripes < 1) {
+    stripes = 1;
+  }
+  if (stripes > ranks) {
+    stripes = ranks;
+  }
+  int per_stripe = (ranks + stripes - 1) / stripes;
+  stripes = (ranks + per_stripe - 1) / per_stripe;
+
+  int stripe = rank / per_stripe;
+  int first  = stripe * per_stripe;
+  int count  = per_stripe;
+  if (first + count > ranks) {
+    count = ranks - first;
+  }
+
+  /* pack our entry */
+  size_t len = kvtree_pack_size(filelist);
+  char* data = (char*) SCR_MALLOC(len);
+  kvtree_pack(data, filelist);
+
+  /* get a communicator of the ranks that write to our stripe */
+  MPI_Comm stripe_comm;
+  MPI_Comm_split(comm, stripe, rank, &stripe_comm);
+  int stripe_rank;
+  MPI_Comm_rank(stripe_comm, &stripe_rank);
+
+  /* entries follow the header and table in rank order */
+  uint64_t mylen  = (uint64_t) len;
+  uint64_t offset = 0;
+  MPI_Exscan(&mylen, &offset, 1, MPI_UINT64_T, MPI_SUM, stripe_comm);
+  if (stripe_rank == 0) {
+    offset = 0;
+  }
+  offset += SCR_RANK2FILE_HEADER + (uint64_t) count * SCR_RANK2FILE_ENTRY;
+
+  /* fill in the header, only written by the first rank of the stripe */
+  unsigned char header[SCR_RANK2FILE_HEADER];
+  memcpy(header, SCR_RANK2FILE_MAGIC, 8);
+  scr_pack_be(header +  8, SCR_RANK2FILE_VERSION, 4);
+  scr_pack_be(header + 12, (uint64_t) stripe,     4);
+  scr_pack_be(header + 16, (uint64_t) stripes,    4);
+  scr_pack_be(header + 20, (uint64_t) per_stripe, 4);
+  scr_pack_be(header + 24, (uint64_t) ranks,      8);
+  scr_pack_be(header + 32, (uint64_t) first,      8);
+  scr_pack_be(header + 40, (uint64_t) count,      8);
+  int header_count = (stripe_rank == 0) ? SCR_RANK2FILE_HEADER : 0;
+
+  /* fill in our table entry */
+  unsigned char entry[SCR_RANK2FILE_ENTRY];
+  scr_pack_be(entry,     offset, 8);
+  scr_pack_be(entry + 8, mylen,  8);
+  MPI_Offset entry_offset = (MPI_Offset) SCR_RANK2FILE_HEADER + (MPI_Offset) stripe_rank * SCR_RANK2FILE_ENTRY;
+
+  /* write everything to the stripe file */
+  char* file = scr_rank2file_name(dir, stripe);
+  MPI_File fh;
+  MPI_Status status;
+  if (MPI_File_open(stripe_comm, file, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &fh) == MPI_SUCCESS) {
+    /* discard the contents of any earlier file */
+    if (MPI_File_set_size(fh, 0) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    if (MPI_File_write_at_all(fh, 0, header, header_count, MPI_BYTE, &status) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    if (MPI_File_write_at_all(fh, entry_offset, entry, SCR_RANK2FILE_ENTRY, MPI_BYTE, &status) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    if (MPI_File_write_at_all(fh, (MPI_Offset) offset, data, (int) len, MPI_BYTE, &status) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    if (MPI_File_close(&fh) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to write rank2file map %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+  }
+
+  scr_free(&file);
+  scr_free(&data);
+  MPI_Comm_free(&stripe_comm);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* read header of first stripe file, returns SCR_FAILURE if the file
+ * can't be read or is not a rank2file manifest */
+static int scr_rank2file_read_header(const char* dir, uint64_t* stripes, uint64_t* per_stripe, uint64_t* ranks)
+{
+  char* file = scr_rank2file_name(dir, 0);
+
+  int rc = SCR_SUCCESS;
+  int fd = scr_open(file, O_RDONLY);
+  if (fd >= 0) {
+    unsigned char header[SCR_RANK2FILE_HEADER];
+    ssize_t nread = scr_read(file, fd, header, sizeof(header));
+    if (nread != sizeof(header) ||
+        memcmp(header, SCR_RANK2FILE_MAGIC, 8) != 0 ||
+        scr_unpack_be(header + 8, 4) != SCR_RANK2FILE_VERSION)
+    {
+      scr_err("Invalid rank2file map %s @ %s:%d",
+        file, __FILE__, __LINE__
+      );
+      rc = SCR_FAILURE;
+    } else {
+      *stripes    = scr_unpack_be(header + 16, 4);
+      *per_stripe = scr_unpack_be(header + 20, 4);
+      *ranks      = scr_unpack_be(header + 24, 8);
+    }
+    scr_close(file, fd);
+  } else {
+    scr_err("Opening rank2file map for read: scr_open(%s) errno=%d %s @ %s:%d",
+      file, errno, strerror(errno), __FILE__, __LINE__
+    );
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&file);
+  return rc;
+}
+
+/* collectively look up the number of ranks in each stripe of the
+ * binary manifest in the given dataset directory and the number of
+ * ranks in the job that wrote it, sets per_stripe to 0 if there is
+ * no manifest, returns SCR_FAILURE if the manifest can't be read */
+int scr_rank2file_layout(const char* dir, MPI_Comm comm, unsigned long* per_stripe, unsigned long* map_ranks)
+{
+  *per_stripe = 0;
+  *map_ranks  = 0;
+
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* rank 0 reads the layout of the manifest and broadcasts it,
+   * the first value records whether the manifest exists */
+  uint64_t layout[4] = {0, 0, 0, 0};
+  if (rank == 0) {
+    char* file = scr_rank2file_name(dir, 0);
+    if (scr_file_exists(file) == SCR_SUCCESS) {
+      layout[0] = 1;
+      if (scr_rank2file_read_header(dir, &layout[1], &layout[2], &layout[3]) != SCR_SUCCESS) {
+        layout[0] = 2;
+      }
+    }
+    scr_free(&file);
+  }
+  MPI_Bcast(layout, 4, MPI_UINT64_T, 0, comm);
+
+  /* no manifest */
+  if (layout[0] == 0) {
+    return SCR_SUCCESS;
+  }
+
+  /* found a manifest, but failed to read its header */
+  if (layout[0] != 1) {
+    return SCR_FAILURE;
+  }
+
+  if (layout[2] == 0 || layout[3] == 0) {
+    if (rank == 0) {
+      scr_err("Invalid layout in rank2file map in %s @ %s:%d",
+        dir, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
+  *per_stripe = (unsigned long) layout[2];
+  *map_ranks  = (unsigned long) layout[3];
+  return SCR_SUCCESS;
+}
+
+/* read the entry of the given rank from the binary manifest in the
+ * given dataset directory with POSIX I/O and merge it into filelist,
+ * per_stripe comes from scr_rank2file_layout, this is not collective */
+int scr_rank2file_read_rank(const char* dir, int rank, unsigned long per_stripe, kvtree* filelist)
+{
+  if (per_stripe == 0) {
+    return SCR_FAILURE;
+  }
+
+  int stripe      = (int) ((unsigned long) rank / per_stripe);
+  int stripe_rank = (int) ((unsigned long) rank % per_stripe);
+  char* file = scr_rank2file_name(dir, stripe);
+
+  int rc = SCR_SUCCESS;
+  int fd = scr_open(file, O_RDONLY);
+  if (fd >= 0) {
+    /* look up our entry in the table */
+    unsigned char entry[SCR_RANK2FILE_ENTRY];
+    off_t entry_offset = (off_t) SCR_RANK2FILE_HEADER + (off_t) stripe_rank * SCR_RANK2FILE_ENTRY;
+    if (scr_lseek(file, fd, entry_offset, SEEK_SET) != SCR_SUCCESS ||
+        scr_read(file, fd, entry, sizeof(entry)) != sizeof(entry))
+    {
+      rc = SCR_FAILURE;
+    }
+
+    /* read just our entry */
+    if (rc == SCR_SUCCESS) {
+      uint64_t offset = scr_unpack_be(entry,     8);
+      uint64_t len    = scr_unpack_be(entry + 8, 8);
+      if (len == 0 || len > (uint64_t) INT_MAX) {
+        rc = SCR_FAILURE;
+      } else {
+        char* data = (char*) SCR_MALLOC((size_t) len);
+        if (scr_lseek(file, fd, (off_t) offset, SEEK_SET) == SCR_SUCCESS &&
+            scr_read(file, fd, data, (size_t) len) == (ssize_t) len)
+        {
+          kvtree* tmp = kvtree_new();
+          kvtree_unpack(data, tmp);
+          kvtree_merge(filelist, tmp);
+          kvtree_delete(&tmp);
+        } else {
+          rc = SCR_FAILURE;
+        }
+        scr_free(&data);
+      }
+    }
+
+    scr_close(file, fd);
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to read entry for rank %d from rank2file map %s @ %s:%d",
+      rank, file, __FILE__, __LINE__
+    );
+  }
+
+  scr_free(&file);
+  return rc;
+}
+
+/* read the whole stripe file with the given id from the binary manifest
+ * in the given dataset directory with POSIX I/O into a newly allocated
+ * buffer, caller must free buf, this is not collective */
+int scr_rank2file_load_stripe(const char* dir, int stripe, char** buf, size_t* size)
+{
+  *buf  = NULL;
+  *size = 0;
+
+  char* file = scr_rank2file_name(dir, stripe);
+
+  int rc = SCR_SUCCESS;
+  off_t filesize = (off_t) scr_file_size(file);
+  if (filesize < SCR_RANK2FILE_HEADER) {
+    rc = SCR_FAILURE;
+  } else {
+    int fd = scr_open(file, O_RDONLY);
+    if (fd >= 0) {
+      *buf = (char*) SCR_MALLOC((size_t) filesize);
+      if (scr_read(file, fd, *buf, (size_t) filesize) == (ssize_t) filesize) {
+        *size = (size_t) filesize;
+      } else {
+        scr_free(buf);
+        rc = SCR_FAILURE;
+      }
+      scr_close(file, fd);
+    } else {
+      rc = SCR_FAILURE;
+    }
+  }
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to read rank2file map %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+  }
+
+  scr_free(&file);
+  return rc;
+}
+
+/* collectively hand out the entries of a stripe file loaded with
+ * scr_rank2file_load_stripe on rank 0 of stripe_comm to the ranks of
+ * that stripe and merge each entry into filelist, valid is 0 on rank 0
+ * if it failed to load the stripe, returns SCR_SUCCESS on all procs
+ * in stripe_comm if all procs got their entry */
+int scr_rank2file_scatter_stripe(const char* buf, size_t size, int valid, kvtree* filelist, MPI_Comm stripe_comm)
+{
+  int rank, ranks;
+  MPI_Comm_rank(stripe_comm, &rank);
+  MPI_Comm_size(stripe_comm, &ranks);
+
+  /* rank 0 looks up the offset and length of each entry in the table */
+  int* counts = NULL;
+  int* displs = NULL;
+  if (rank == 0) {
+    counts = (int*) SCR_MALLOC(ranks * sizeof(int));
+    displs = (int*) SCR_MALLOC(ranks * sizeof(int));
+
+    /* check that the stripe holds one entry for each of us */
+    const unsigned char* header = (const unsigned char*) buf;
+    size_t table_end = SCR_RANK2FILE_HEADER + (size_t) ranks * SCR_RANK2FILE_ENTRY;
+    if (valid &&
+        (size < table_end ||
+         memcmp(header, SCR_RANK2FILE_MAGIC, 8) != 0 ||
+         scr_unpack_be(header + 8, 4) != SCR_RANK2FILE_VERSION ||
+         scr_unpack_be(header + 40, 8) != (uint64_t) ranks))
+    {
+      valid = 0;
+    }
+
+    int i;
+    for (i = 0; i < ranks; i++) {
+      counts[i] = 0;
+      displs[i] = 0;
+      if (valid) {
+        const unsigned char* entry = header + SCR_RANK2FILE_HEADER + (size_t) i * SCR_RANK2FILE_ENTRY;
+        uint64_t offset = scr_unpack_be(entry,     8);
+        uint64_t len    = scr_unpack_be(entry + 8, 8);
+        if (len == 0 || offset + len > (uint64_t) size || offset + len > (uint64_t) INT_MAX) {
+          valid = 0;
+        } else {
+          counts[i] = (int) len;
+          displs[i] = (int) offset;
+        }
+      }
+    }
+
+    /* don't send anything if any entry is bad */
+    if (! valid) {
+      for (i = 0; i < ranks; i++) {
+        counts[i] = 0;
+        displs[i] = 0;
+      }
+    }
+  }
+
+  /* send each rank its entry */
+  int len;
+  MPI_Scatter(counts, 1, MPI_INT, &len, 1, MPI_INT, 0, stripe_comm);
+  char* data = NULL;
+  if (len > 0) {
+    data = (char*) SCR_MALLOC((size_t) len);
+  }
+  MPI_Scatterv((void*) buf, counts, displs, MPI_BYTE, data, len, MPI_BYTE, 0, stripe_comm);
+
+  int rc = SCR_SUCCESS;
+  if (len > 0) {
+    kvtree* tmp = kvtree_new();
+    kvtree_unpack(data, tmp);
+    kvtree_merge(filelist, tmp);
+    kvtree_delete(&tmp);
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  scr_free(&data);
+  scr_free(&displs);
+  scr_free(&counts);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, stripe_comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* collectively read the list of files for the calling rank from the
+ * rank2file map in the given dataset directory and merge it into
+ * filelist, falls back to the kvtree rank2file map written by
+ * earlier versions and by scr_index if there is no binary manifest */
+int scr_rank2file_read(const char* dir, kvtree* filelist, MPI_Comm comm)
+{
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* look up the layout of the manifest */
+  unsigned long per_stripe, map_ranks;
+  if (scr_rank2file_layout(dir, comm, &per_stripe, &map_ranks) != SCR_SUCCESS) {
+    return SCR_FAILURE;
+  }
+
+  /* no manifest, read the kvtree map instead */
+  if (per_stripe == 0) {
+    spath* path = spath_from_str(dir);
+    spath_append_str(path, SCR_RANK2FILE_KVTREE);
+    char* rank2file = spath_strdup(path);
+    spath_delete(&path);
+
+    int rc = SCR_SUCCESS;
+    if (kvtree_read_scatter(rank2file, filelist, comm) != KVTREE_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    scr_free(&rank2file);
+    return rc;
+  }
+
+  if (map_ranks != (unsigned long) ranks) {
+    if (rank == 0) {
+      scr_err("Rank2file map in %s is for %lu ranks but job has %d ranks @ %s:%d",
+        dir, map_ranks, ranks, __FILE__, __LINE__
+      );
+    }
+    return SCR_FAILURE;
+  }
+
+  int rc = SCR_SUCCESS;
+
+  /* get a communicator of the ranks that read from our stripe */
+  int stripe = (int) ((uint64_t) rank / per_stripe);
+  MPI_Comm stripe_comm;
+  MPI_Comm_split(comm, stripe, rank, &stripe_comm);
+  int stripe_rank;
+  MPI_Comm_rank(stripe_comm, &stripe_rank);
+
+  char* file = scr_rank2file_name(dir, stripe);
+  MPI_File fh;
+  MPI_Status status;
+  if (MPI_File_open(stripe_comm, file, MPI_MODE_RDONLY, MPI_INFO_NULL, &fh) == MPI_SUCCESS) {
+    /* look up our entry in the table */
+    unsigned char entry[SCR_RANK2FILE_ENTRY];
+    MPI_Offset entry_offset = (MPI_Offset) SCR_RANK2FILE_HEADER + (MPI_Offset) stripe_rank * SCR_RANK2FILE_ENTRY;
+    if (MPI_File_read_at_all(fh, entry_offset, entry, SCR_RANK2FILE_ENTRY, MPI_BYTE, &status) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    /* read just our entry */
+    uint64_t offset = scr_unpack_be(entry,     8);
+    uint64_t len    = scr_unpack_be(entry + 8, 8);
+    char* data = NULL;
+    if (rc != SCR_SUCCESS || len == 0 || len > (uint64_t) INT_MAX) {
+      rc  = SCR_FAILURE;
+      len = 0;
+    } else {
+      data = (char*) SCR_MALLOC((size_t) len);
+    }
+
+    /* everyone in the stripe must take part even if their entry is bad */
+    if (MPI_File_read_at_all(fh, (MPI_Offset) offset, data, (int) len, MPI_BYTE, &status) != MPI_SUCCESS) {
+      rc = SCR_FAILURE;
+    }
+
+    if (rc == SCR_SUCCESS) {
+      kvtree* tmp = kvtree_new();
+      kvtree_unpack(data, tmp);
+      kvtree_merge(filelist, tmp);
+      kvtree_delete(&tmp);
+    }
+
+    scr_free(&data);
+    MPI_File_close(&fh);
+  } else {
+    rc = SCR_FAILURE;
+  }
+
+  if (rc != SCR_SUCCESS) {
+    scr_err("Failed to read rank2file map %s @ %s:%d",
+      file, __FILE__, __LINE__
+    );
+  }
+
+  scr_free(&file);
+  MPI_Comm_free(&stripe_comm);
+
+  if (! scr_alltrue(rc == SCR_SUCCESS, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
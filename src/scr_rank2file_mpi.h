@@ -0,0 +1,62 @@
+/*
+ * Copyright (c) 2009, Lawrence Livermore National Security, LLC.
+ * Produced at the Lawrence Livermore National Laboratory.
+ * Written by Adam Moody <moody20@llnl.gov>.
+ * LLNL-CODE-411039.
+ * All rights reserved.
+ * This file is part of The Scalable Checkpoint / Restart (SCR) library.
+ * For details, see https://sourceforge.net/projects/scalablecr/
+ * Please also read this file: LICENSE.TXT.
+*/
+
+#ifndef SCR_RANK2FILE_MPI_H
+#define SCR_RANK2FILE_MPI_H
+
+#include "mpi.h"
+#include "kvtree.h"
+
+/*
+=========================================
+This file reads and writes the rank2file map of a dataset, which lists
+the files each rank wrote.  The map is stored in the dataset directory
+as a binary manifest that is written with MPI-IO and from which each
+rank reads only its own entry.
+=========================================
+*/
+
+/* collectively write the list of files for the calling rank to the
+ * rank2file map in the given dataset directory, the map is split into
+ * the given number of stripe files */
+int scr_rank2file_write(const char* dir, const kvtree* filelist, int stripes, MPI_Comm comm);
+
+/* collectively look up the number of ranks in each stripe of the
+ * binary manifest in the given dataset directory and the number of
+ * ranks in the job that wrote it, sets per_stripe to 0 if there is
+ * no manifest, returns SCR_FAILURE if the manifest can't be read */
+int scr_rank2file_layout(const char* dir, MPI_Comm comm, unsigned long* per_stripe, unsigned long* map_ranks);
+
+/* read the entry of the given rank from the binary manifest in the
+ * given dataset directory with POSIX I/O and merge it into filelist,
+ * per_stripe comes from scr_rank2file_layout, this is not collective,
+ * so it may be called from a background thread */
+int scr_rank2file_read_rank(const char* dir, int rank, unsigned long per_stripe, kvtree* filelist);
+
+/* read the whole stripe file with the given id from the binary manifest
+ * in the given dataset directory with POSIX I/O into a newly allocated
+ * buffer, caller must free buf, this is not collective */
+int scr_rank2file_load_stripe(const char* dir, int stripe, char** buf, size_t* size);
+
+/* collectively hand out the entries of a stripe file loaded with
+ * scr_rank2file_load_stripe on rank 0 of stripe_comm to the ranks of
+ * that stripe and merge each entry into filelist, valid is 0 on rank 0
+ * if it failed to load the stripe, returns SCR_SUCCESS on all procs
+ * in stripe_comm if all procs got their entry */
+int scr_rank2file_scatter_stripe(const char* buf, size_t size, int valid, kvtree* filelist, MPI_Comm stripe_comm);
+
+/* collectively read the list of files for the calling rank from the
+ * rank2file map in the given dataset directory and merge it into
+ * filelist, falls back to the kvtree rank2file map written by
+ * earlier versions and by scr_index if there is no binary manifest */
+int scr_rank2file_read(const char* dir, kvtree* filelist, MPI_Comm comm);
+
+#endif
@@ -22,6 +22,8 @@
 
 #include "scr_globals.h"
 
+#include <pthread.h>
+
 /*
 =========================================
 Redundancy descriptor functions
@@ -498,12 +500,158 @@ static int scr_reddesc_apply_to_filemap(const scr_reddesc* desc, int id, const s
   return rc;
 }
 
-/* apply redundancy scheme to files */
-int scr_reddesc_apply(
+/* encode given files using redundancy scheme, storing redundancy data
+ * under reddesc_dir, returns SCR_SUCCESS if all procs in comm_world succeed */
+static int scr_reddesc_encode_files(
+  const scr_reddesc* desc,
+  const char* reddesc_dir,
+  MPI_Comm comm_world,
+  MPI_Comm comm_store,
+  int num_files,
+  const char** files)
+{
+  /* create ER set */
+  int set_id = ER_Create(comm_world, comm_store, reddesc_dir, ER_DIRECTION_ENCODE, desc->er_scheme);
+  if (set_id < 0) {
+    scr_err("Failed to create ER set @ %s:%d",
+            __FILE__, __LINE__
+    );
+  }
+
+  /* add each of my files to the set */
+  int valid = 1;
+  int i;
+  for (i = 0; i < num_files; i++) {
+    if (ER_Add(set_id, files[i]) != ER_SUCCESS) {
+      scr_err("Failed to add file to ER set: %s @ %s:%d", files[i], __FILE__, __LINE__);
+      valid = 0;
+    }
+  }
+
+  /* determine whether everyone's files are good */
+  int all_valid = scr_alltrue(valid, comm_world);
+  if (! all_valid) {
+    if (scr_my_rank_world == 0) {
+      scr_dbg(1, "Exiting copy since one or more checkpoint files is invalid");
+    }
+    ER_Free(set_id);
+    return SCR_FAILURE;
+  }
+
+  /* apply the redundancy scheme */
+  int rc = SCR_SUCCESS;
+  if (ER_Dispatch(set_id) != ER_SUCCESS) {
+    scr_err("ER_Dispatch failed @ %s:%d", __FILE__, __LINE__);
+    rc = SCR_FAILURE;
+  }
+  if (ER_Wait(set_id) != ER_SUCCESS) {
+    scr_err("ER_Wait failed @ %s:%d", __FILE__, __LINE__);
+    rc = SCR_FAILURE;
+  }
+  if (ER_Free(set_id) != ER_SUCCESS) {
+    scr_err("ER_Free failed @ %s:%d", __FILE__, __LINE__);
+    rc = SCR_FAILURE;
+  }
+
+  /* determine whether everyone succeeded in their copy */
+  int valid_copy = (rc == SCR_SUCCESS);
+  if (! valid_copy) {
+    scr_err("scr_copy_files failed with return code %d @ %s:%d",
+            rc, __FILE__, __LINE__
+    );
+  }
+  int all_valid_copy = scr_alltrue(valid_copy, comm_world);
+  rc = all_valid_copy ? SCR_SUCCESS : SCR_FAILURE;
+
+  return rc;
+}
+
+/* stop timer and report performance info for encoding a dataset */
+static void scr_reddesc_apply_report(
+  const scr_reddesc* desc,
+  int id,
+  time_t timestamp_start,
+  double time_start,
+  double bytes,
+  int files)
+{
+  if (scr_my_rank_world == 0) {
+    double time_end = MPI_Wtime();
+    double time_diff = time_end - time_start;
+    double bw = 0.0;
+    if (time_diff > 0.0) {
+      bw = bytes / (1024.0 * 1024.0 * time_diff);
+    }
+    scr_dbg(1, "scr_reddesc_apply: %f secs, %e bytes, %f MB/s, %f MB/s per proc",
+            time_diff, bytes, bw, bw/scr_ranks_world
+    );
+
+    /* log data on the copy in the database */
+    if (scr_log_enable) {
+      char* dir = scr_cache_dir_get(desc, id);
+      scr_log_transfer("ENCODE", desc->base, dir, &id, NULL, &timestamp_start, &time_diff, &bytes, &files);
+      scr_free(&dir);
+    }
+  }
+}
+
+/* state of a dataset being encoded in the background */
+typedef struct {
+  int id;                    /* dataset id */
+  const scr_reddesc* desc;   /* redundancy descriptor */
+  char* reddesc_dir;         /* prefix for redundancy files */
+  int num_files;             /* number of files to encode */
+  char** files;              /* list of files to encode */
+  MPI_Comm comm_world;       /* dup of scr_comm_world for the thread */
+  MPI_Comm comm_store;       /* dup of store descriptor comm for the thread */
+  pthread_t thread;          /* thread running the encoding */
+  int rc;                    /* result of encoding, valid after thread exits */
+  int total_files;           /* total number of files across procs */
+  double bytes;              /* total number of bytes across procs */
+  time_t timestamp_start;    /* time encoding started, for logging */
+  double time_start;
+} scr_reddesc_encode_state;
+
+/* dataset currently being encoded in the background, if any */
+static scr_reddesc_encode_state* scr_reddesc_encode = NULL;
+
+static void scr_reddesc_encode_state_free(scr_reddesc_encode_state** ptr_st)
+{
+  scr_reddesc_encode_state* st = *ptr_st;
+  int i;
+  for (i = 0; i < st->num_files; i++) {
+    scr_free(&st->files[i]);
+  }
+  scr_free(&st->files);
+  scr_free(&st->reddesc_dir);
+  MPI_Comm_free(&st->comm_store);
+  MPI_Comm_free(&st->comm_world);
+  scr_free(ptr_st);
+}
+
+/* background thread to encode files */
+static void* scr_reddesc_encode_thread(void* arg)
+{
+  scr_reddesc_encode_state* st = (scr_reddesc_encode_state*) arg;
+  st->rc = scr_reddesc_encode_files(st->desc, st->reddesc_dir, st->comm_world, st->comm_store,
+    st->num_files, (const char**) st->files
+  );
+  return NULL;
+}
+
+/* checks files, encodes the filemap, and then encodes the files
+ * either in this thread or, if async is set, in a background thread,
+ * sets started to 1 if the encoding is running in the background */
+static int scr_reddesc_apply_impl(
   scr_filemap* map,
   const scr_reddesc* desc,
-  int id)
+  int id,
+  const kvtree* state,
+  int async,
+  int* started)
 {
+  *started = 0;
+
   /* start timer */
   time_t timestamp_start;
   double time_start;
@@ -525,19 +673,26 @@ int scr_reddesc_apply(
     char* file = kvtree_elem_key(file_elem);
 
     /* check the file */
-    if (! scr_bool_have_file(map, file)) {
+    if (! scr_bool_have_file(map, file, state)) {
       scr_dbg(2, "File determined to be invalid: %s", file);
       valid = 0;
     }
 
-    /* add up the number of files and bytes on our way through */
+    /* add up the number of files and bytes on our way through,
+     * use the size we cached when the output was completed if we have it */
+    unsigned long filesize;
+    kvtree* file_state = scr_file_state_get(state, file);
+    if (file_state == NULL || scr_meta_get_filesize(file_state, &filesize) != SCR_SUCCESS) {
+      filesize = scr_file_size(file);
+    }
     my_counts[0] += 1;
-    my_counts[1] += scr_file_size(file);
+    my_counts[1] += filesize;
+  }
 
-    /* if crc_on_copy is set, compute crc and update meta file */
-    if (scr_crc_on_copy) {
-      scr_compute_crc(map, file);
-    }
+  /* if crc_on_copy is set, compute checksums of all files
+   * concurrently and update meta data */
+  if (scr_crc_on_copy) {
+    scr_compute_crcs(map);
   }
 
   /* record valid flag, we'll sum these up to determine if all ranks are valid */
@@ -579,108 +734,183 @@ int scr_reddesc_apply(
     return SCR_SUCCESS;
   }
 
+  /* get list of files to encode */
+  int num_files = 0;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    num_files++;
+  }
+  char** file_list = (char**) SCR_MALLOC(num_files * sizeof(char*));
+  int i = 0;
+  for (file_elem = scr_filemap_first_file(map);
+       file_elem != NULL;
+       file_elem = kvtree_elem_next(file_elem))
+  {
+    file_list[i] = strdup(kvtree_elem_key(file_elem));
+    i++;
+  }
+
   /* define path for hidden directory */
   const char* dir_hidden = scr_cache_dir_hidden_get(desc, id);
 
   /* define path to er files */
   char* reddesc_dir = scr_reddesc_prefix(dir_hidden);
-
-  /* create ER set */
-  int set_id = ER_Create(scr_comm_world, store->comm, reddesc_dir, ER_DIRECTION_ENCODE, desc->er_scheme);
-  if (set_id < 0) {
-    scr_err("Failed to create ER set @ %s:%d",
-            __FILE__, __LINE__
-    );
-  }
-
-  /* free directory path strings */
-  scr_free(&reddesc_dir);
   scr_free(&dir_hidden);
- 
-  /* step through each of my files for the specified dataset
-   * to scan for any incomplete files */
-  for (file_elem = scr_filemap_first_file(map);
-       file_elem != NULL;
-       file_elem = kvtree_elem_next(file_elem))
-  {
-    /* get the filename */
-    char* file = kvtree_elem_key(file_elem);
 
-    /* add file to the set */
-    if (ER_Add(set_id, file) != ER_SUCCESS) {
-      scr_err("Failed to add file to ER set: %s @ %s:%d", file, __FILE__, __LINE__);
-      valid = 0;
+  /* the redundancy encoding can only run in the background if MPI
+   * allows us to call it from multiple threads */
+  if (async) {
+    int provided;
+    MPI_Query_thread(&provided);
+    if (provided < MPI_THREAD_MULTIPLE) {
+      if (scr_my_rank_world == 0) {
+        scr_dbg(1, "MPI_THREAD_MULTIPLE is required to encode in the background, encoding dataset %d now",
+          id
+        );
+      }
+      async = 0;
     }
   }
 
-#if 0
-  /* include filemap as protected file */
-  const char* mapfile_str = scr_cache_get_map_file(scr_cindex, id);
-  if (ER_Add(set_id, mapfile_str) != ER_SUCCESS) {
-    scr_err("Failed to add map file to ER set: %s @ %s:%d", mapfile_str, __FILE__, __LINE__);
-    valid = 0;
-  }
-  scr_free(&mapfile_str);
-#endif
+  if (async) {
+    /* hand off files to a background thread, which uses its own
+     * communicators so it does not interfere with the application */
+    scr_reddesc_encode_state* st = (scr_reddesc_encode_state*) SCR_MALLOC(sizeof(scr_reddesc_encode_state));
+    st->id          = id;
+    st->desc        = desc;
+    st->reddesc_dir = reddesc_dir;
+    st->num_files   = num_files;
+    st->files       = file_list;
+    st->rc          = SCR_FAILURE;
+    st->total_files = files;
+    st->bytes       = bytes;
+    st->timestamp_start = timestamp_start;
+    st->time_start      = time_start;
+    MPI_Comm_dup(scr_comm_world, &st->comm_world);
+    MPI_Comm_dup(store->comm, &st->comm_store);
+
+    /* mark dataset as encoding in the cache index, so that a restart
+     * knows not to trust its redundancy data if we fail before finishing */
+    scr_cache_index_set_encoding(scr_cindex, id, 1);
+    scr_cache_index_write(scr_cindex_file, scr_cindex);
+
+    int thread_rc = pthread_create(&st->thread, NULL, scr_reddesc_encode_thread, st);
+    if (! scr_alltrue(thread_rc == 0, scr_comm_world)) {
+      /* someone failed to start a thread, wait for those that did and
+       * report a failure */
+      if (thread_rc == 0) {
+        pthread_join(st->thread, NULL);
+      } else {
+        scr_err("Failed to start thread to encode dataset %d @ %s:%d",
+          id, __FILE__, __LINE__
+        );
+      }
+      scr_reddesc_encode_state_free(&st);
 
-  /* determine whether everyone's files are good */
-  int all_valid = scr_alltrue(valid, scr_comm_world);
-  if (! all_valid) {
-    if (scr_my_rank_world == 0) {
-      scr_dbg(1, "Exiting copy since one or more checkpoint files is invalid");
+      /* no encode is in flight after all */
+      scr_cache_index_set_encoding(scr_cindex, id, 0);
+      scr_cache_index_write(scr_cindex_file, scr_cindex);
+      return SCR_FAILURE;
     }
-    ER_Free(set_id);
-    return SCR_FAILURE;
+
+    scr_reddesc_encode = st;
+    *started = 1;
+    return SCR_SUCCESS;
   }
 
-  /* apply the redundancy scheme */
-  int rc = SCR_SUCCESS;
-  if (ER_Dispatch(set_id) != ER_SUCCESS) {
-    scr_err("ER_Dispatch failed @ %s:%d", __FILE__, __LINE__);
-    rc = SCR_FAILURE;
+  /* encode files in this thread */
+  int rc = scr_reddesc_encode_files(desc, reddesc_dir, scr_comm_world, store->comm,
+    num_files, (const char**) file_list
+  );
+
+  /* report performance info */
+  scr_reddesc_apply_report(desc, id, timestamp_start, time_start, bytes, files);
+
+  /* free file list */
+  for (i = 0; i < num_files; i++) {
+    scr_free(&file_list[i]);
   }
-  if (ER_Wait(set_id) != ER_SUCCESS) {
-    scr_err("ER_Wait failed @ %s:%d", __FILE__, __LINE__);
-    rc = SCR_FAILURE;
+  scr_free(&file_list);
+  scr_free(&reddesc_dir);
+
+  return rc;
+}
+
+/* apply redundancy scheme to files */
+int scr_reddesc_apply(
+  scr_filemap* map,
+  const scr_reddesc* desc,
+  int id,
+  const kvtree* state)
+{
+  int started;
+  return scr_reddesc_apply_impl(map, desc, id, state, 0, &started);
+}
+
+/* apply redundancy scheme to files, encoding the files in the background */
+int scr_reddesc_apply_async(
+  scr_filemap* map,
+  const scr_reddesc* desc,
+  int id,
+  const kvtree* state,
+  int* started)
+{
+  /* we only track one background encoding at a time */
+  if (scr_reddesc_encode != NULL) {
+    int wait_id;
+    scr_reddesc_apply_wait(&wait_id);
   }
-  if (ER_Free(set_id) != ER_SUCCESS) {
-    scr_err("ER_Free failed @ %s:%d", __FILE__, __LINE__);
-    rc = SCR_FAILURE;
+
+  return scr_reddesc_apply_impl(map, desc, id, state, 1, started);
+}
+
+/* returns id of dataset being encoded in the background, or -1 if none */
+int scr_reddesc_apply_encoding(void)
+{
+  if (scr_reddesc_encode == NULL) {
+    return -1;
   }
+  return scr_reddesc_encode->id;
+}
 
-  /* determine whether everyone succeeded in their copy */
-  int valid_copy = (rc == SCR_SUCCESS);
-  if (! valid_copy) {
-    scr_err("scr_copy_files failed with return code %d @ %s:%d",
-            rc, __FILE__, __LINE__
-    );
+/* wait for background encoding to finish, sets id to the dataset
+ * that was encoded or -1 if none was running, returns SCR_SUCCESS
+ * if all procs encoded their files */
+int scr_reddesc_apply_wait(int* id)
+{
+  *id = -1;
+
+  scr_reddesc_encode_state* st = scr_reddesc_encode;
+  if (st == NULL) {
+    return SCR_SUCCESS;
   }
-  int all_valid_copy = scr_alltrue(valid_copy, scr_comm_world);
-  rc = all_valid_copy ? SCR_SUCCESS : SCR_FAILURE;
 
-  /* stop timer and report performance info */
-  if (scr_my_rank_world == 0) {
-    double time_end = MPI_Wtime();
-    double time_diff = time_end - time_start;
-    double bw = 0.0;
-    if (time_diff > 0.0) {
-      bw = bytes / (1024.0 * 1024.0 * time_diff);
-    }
-    scr_dbg(1, "scr_reddesc_apply: %f secs, %e bytes, %f MB/s, %f MB/s per proc",
-            time_diff, bytes, bw, bw/scr_ranks_world
-    );
+  /* the thread computes a global result before it exits */
+  pthread_join(st->thread, NULL);
+  scr_reddesc_encode = NULL;
 
-    /* log data on the copy in the database */
-    if (scr_log_enable) {
-      char* dir = scr_cache_dir_get(desc, id);
-      scr_log_transfer("ENCODE", desc->base, dir, &id, NULL, &timestamp_start, &time_diff, &bytes, &files);
-      scr_free(&dir);
-    }
+  *id = st->id;
+  int rc = st->rc;
+
+  /* encoding is done, so clear its marker from the cache index */
+  if (rc == SCR_SUCCESS) {
+    scr_cache_index_set_encoding(scr_cindex, st->id, 0);
+    scr_cache_index_write(scr_cindex_file, scr_cindex);
   }
 
+  /* report performance info */
+  scr_reddesc_apply_report(st->desc, st->id, st->timestamp_start, st->time_start,
+    st->bytes, st->total_files
+  );
+
+  scr_reddesc_encode_state_free(&st);
+
   return rc;
 }
 
+
 static int scr_reddesc_er_recover(MPI_Comm comm, const char* name)
 {
   int rc = SCR_SUCCESS;
@@ -747,7 +977,7 @@ int scr_reddesc_recover(scr_cache_index* cindex, int id, const char* dir)
         char* file = kvtree_elem_key(file_elem);
 
         /* check the file */
-        if (! scr_bool_have_file(map, file)) {
+        if (! scr_bool_have_file(map, file, NULL)) {
           scr_dbg(2, "File determined to be invalid: %s", file);
           rc = SCR_FAILURE;
         }
@@ -105,13 +105,35 @@ scr_storedesc* scr_reddesc_get_store(
   const scr_reddesc* desc
 );
 
-/* apply redundancy scheme to files */
+/* apply redundancy scheme to files, if state is not NULL, it holds
+ * attributes of each file recorded by scr_file_state_add */
 int scr_reddesc_apply(
   scr_filemap* map,
   const scr_reddesc* c,
-  int id
+  int id,
+  const kvtree* state
+);
+
+/* apply redundancy scheme to files like scr_reddesc_apply, but encode
+ * the files in a background thread, sets started to 1 if the encoding
+ * was started in the background, in which case the caller must later
+ * call scr_reddesc_apply_wait, otherwise the encoding has completed */
+int scr_reddesc_apply_async(
+  scr_filemap* map,
+  const scr_reddesc* c,
+  int id,
+  const kvtree* state,
+  int* started
 );
 
+/* returns id of dataset being encoded in the background, or -1 if none */
+int scr_reddesc_apply_encoding(void);
+
+/* wait for background encoding to finish, sets id to the dataset that
+ * was encoded or -1 if none was running, returns SCR_SUCCESS if all
+ * procs encoded their files */
+int scr_reddesc_apply_wait(int* id);
+
 /* rebuilds files for specified dataset id using specified redundancy descriptor,
  * adds them to filemap, and returns SCR_SUCCESS if all processes succeeded */
 int scr_reddesc_recover(
@@ -327,6 +327,27 @@ char* scr_strdupf(const char* format, ...)
   return str;
 }
 
+/* encode the low bytes of value into buf in big-endian order */
+void scr_pack_be(unsigned char* buf, uint64_t value, int bytes)
+{
+  int i;
+  for (i = bytes - 1; i >= 0; i--) {
+    buf[i] = (unsigned char) (value & 0xff);
+    value >>= 8;
+  }
+}
+
+/* decode a value stored in bytes of buf in big-endian order */
+uint64_t scr_unpack_be(const unsigned char* buf, int bytes)
+{
+  uint64_t value = 0;
+  int i;
+  for (i = 0; i < bytes; i++) {
+    value = (value << 8) | (uint64_t) buf[i];
+  }
+  return value;
+}
+
 /* returns the current linux timestamp */
 int64_t scr_time_usecs()
 {
@@ -66,6 +66,12 @@ void scr_align_free(void* buf);
 /*sprintfs a formatted string into an newly allocated string */
 char* scr_strdupf(const char* format, ...);
 
+/* encode the low bytes of value into buf in big-endian order */
+void scr_pack_be(unsigned char* buf, uint64_t value, int bytes);
+
+/* decode a value stored in bytes of buf in big-endian order */
+uint64_t scr_unpack_be(const unsigned char* buf, int bytes);
+
 /* returns the current linux timestamp (in microseconds) */
 int64_t scr_time_usecs(void);
 
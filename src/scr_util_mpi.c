@@ -384,3 +384,348 @@ int scr_axl(
 
   return rc;
 }
+
+/* tag used to pass flow control messages in scr_axl_window */
+#define SCR_AXL_WINDOW_TAG (1001)
+
+/* returns total number of bytes in list of files */
+double scr_axl_bytes(int num_files, const char** filelist)
+{
+  double bytes = 0.0;
+  int i;
+  for (i = 0; i < num_files; i++) {
+    bytes += (double) scr_file_size(filelist[i]);
+  }
+  return bytes;
+}
+
+/* report bytes and bandwidth achieved in one window of a transfer */
+static void scr_axl_window_log(
+  const char* type,
+  const char* from,
+  const char* to,
+  const int* dset,
+  const char* name,
+  int window,
+  time_t timestamp,
+  double secs,
+  double bytes,
+  int files)
+{
+  double bw = 0.0;
+  if (secs > 0.0) {
+    bw = bytes / (1024.0 * 1024.0 * secs);
+  }
+  scr_dbg(2, "%s: window %d: %f secs, %e bytes, %f MB/s",
+    type, window, secs, bytes, bw
+  );
+
+  /* record stats for this window in the transfer log */
+  if (scr_log_enable) {
+    scr_log_transfer(type, from, to, dset, name, &timestamp, &secs, &bytes, &files);
+  }
+}
+
+/* transfer files like scr_axl, but limit the number of processes
+ * moving data at once to width using a sliding window, rank 0 hands
+ * out a token to each process in turn and each process reports back
+ * when it finishes so the next one can start, rank 0 moves its own
+ * files once all others have started, if log_type is not NULL
+ * rank 0 logs bytes and bandwidth for each window of width completed
+ * transfers, returns SCR_SUCCESS on all procs if all succeeded */
+int scr_axl_window(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  int width,
+  const char* log_type,
+  const char* from,
+  const char* to,
+  const int* dset,
+  MPI_Comm comm)
+{
+  /* get our rank and number of ranks in comm */
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* no need for flow control if everyone fits in the window */
+  if (width <= 0 || width >= ranks) {
+    return scr_axl(name, num_files, src_filelist, dest_filelist, type, comm);
+  }
+
+  int success = 1;
+  int token = 1;
+  MPI_Status status;
+  if (rank == 0) {
+    /* start timer for the first window */
+    int window = 0;
+    int window_count = 0;
+    int window_files = 0;
+    double window_bytes = 0.0;
+    time_t window_timestamp = scr_log_seconds();
+    double window_start = MPI_Wtime();
+
+    /* fill the window with other processes, we can't hand out tokens
+     * while we move our own files, so we go last */
+    int next = 1;
+    int outstanding = 0;
+    int self_done = 0;
+    while (next < ranks && outstanding < width) {
+      MPI_Send(&token, 1, MPI_INT, next, SCR_AXL_WINDOW_TAG, comm);
+      outstanding++;
+      next++;
+    }
+
+    /* as each process finishes, hand its token to the next one */
+    while (outstanding > 0 || ! self_done) {
+      /* message is success flag, bytes, and files */
+      double msg[3];
+      if (! self_done && next == ranks && outstanding < width) {
+        /* every other process has started and there is a free slot,
+         * so transfer our own files */
+        int rc = scr_axl(name, num_files, src_filelist, dest_filelist, type, MPI_COMM_SELF);
+        msg[0] = (rc == SCR_SUCCESS) ? 1.0 : 0.0;
+        msg[1] = scr_axl_bytes(num_files, src_filelist);
+        msg[2] = (double) num_files;
+        self_done = 1;
+      } else {
+        /* wait for any process to report that it's done */
+        MPI_Recv(msg, 3, MPI_DOUBLE, MPI_ANY_SOURCE, SCR_AXL_WINDOW_TAG, comm, &status);
+        outstanding--;
+
+        /* start the next process if there is one */
+        if (next < ranks) {
+          MPI_Send(&token, 1, MPI_INT, next, SCR_AXL_WINDOW_TAG, comm);
+          outstanding++;
+          next++;
+        }
+      }
+      if (msg[0] == 0.0) {
+        success = 0;
+      }
+      window_count++;
+      window_bytes += msg[1];
+      window_files += (int) msg[2];
+
+      /* close this window once width transfers have finished */
+      if (window_count == width || (outstanding == 0 && self_done)) {
+        double window_end = MPI_Wtime();
+        if (log_type != NULL) {
+          scr_axl_window_log(log_type, from, to, dset, name, window,
+            window_timestamp, window_end - window_start, window_bytes, window_files
+          );
+        }
+
+        /* reset counters for the next window */
+        window++;
+        window_count = 0;
+        window_files = 0;
+        window_bytes = 0.0;
+        window_timestamp = scr_log_seconds();
+        window_start = window_end;
+      }
+    }
+  } else {
+    /* wait for our turn */
+    MPI_Recv(&token, 1, MPI_INT, 0, SCR_AXL_WINDOW_TAG, comm, &status);
+
+    /* transfer our files */
+    if (scr_axl(name, num_files, src_filelist, dest_filelist, type, MPI_COMM_SELF) != SCR_SUCCESS) {
+      success = 0;
+    }
+
+    /* tell rank 0 we're done so it can start the next process */
+    double msg[3];
+    msg[0] = (double) success;
+    msg[1] = scr_axl_bytes(num_files, src_filelist);
+    msg[2] = (double) num_files;
+    MPI_Send(msg, 3, MPI_DOUBLE, 0, SCR_AXL_WINDOW_TAG, comm);
+  }
+
+  /* determine whether everyone succeeded */
+  if (! scr_alltrue(success, comm)) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
+
+/* gathers list of strings from all procs in comm to rank 0, in rank order,
+ * allocates and returns the full list on rank 0, returns an empty list on
+ * all other procs, caller must free each string and the list */
+static int scr_strlist_gather(
+  int count,
+  const char** list,
+  int* out_count,
+  char*** out_list,
+  MPI_Comm comm)
+{
+  int rank, ranks;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &ranks);
+
+  /* pack our strings into a single buffer */
+  int i;
+  int bytes = 0;
+  for (i = 0; i < count; i++) {
+    bytes += strlen(list[i]) + 1;
+  }
+  char* buf = (char*) SCR_MALLOC(bytes);
+  char* ptr = buf;
+  for (i = 0; i < count; i++) {
+    strcpy(ptr, list[i]);
+    ptr += strlen(list[i]) + 1;
+  }
+
+  /* gather number of strings and bytes from each process */
+  int* counts = NULL;
+  int* sizes  = NULL;
+  int* displs = NULL;
+  if (rank == 0) {
+    counts = (int*) SCR_MALLOC(ranks * sizeof(int));
+    sizes  = (int*) SCR_MALLOC(ranks * sizeof(int));
+    displs = (int*) SCR_MALLOC(ranks * sizeof(int));
+  }
+  MPI_Gather(&count, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+  MPI_Gather(&bytes, 1, MPI_INT, sizes,  1, MPI_INT, 0, comm);
+
+  /* compute total count and offset of each process in receive buffer */
+  int total_count = 0;
+  int total_bytes = 0;
+  if (rank == 0) {
+    for (i = 0; i < ranks; i++) {
+      displs[i] = total_bytes;
+      total_bytes += sizes[i];
+      total_count += counts[i];
+    }
+  }
+
+  /* gather strings to rank 0 */
+  char* recvbuf = NULL;
+  if (rank == 0) {
+    recvbuf = (char*) SCR_MALLOC(total_bytes);
+  }
+  MPI_Gatherv(buf, bytes, MPI_CHAR, recvbuf, sizes, displs, MPI_CHAR, 0, comm);
+
+  /* unpack strings into a new list */
+  char** newlist = NULL;
+  if (rank == 0) {
+    newlist = (char**) SCR_MALLOC(total_count * sizeof(char*));
+    ptr = recvbuf;
+    for (i = 0; i < total_count; i++) {
+      newlist[i] = strdup(ptr);
+      ptr += strlen(ptr) + 1;
+    }
+  }
+
+  /* free buffers */
+  scr_free(&recvbuf);
+  scr_free(&displs);
+  scr_free(&sizes);
+  scr_free(&counts);
+  scr_free(&buf);
+
+  *out_count = total_count;
+  *out_list  = newlist;
+
+  return SCR_SUCCESS;
+}
+
+/* gathers source and destination file lists from all procs in comm
+ * to rank 0, returns the combined lists on rank 0 and empty lists on
+ * all other procs, caller must free lists with scr_filelist_free */
+int scr_filelist_gather(
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  int* out_num_files,
+  char*** out_src_filelist,
+  char*** out_dest_filelist,
+  MPI_Comm comm)
+{
+  int src_count, dest_count;
+  scr_strlist_gather(num_files, src_filelist,  &src_count,  out_src_filelist,  comm);
+  scr_strlist_gather(num_files, dest_filelist, &dest_count, out_dest_filelist, comm);
+  *out_num_files = src_count;
+  return SCR_SUCCESS;
+}
+
+/* free lists allocated in scr_filelist_gather */
+int scr_filelist_free(
+  int num_files,
+  char*** ptr_src_filelist,
+  char*** ptr_dest_filelist)
+{
+  char** src_filelist  = *ptr_src_filelist;
+  char** dest_filelist = *ptr_dest_filelist;
+
+  int i;
+  for (i = 0; i < num_files; i++) {
+    scr_free(&src_filelist[i]);
+    scr_free(&dest_filelist[i]);
+  }
+  scr_free(ptr_src_filelist);
+  scr_free(ptr_dest_filelist);
+
+  return SCR_SUCCESS;
+}
+
+/* transfer files like scr_axl_window, but have rank 0 of each group in
+ * storecomm transfer the files for all procs in its group, so that only
+ * one process per group accesses the file system, the group leaders apply
+ * flow control among themselves, and each leader broadcasts the result
+ * back to its group, returns SCR_SUCCESS on all procs if all succeeded */
+int scr_axl_aggregate(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  int width,
+  const char* log_type,
+  const char* from,
+  const char* to,
+  const int* dset,
+  MPI_Comm storecomm,
+  MPI_Comm comm)
+{
+  /* collect list of files from our group at the group leader */
+  int agg_num_files;
+  char** agg_src_filelist;
+  char** agg_dest_filelist;
+  scr_filelist_gather(num_files, src_filelist, dest_filelist,
+    &agg_num_files, &agg_src_filelist, &agg_dest_filelist, storecomm
+  );
+
+  /* build communicator of group leaders */
+  int store_rank, rank;
+  MPI_Comm_rank(storecomm, &store_rank);
+  MPI_Comm_rank(comm, &rank);
+  int color = (store_rank == 0) ? 0 : MPI_UNDEFINED;
+  MPI_Comm comm_leaders;
+  MPI_Comm_split(comm, color, rank, &comm_leaders);
+
+  /* leaders transfer files on behalf of their group */
+  int success = 1;
+  if (comm_leaders != MPI_COMM_NULL) {
+    if (scr_axl_window(name, agg_num_files, (const char**) agg_src_filelist, (const char**) agg_dest_filelist,
+      type, width, log_type, from, to, dset, comm_leaders) != SCR_SUCCESS)
+    {
+      success = 0;
+    }
+    MPI_Comm_free(&comm_leaders);
+  }
+
+  /* leader informs its group of the result */
+  MPI_Bcast(&success, 1, MPI_INT, 0, storecomm);
+
+  /* free the aggregated lists */
+  scr_filelist_free(agg_num_files, &agg_src_filelist, &agg_dest_filelist);
+
+  if (! success) {
+    return SCR_FAILURE;
+  }
+  return SCR_SUCCESS;
+}
@@ -71,4 +71,64 @@ int scr_axl(
   MPI_Comm comm
 );
 
+/* returns total number of bytes in list of files */
+double scr_axl_bytes(int num_files, const char** filelist);
+
+/* transfer files like scr_axl, but limit the number of processes
+ * moving data at once to width using a sliding window, if log_type
+ * is not NULL rank 0 logs bytes and bandwidth for each window of
+ * width completed transfers, returns SCR_SUCCESS on all procs if
+ * all succeeded */
+int scr_axl_window(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  int width,
+  const char* log_type,
+  const char* from,
+  const char* to,
+  const int* dset,
+  MPI_Comm comm
+);
+
+/* gathers source and destination file lists from all procs in comm
+ * to rank 0, returns the combined lists on rank 0 and empty lists on
+ * all other procs, caller must free lists with scr_filelist_free */
+int scr_filelist_gather(
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  int* out_num_files,
+  char*** out_src_filelist,
+  char*** out_dest_filelist,
+  MPI_Comm comm
+);
+
+/* free lists allocated in scr_filelist_gather */
+int scr_filelist_free(
+  int num_files,
+  char*** ptr_src_filelist,
+  char*** ptr_dest_filelist
+);
+
+/* transfer files like scr_axl_window, but have rank 0 of each group in
+ * storecomm transfer the files for all procs in its group, returns
+ * SCR_SUCCESS on all procs if all succeeded */
+int scr_axl_aggregate(
+  const char* name,
+  int num_files,
+  const char** src_filelist,
+  const char** dest_filelist,
+  axl_xfer_t type,
+  int width,
+  const char* log_type,
+  const char* from,
+  const char* to,
+  const int* dset,
+  MPI_Comm storecomm,
+  MPI_Comm comm
+);
+
 #endif